@@ -17,14 +17,17 @@
 
 #include "assembly.h"
 
-Assembly::Assembly(NodeList *_nodeList, ElementList *_elemList, bool _complex) :
+Assembly::Assembly(NodeList *_nodeList, ElementList *_elemList, bool _complex,
+                   bool _verbose) :
                                       currentRe(_elemList->elements.size(), 0),
                                       currentIm(_elemList->elements.size(), 0),
                                       voltageRe(_elemList->elements.size(), 0),
-                                      voltageIm(_elemList->elements.size(), 0) {
+                                      voltageIm(_elemList->elements.size(), 0),
+                                      elemSourceDoF(_elemList->elements.size(), 0) {
     nodeList         = _nodeList;
     elemList         = _elemList;
     complex          = _complex;
+    verbose          = _verbose;
     systemMNA        = 0;
     systemExcitation = 0;
 
@@ -87,22 +90,26 @@ Assembly::buildReal() {
 
     unsigned int indRes= 0, indSource = 0;
 
-    std::cout << std::endl << "Assembly:" << std::endl;
+    if (verbose) {
+        std::cout << std::endl << "Assembly:" << std::endl;
+    }
 
     for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
-        Element elem = elemList->elements[indElem];
+        const Element &elem = elemList->elements[indElem];
 
-        std::string nodeStr1 = elem.nodeList[0],
-                    nodeStr2 = elem.nodeList[1];
-        unsigned int node1 = nodeList->mapStringNode[nodeStr1],
-                     node2 = nodeList->mapStringNode[nodeStr2];
+        const std::string &nodeStr1 = elem.nodeList[0],
+                          &nodeStr2 = elem.nodeList[1];
+        unsigned int node1 = nodeList->node(elem.nodeIds[0]),
+                     node2 = nodeList->node(elem.nodeIds[1]);
 
         switch (elem.elemType) {
         case STAT_RESISTANCE: {
             double resValue = elem.valueList[0];
 
-            std::cout << "Conductance " << 1/resValue << " Ohms, nodes: "
-                      << nodeStr1 << "-" << nodeStr2 << std::endl;
+            if (verbose) {
+                std::cout << "Conductance " << 1/resValue << " Ohms, nodes: "
+                          << nodeStr1 << "-" << nodeStr2 << std::endl;
+            }
 
             // Current out of node 1 through the conductance G.
             // i_1  = G(v_1 - v_2)
@@ -116,8 +123,10 @@ Assembly::buildReal() {
         case STAT_VOLTAGESOURCE: {
             double voltValue = elem.valueList[0];
 
-            std::cout << "Voltage Source " << voltValue << " V, nodes: "
-                      << nodeStr1 << "-" << nodeStr2 << std::endl;
+            if (verbose) {
+                std::cout << "Voltage Source " << voltValue << " V, nodes: "
+                          << nodeStr1 << "-" << nodeStr2 << std::endl;
+            }
 
             // Additional variable x[numNodes + indSource] is associated to
             // the current through the voltage source.
@@ -131,7 +140,7 @@ Assembly::buildReal() {
             fullMNA->set(node1, numNodes + indSource, -1);
             fullMNA->set(node2, numNodes + indSource, 1);
 
-            sourceDoFmap[elem.name] = numNodes + indSource;
+            elemSourceDoF[indElem] = numNodes + indSource;
             indSource++;
         } break;
         case STAT_CURRENTSOURCE: {
@@ -158,12 +167,12 @@ Assembly::buildReal() {
     }
 
     for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
-        Element elem = elemList->elements[indElem];
+        const Element &elem = elemList->elements[indElem];
 
-        std::string nodeStr1 = elem.nodeList[0],
-                    nodeStr2 = elem.nodeList[1];
-        unsigned int node1 = nodeList->mapStringNode[nodeStr1],
-                     node2 = nodeList->mapStringNode[nodeStr2];
+        const std::string &nodeStr1 = elem.nodeList[0],
+                          &nodeStr2 = elem.nodeList[1];
+        unsigned int node1 = nodeList->node(elem.nodeIds[0]),
+                     node2 = nodeList->node(elem.nodeIds[1]);
 
         switch (elem.elemType) {
         case STAT_RESISTANCE: {
@@ -175,13 +184,15 @@ Assembly::buildReal() {
         case STAT_VCVS: {
             assert(elem.nodeList.size() >= 4);
 
-            std::string nodeStr3 = elem.nodeList[2],
-                        nodeStr4 = elem.nodeList[3];
-            unsigned int node3 = nodeList->mapStringNode[nodeStr3],
-                         node4 = nodeList->mapStringNode[nodeStr4];
+            const std::string &nodeStr3 = elem.nodeList[2],
+                              &nodeStr4 = elem.nodeList[3];
+            unsigned int node3 = nodeList->node(elem.nodeIds[2]),
+                         node4 = nodeList->node(elem.nodeIds[3]);
 
-            std::cout << "VCVS " << nodeStr1 << " " << nodeStr2 << " "
-                      << nodeStr3 << " " << nodeStr4 << std::endl;
+            if (verbose) {
+                std::cout << "VCVS " << nodeStr1 << " " << nodeStr2 << " "
+                          << nodeStr3 << " " << nodeStr4 << std::endl;
+            }
 
 
             double gainValue = elem.valueList[0];
@@ -196,7 +207,7 @@ Assembly::buildReal() {
             fullMNA->set(node1, numNodes + indSource, -1);
             fullMNA->set(node2, numNodes + indSource, 1);
 
-            sourceDoFmap[elem.name] = numNodes + indSource;
+            elemSourceDoF[indElem] = numNodes + indSource;
             indSource++;
         } break;
         case STAT_CCCS: {
@@ -205,21 +216,18 @@ Assembly::buildReal() {
             // assert(parser->mapElemDummy.find(elem.elemList[0]) != parser->mapElemDummy.end());
             //std::string dummyVSname = parser->mapElemDummy[elem.elemList[0]];
 
-            std::string dummyVSname  = elem.elemList[0];
-            if (sourceDoFmap.find(dummyVSname) == sourceDoFmap.end()) {
-                std::cerr << "Unknown source: \"" << dummyVSname << "\"" << std::endl;
+            unsigned int refCurDoF = sourceDoF(elem.elemIds[0]);
+            if (refCurDoF == 0) {
+                std::cerr << "Unknown source: \"" << elem.elemList[0] << "\"" << std::endl;
                 exit(-1);
             }
-            unsigned int refCurDoF = sourceDoFmap[dummyVSname];
             fullMNA->addto(node1, refCurDoF, -gainValue);
             fullMNA->addto(node2, refCurDoF, gainValue);
         } break;
         case STAT_VCCS: {
             assert(elem.nodeList.size() >= 4);
-            std::string nodeStr3 = elem.nodeList[2],
-                        nodeStr4 = elem.nodeList[3];
-            unsigned int node3 = nodeList->mapStringNode[nodeStr3],
-                         node4 = nodeList->mapStringNode[nodeStr4];
+            unsigned int node3 = nodeList->node(elem.nodeIds[2]),
+                         node4 = nodeList->node(elem.nodeIds[3]);
 
             double gainValue = elem.valueList[0];
 
@@ -233,12 +241,11 @@ Assembly::buildReal() {
             double gainValue = elem.valueList[0];
             assert(elem.elemList.size() > 0);
 
-            std::string dummyVSname  = elem.elemList[0];
-            if (sourceDoFmap.find(dummyVSname) == sourceDoFmap.end()) {
-                std::cerr << "Unknown source: \"" << dummyVSname << "\"" << std::endl;
+            unsigned int refCurDoF = sourceDoF(elem.elemIds[0]);
+            if (refCurDoF == 0) {
+                std::cerr << "Unknown source: \"" << elem.elemList[0] << "\"" << std::endl;
                 exit(-1);
             }
-            unsigned int refCurDoF = sourceDoFmap[dummyVSname];
 
             // v_1 - v_2 = voltValue
             fullMNA->set(numNodes + indSource, node1, -1);
@@ -249,7 +256,7 @@ Assembly::buildReal() {
             fullMNA->set(node1, numNodes + indSource, -1);
             fullMNA->set(node2, numNodes + indSource, 1);
 
-            sourceDoFmap[elem.name] = numNodes + indSource;
+            elemSourceDoF[indElem] = numNodes + indSource;
             indSource++;
         }break;
         default:
@@ -296,91 +303,104 @@ Assembly::solve() {
 void
 Assembly::postProc(double *sol) {
     for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
-        Element elem = elemList->elements[indElem];
+        postProcElement(sol, indElem);
+    }
+}
 
-        assert(elem.nodeList.size() >= 2);
-        std::string nodeStr1 = elem.nodeList[0],
-                    nodeStr2 = elem.nodeList[1];
-        unsigned int node1 = nodeList->mapStringNode[nodeStr1],
-                     node2 = nodeList->mapStringNode[nodeStr2];
+// Only the branch voltages and currents of the elements in elemInds are
+// computed. This is used when only few variables are written.
+void
+Assembly::postProc(double *sol, const std::vector <unsigned int> &elemInds) {
+    for (unsigned int ind = 0; ind < elemInds.size(); ind++) {
+        postProcElement(sol, elemInds[ind]);
+    }
+}
 
-        assert(node1 <= numNodes);
-        assert(node2 <= numNodes);
+void
+Assembly::postProcElement(double *sol, unsigned int indElem) {
+    const Element &elem = elemList->elements[indElem];
 
-        double val1 = 0, val2 = 0;
-        if (node1 > 0) {
-            val1 = sol[node1 - 1];
-        }
-        if (node2 > 0) {
-            val2 = sol[node2 - 1];
-        }
-        voltageRe[indElem] = val1 - val2;
+    assert(elem.nodeList.size() >= 2);
+    unsigned int node1 = nodeList->node(elem.nodeIds[0]),
+                 node2 = nodeList->node(elem.nodeIds[1]);
 
-        switch(elem.elemType) {
-        case STAT_RESISTANCE:
-            currentRe[indElem] = voltageRe[indElem]/elem.valueList[0];
-            break;
-        case STAT_VOLTAGESOURCE: {
-            if (sourceDoFmap.find(elem.name) == sourceDoFmap.end()) {
-                std::cerr << "Unknown source: \"" << elem.name << "\"" << std::endl;
-                exit(-1);
-            }
-            unsigned int dof = sourceDoFmap[elem.name];
-            assert(dof > 0);
+    assert(node1 <= numNodes);
+    assert(node2 <= numNodes);
+
+    double val1 = 0, val2 = 0;
+    if (node1 > 0) {
+        val1 = sol[node1 - 1];
+    }
+    if (node2 > 0) {
+        val2 = sol[node2 - 1];
+    }
+    voltageRe[indElem] = val1 - val2;
+
+    switch(elem.elemType) {
+    case STAT_RESISTANCE:
+        currentRe[indElem] = voltageRe[indElem]/elem.valueList[0];
+        break;
+    case STAT_VOLTAGESOURCE: {
+        unsigned int dof = elemSourceDoF[indElem];
+        if (dof == 0) {
+            std::cerr << "Unknown source: \"" << elem.name << "\"" << std::endl;
+            exit(-1);
+        }
+        assert(dof > 0);
+        if (verbose) {
             std::cout << elem.name << "->" << dof-1 << std::endl;
-            currentRe[indElem] = -sol[dof-1];
         }
-            break;
-        case STAT_CURRENTSOURCE:
-            currentRe[indElem] = elem.valueList[0];
-            break;
-        case STAT_VCVS: {
-            if (sourceDoFmap.find(elem.name) == sourceDoFmap.end()) {
-                std::cerr << "Unknown source: \"" << elem.name << "\"" << std::endl;
-                exit(-1);
-            }
-            unsigned int dof = sourceDoFmap[elem.name];
-            assert(dof > 0);
-            currentRe[indElem] = -sol[dof-1];
+        currentRe[indElem] = -sol[dof-1];
+    }
+        break;
+    case STAT_CURRENTSOURCE:
+        currentRe[indElem] = elem.valueList[0];
+        break;
+    case STAT_VCVS: {
+        unsigned int dof = elemSourceDoF[indElem];
+        if (dof == 0) {
+            std::cerr << "Unknown source: \"" << elem.name << "\"" << std::endl;
+            exit(-1);
         }
-            break;
-        case STAT_VCCS: {
-            assert(elem.valueList.size() >= 1);
-            double gainValue = elem.valueList[0];
-            assert(elem.nodeList.size() >= 4);
+        assert(dof > 0);
+        currentRe[indElem] = -sol[dof-1];
+    }
+        break;
+    case STAT_VCCS: {
+        assert(elem.valueList.size() >= 1);
+        double gainValue = elem.valueList[0];
+        assert(elem.nodeList.size() >= 4);
 
-            std::string nodeStr3 = elem.nodeList[2],
-                        nodeStr4 = elem.nodeList[3];
-            unsigned int node3 = nodeList->mapStringNode[nodeStr3],
-                         node4 = nodeList->mapStringNode[nodeStr4];
+        unsigned int node3 = nodeList->node(elem.nodeIds[2]),
+                     node4 = nodeList->node(elem.nodeIds[3]);
 
-            currentRe[indElem] = gainValue*(sol[node3-1] - sol[node4-1]);
+        currentRe[indElem] = gainValue*(sol[node3-1] - sol[node4-1]);
+    }
+        break;
+    case STAT_CCVS: {
+        unsigned int dof = elemSourceDoF[indElem];
+        if (dof == 0) {
+            std::cerr << "Unknown source: \"" << elem.name << "\"" << std::endl;
+            exit(-1);
         }
-            break;
-        case STAT_CCVS: {
-            if (sourceDoFmap.find(elem.name) == sourceDoFmap.end()) {
-                std::cerr << "Unknown source: \"" << elem.name << "\"" << std::endl;
-                exit(-1);
-            }
-            unsigned int dof = sourceDoFmap[elem.name];
+        if (verbose) {
             std::cout << dof << std::endl;
-            assert(dof > 0);
-            currentRe[indElem] = -sol[dof-1];
         }
-            break;
-        case STAT_CCCS:
-            double gainValue = elem.valueList[0];
-            assert(elem.elemList.size() > 0);
-
-            std::string dummyVSname  = elem.elemList[0];
-            if (sourceDoFmap.find(dummyVSname) == sourceDoFmap.end()) {
-                std::cerr << "Unknown source: \"" << dummyVSname << "\"" << std::endl;
-                exit(-1);
-            }
-            unsigned int refCurDoF = sourceDoFmap[dummyVSname];
-            currentRe[indElem] = gainValue * sol[refCurDoF];
-            break;
+        assert(dof > 0);
+        currentRe[indElem] = -sol[dof-1];
+    }
+        break;
+    case STAT_CCCS:
+        double gainValue = elem.valueList[0];
+        assert(elem.elemList.size() > 0);
+
+        unsigned int refCurDoF = sourceDoF(elem.elemIds[0]);
+        if (refCurDoF == 0) {
+            std::cerr << "Unknown source: \"" << elem.elemList[0] << "\"" << std::endl;
+            exit(-1);
         }
+        currentRe[indElem] = gainValue * sol[refCurDoF];
+        break;
     }
 }
 
@@ -388,12 +408,34 @@ void
 Assembly::disp() {
     std::cout << std::endl << "Branch voltages and currents:" << std::endl;
     for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
-        Element elem = elemList->elements[indElem];
+        const Element &elem = elemList->elements[indElem];
         std::cout << elem.name << " " << voltageRe[indElem]
                   << " " << currentRe[indElem] << std::endl;
     }
 }
 
+void
+Assembly::signalNames(std::vector <std::string> &names) {
+    names.clear();
+    for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
+        const std::string &name = elemList->elements[indElem].name;
+        names.push_back("V(" + name + ")");
+        names.push_back("I(" + name + ")");
+    }
+}
+
+void
+Assembly::write(RawWriter &writer, double t) {
+    assert(writer.numSignals == 2*elemList->elements.size());
+
+    std::vector <double> values(writer.numSignals);
+    for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
+        values[2*indElem]     = voltageRe[indElem];
+        values[2*indElem + 1] = currentRe[indElem];
+    }
+    writer.addRow(t, values);
+}
+
 #ifdef ASSEMBLY_TEST
 
 int
@@ -27,6 +27,7 @@
 #include "topology.h"
 
 #include "matrix.h"
+#include "rawWriter.h"
 
 /*
  * This class implements the assembly of the system matrix and excitation
@@ -48,17 +49,17 @@
 
 class Assembly {
 public:
-    Assembly(NodeList *_nodeList, ElementList *_elemList, bool _complex = false);
+    Assembly(NodeList *_nodeList, ElementList *_elemList, bool _complex = false,
+             bool _verbose = true);
     ~Assembly();
     double * solve();
 
     bool complex;              // Are the DoFs complex?
+    bool verbose;              // Print the assembly process?
     unsigned int numDoF;
     Matrix *systemMNA;         // The system matrix.
     double *systemExcitation;  // The excitation vector.
 
-    std::map <std::string, unsigned int> sourceDoFmap;
-
     // The system matrix systemMNA is extracted from the full (with the ground
     // node) matrix fullMNA by removal of the first row and column. By
     // construction of the matrix fullMNA first, the construction process
@@ -76,12 +77,32 @@ public:
 
     std::vector <double> currentRe, currentIm,
                          voltageRe, voltageIm;
+
+    // The DoF of the current through each voltage source, VCVS and CCVS in
+    // fullMNA indexed by the element, or 0 for other elements. sourceDoF
+    // returns the DoF of the source with the given name id or 0.
+    std::vector <unsigned int> elemSourceDoF;
+    unsigned int sourceDoF(unsigned int nameId) const {
+        int indElem = elemList->elem(nameId);
+        if (indElem < 0) {
+            return 0;
+        }
+        return elemSourceDoF[indElem];
+    }
+
     void postProc(double *sol);
+    void postProc(double *sol, const std::vector <unsigned int> &elemInds);
     void disp();
 
+    // Branch voltages and currents V(name) and I(name) of all elements are
+    // streamed into RawWriter objects constructed with signalNames.
+    void signalNames(std::vector <std::string> &names);
+    void write(RawWriter &writer, double t);
+
 private:
     void buildReal();
     void buildComplex();
+    void postProcElement(double *sol, unsigned int indElem);
 
     unsigned int numNodes;
 };
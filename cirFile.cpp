@@ -16,15 +16,22 @@
 */
 
 #include "cirFile.h"
+#include "cirMappedFile.h"
 #include <stdlib.h>
 #include <cctype>
 #include <cassert>
 
 std::string
 cirFile::toUpper(const std::string &s) {
+    // Quoted strings are not converted.
     std::string str(s);
+    bool insideQuotes = false;
     for (unsigned int ind = 0; ind < str.length(); ind++) {
-        str[ind] = std::toupper(str[ind]);
+        if (str[ind] == '"') {
+            insideQuotes = !insideQuotes;
+        } else if (!insideQuotes) {
+            str[ind] = std::toupper(str[ind]);
+        }
     }
     return str;
 }
@@ -32,7 +39,7 @@ cirFile::toUpper(const std::string &s) {
 cirStatement::cirStatement(std::string &rawString) {
     std::vector <std::string> currentBracket;
     std::string currentWord;
-    bool insideBrackets = false, insideWord = false;
+    bool insideBrackets = false, insideWord = false, insideQuotes = false;
 
     // Check if the statement is empty. If not, extract the first character.
     // Note that ' '-characters have been removed from the front of the string.
@@ -57,15 +64,43 @@ cirStatement::cirStatement(std::string &rawString) {
 
     for (unsigned int indS=0; indS < rawString.length(); indS++) {
         char c = rawString[indS];
+        bool last = indS == rawString.length() - 1;
+
+        // Quoted strings are a part of the current word and may contain any
+        // characters.
+        if (c == '"' || insideQuotes) {
+            if (c == '"') {
+                insideQuotes = !insideQuotes;
+            }
+            insideWord = true;
+            currentWord += c;
+            if (last) {
+                if (insideQuotes) {
+                    std::cerr << "Unterminated quoted string!" << std::endl;
+                    exit(-1);
+                }
+                if (insideBrackets) {
+                    currentBracket.push_back(currentWord);
+                } else {
+                    strList.push_back(currentWord);
+                }
+            }
+            continue;
+        }
+
         bool valid = isalnum(c) || c == ' ' || c == '-' || c == '='
-                                || c == '(' || c == ')' || c == '.' || c == '_';
+                                || c == '(' || c == ')' || c == '.' || c == '_'
+                                || c == ',';
         bool isBracket = c == '(' || c == ')';
-        bool last = indS == rawString.length() - 1;
 
         if (!valid) {
             std::cerr << "Invalid character '" << c << "'" << std::endl;
             exit(-1);
         }
+        // Commas separate parameters similarly to spaces, e.g., V(1,2).
+        if (c == ',') {
+            c = ' ';
+        }
 
         if (c == '(') {
             if (insideBrackets) {
@@ -102,6 +137,7 @@ cirStatement::cirStatement(std::string &rawString) {
                 // the end bracket.
                 insideWord = false;
                 currentBracket.push_back(currentWord);
+                currentWord = "";
             }
             bracketList.push_back(currentBracket);
             currentBracket.clear();
@@ -129,6 +165,11 @@ cirStatement::cirStatement(std::string &rawString) {
         }
     }
 
+    if (insideBrackets) {
+        std::cerr << "Unterminated bracket!" << std::endl;
+        exit(-1);
+    }
+
     // The remaining code in this function determines the type of the SPICE
     // statement.
     std::string first = strList[0];
@@ -159,12 +200,40 @@ cirStatement::cirStatement(std::string &rawString) {
     }
 }
 
+cirStatement::cirStatement() {
+    statClass = CLASS_EMPTY;
+    type = STAT_EMPTY;
+}
+
+std::atomic <unsigned long> cirStatement::numCopies(0);
+
 cirStatement::cirStatement(const cirStatement &_stat) {
+    *this = _stat;
+}
+
+cirStatement::cirStatement(cirStatement &&_stat) noexcept {
+    *this = std::move(_stat);
+}
+
+cirStatement &
+cirStatement::operator=(const cirStatement &_stat) {
+    numCopies++;
     strList = _stat.strList;
     type = _stat.type;
     statClass = _stat.statClass;
     bracketList = _stat.bracketList;
     bracketNames = _stat.bracketNames;
+    return *this;
+}
+
+cirStatement &
+cirStatement::operator=(cirStatement &&_stat) noexcept {
+    strList = std::move(_stat.strList);
+    type = _stat.type;
+    statClass = _stat.statClass;
+    bracketList = std::move(_stat.bracketList);
+    bracketNames = std::move(_stat.bracketNames);
+    return *this;
 }
 
 cirStatement::~cirStatement() {
@@ -252,19 +321,30 @@ cirFile::cirFile(const std::string &_fileName) {
 
         std::cout << indLine++ << ":";
         cirStatement stat(line);
-        statList.push_back(stat);
-        it++;
         stat.disp();
+        statList.push_back(std::move(stat));
+        it++;
     }    
 }
 
+cirFile::cirFile(const std::string &_fileName, unsigned int numThreads) {
+    fileName = _fileName;
+    cirMappedFile mapped(fileName, numThreads);
+    std::cout << "File  :\"" << fileName << "\" with " << mapped.statList.size()
+              << " statements" << std::endl;
+
+    title = std::string(mapped.title);
+    std::cout << "Title :\"" << title << "\"" << std::endl;
+    mapped.getStatements(statList, numThreads);
+}
+
 cirFile::~cirFile() {
 }
 
 void
 cirFile::disp() {
     for (unsigned int indList = 0; indList < statList.size(); indList++) {
-        cirStatement stat = statList[indList];
+        const cirStatement &stat = statList[indList];
 
         std::cout << std::endl;
         std::cout << statements[stat.type].name << std::endl;
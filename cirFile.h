@@ -24,6 +24,7 @@
 #include <fstream>
 #include <sstream>
 #include <list>
+#include <atomic>
 
 #include "statements.h"
 
@@ -31,13 +32,18 @@
  * into SPICE statements with a type and a class. Types and classes are listed
  * in statements.h. Since SPICE files are case-insensitive, all input strings
  * s are converted into upper case by toUpper(s). Parameters to the statements
- * obtained with strSplit are assembled into strList.
+ * obtained with strSplit are assembled into strList. Strings in double quotes,
+ * e.g., file names, are kept as single words with their case and quotes.
  */
 
 class cirStatement {
 public:
+    cirStatement();
     cirStatement(const cirStatement &_stat);
+    cirStatement(cirStatement &&_stat) noexcept;
     cirStatement(std::string &rawString);
+    cirStatement &operator=(const cirStatement &_stat);
+    cirStatement &operator=(cirStatement &&_stat) noexcept;
     ~cirStatement();
 
     unsigned int type, statClass;
@@ -45,6 +51,9 @@ public:
     std::vector <std::vector<std::string> > bracketList;
 
     void disp() const;
+
+    // The number of copies made, for profiling of the parse path.
+    static std::atomic <unsigned long> numCopies;
 private:
 //    std::vector <std::string> strSplit (const std::string &s, char delim);
 //    void extractBrackets(const std::string &s);
@@ -58,6 +67,9 @@ private:
 class cirFile {
 public:
     cirFile(const std::string &fileName);
+    // Read the file with cirMappedFile on numThreads threads. The statements
+    // are not displayed and lineList is not filled.
+    cirFile(const std::string &fileName, unsigned int numThreads);
     ~cirFile();
 
     void disp();
@@ -66,8 +78,8 @@ public:
     std::string fileName;
 
     std::string title;
-private:
-    std::string toUpper(const std::string &s);
+
+    static std::string toUpper(const std::string &s);
 };
 
 #endif // CIRFILE_H
@@ -0,0 +1,573 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cirMappedFile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <cctype>
+#include <cassert>
+#include <algorithm>
+#include <thread>
+
+// Classes of the characters in statements. Commas separate parameters
+// similarly to spaces, e.g., V(1,2).
+enum {CHAR_INVALID, CHAR_WORD, CHAR_SEPARATOR, CHAR_OPEN, CHAR_CLOSE};
+static unsigned char charClasses[256];
+
+static bool
+initCharClasses() {
+    for (unsigned int c = 0; c < 256; c++) {
+        if (isalnum(c) || c == '-' || c == '=' || c == '.' || c == '_') {
+            charClasses[c] = CHAR_WORD;
+        } else if (c == ' ' || c == ',' || c == '\t' || c == '\r') {
+            charClasses[c] = CHAR_SEPARATOR;
+        } else if (c == '(') {
+            charClasses[c] = CHAR_OPEN;
+        } else if (c == ')') {
+            charClasses[c] = CHAR_CLOSE;
+        } else {
+            charClasses[c] = CHAR_INVALID;
+        }
+    }
+    return true;
+}
+static bool charClassesInit = initCharClasses();
+
+// Removes the comment, the carriage return and the spaces from the beginning
+// of the line starting at lineStart. The remaining [content, contentEnd) is
+// empty for empty lines. Returns the start of the next line.
+static const char *
+trimLine(const char *lineStart, const char *end, const char *&content, const char *&contentEnd) {
+    const char *lineEnd = (const char *) memchr(lineStart, '\n', end - lineStart);
+    if (!lineEnd) {
+        lineEnd = end;
+    }
+    const char *next = (lineEnd < end) ? lineEnd + 1 : end;
+
+    const char *comment = (const char *) memchr(lineStart, ';', lineEnd - lineStart);
+    if (comment) {
+        lineEnd = comment;
+    }
+    if (lineEnd > lineStart && lineEnd[-1] == '\r') {
+        lineEnd--;
+    }
+    content = lineStart;
+    while (content < lineEnd && *content == ' ') {
+        content++;
+    }
+    contentEnd = lineEnd;
+    return next;
+}
+
+cirMappedFile::cirMappedFile(const std::string &_fileName, unsigned int numThreads) {
+    fileName = _fileName;
+    mapping = std::shared_ptr <MappedFile> (new MappedFile(fileName, "Input file"));
+    rangeBegin = mapping->data;
+    insideBrackets = false;
+
+    size_t maxThreads = std::max((size_t) 1, mapping->size / minChunkSize);
+    numThreads = std::min((size_t) std::max(numThreads, 1u), maxThreads);
+    if (numThreads > 1) {
+        parseChunks(numThreads);
+    } else {
+        parse(mapping->data, mapping->data + mapping->size, true);
+    }
+
+    if (title.empty()) {
+        std::cerr << "Input file empty." << std::endl;
+        exit(-1);
+    }
+    if (statList.size() == 0) {
+        std::cerr << "Input file contains only the title." << std::endl;
+        exit(-1);
+    }
+}
+
+cirMappedFile::cirMappedFile(const cirMappedFile &file, const char *begin, const char *end) {
+    fileName = file.fileName;
+    mapping = file.mapping;
+    rangeBegin = begin;
+    insideBrackets = false;
+
+    parse(begin, end, false);
+}
+
+void
+cirMappedFile::parseChunks(unsigned int numThreads) {
+    const char *data = mapping->data, *end = data + mapping->size;
+    const char *content, *contentEnd;
+
+    // The title is read first so that it is never in the other chunks.
+    const char *lineStart = data;
+    unsigned int titleLines = 0;
+    while (lineStart < end && title.empty()) {
+        lineStart = trimLine(lineStart, end, content, contentEnd);
+        titleLines++;
+        if (content < contentEnd) {
+            title = std::string_view(content, contentEnd - content);
+        }
+    }
+
+    // Chunk boundaries at the starts of statements.
+    std::vector <const char *> bounds(numThreads + 1);
+    bounds[0] = lineStart;
+    bounds[numThreads] = end;
+    for (unsigned int indChunk = 1; indChunk < numThreads; indChunk++) {
+        const char *bound = std::max(data + mapping->size/numThreads*indChunk, bounds[indChunk - 1]);
+        if (bound > data && bound < end && bound[-1] != '\n') {
+            const char *lineEnd = (const char *) memchr(bound, '\n', end - bound);
+            bound = lineEnd ? lineEnd + 1 : end;
+        }
+        while (bound < end) {
+            const char *next = trimLine(bound, end, content, contentEnd);
+            if (content < contentEnd && *content != '+') {
+                break;
+            }
+            bound = next;
+        }
+        bounds[indChunk] = bound;
+    }
+
+    std::vector <cirMappedFile *> chunks(numThreads);
+    std::vector <std::thread> threads;
+    for (unsigned int indChunk = 0; indChunk < numThreads; indChunk++) {
+        threads.push_back(std::thread([&, indChunk]() {
+            chunks[indChunk] = new cirMappedFile(*this, bounds[indChunk], bounds[indChunk + 1]);
+        }));
+    }
+    for (unsigned int indChunk = 0; indChunk < numThreads; indChunk++) {
+        threads[indChunk].join();
+    }
+
+    // Merge the chunks in order. The indices of the tokens and the brackets,
+    // and the line numbers are offset by the totals of the previous chunks.
+    std::vector <size_t> tokenOffsets(numThreads + 1, 0), bracketTokenOffsets(numThreads + 1, 0),
+                         bracketOffsets(numThreads + 1, 0), statOffsets(numThreads + 1, 0),
+                         lineOffsets(numThreads + 1, titleLines);
+    for (unsigned int indChunk = 0; indChunk < numThreads; indChunk++) {
+        const cirMappedFile &chunk = *chunks[indChunk];
+        tokenOffsets[indChunk + 1]        = tokenOffsets[indChunk] + chunk.tokens.size();
+        bracketTokenOffsets[indChunk + 1] = bracketTokenOffsets[indChunk] + chunk.bracketTokens.size();
+        bracketOffsets[indChunk + 1]      = bracketOffsets[indChunk] + chunk.brackets.size();
+        statOffsets[indChunk + 1]         = statOffsets[indChunk] + chunk.statList.size();
+        lineOffsets[indChunk + 1]         = lineOffsets[indChunk] + chunk.numLines;
+    }
+    tokens.resize(tokenOffsets[numThreads]);
+    bracketTokens.resize(bracketTokenOffsets[numThreads]);
+    brackets.resize(bracketOffsets[numThreads]);
+    statList.resize(statOffsets[numThreads]);
+    numLines = lineOffsets[numThreads];
+
+    threads.clear();
+    for (unsigned int indChunk = 0; indChunk < numThreads; indChunk++) {
+        threads.push_back(std::thread([&, indChunk]() {
+            const cirMappedFile &chunk = *chunks[indChunk];
+            std::copy(chunk.tokens.begin(), chunk.tokens.end(), tokens.begin() + tokenOffsets[indChunk]);
+            std::copy(chunk.bracketTokens.begin(), chunk.bracketTokens.end(),
+                      bracketTokens.begin() + bracketTokenOffsets[indChunk]);
+            for (unsigned int indBracket = 0; indBracket < chunk.brackets.size(); indBracket++) {
+                Bracket &bracket = brackets[bracketOffsets[indChunk] + indBracket];
+                bracket = chunk.brackets[indBracket];
+                bracket.firstToken += bracketTokenOffsets[indChunk];
+            }
+            for (unsigned int indStat = 0; indStat < chunk.statList.size(); indStat++) {
+                Statement &stat = statList[statOffsets[indChunk] + indStat];
+                stat = chunk.statList[indStat];
+                stat.firstToken   += tokenOffsets[indChunk];
+                stat.firstBracket += bracketOffsets[indChunk];
+                stat.line         += lineOffsets[indChunk];
+            }
+        }));
+    }
+    for (unsigned int indChunk = 0; indChunk < numThreads; indChunk++) {
+        threads[indChunk].join();
+        delete chunks[indChunk];
+    }
+}
+
+void
+cirMappedFile::parse(const char *begin, const char *end, bool readTitle) {
+    // Typical element lines have four words in about 20 characters.
+    tokens.reserve((end - begin)/5);
+    statList.reserve((end - begin)/20);
+
+    const char *lineStart = begin;
+    unsigned int line = 0;
+    bool haveTitle = !readTitle;
+
+    while (lineStart < end) {
+        line++;
+        const char *p, *lineEnd;
+        const char *next = trimLine(lineStart, end, p, lineEnd);
+
+        if (p < lineEnd) {
+            if (!haveTitle) {
+                title = std::string_view(p, lineEnd - p);
+                haveTitle = true;
+            } else if (*p == '+') {
+                if (statList.size() == 0) {
+                    error("Continuation line without a statement", line);
+                }
+                // Continuation of a comment is a part of the comment.
+                if (statList.back().type != STAT_COMMENT) {
+                    parseLine(p + 1, lineEnd, line);
+                }
+            } else {
+                finishStatement();
+
+                Statement stat;
+                stat.type         = STAT_EMPTY;
+                stat.statClass    = CLASS_EMPTY;
+                stat.line         = line;
+                stat.firstToken   = tokens.size();
+                stat.numTokens    = 0;
+                stat.firstBracket = brackets.size();
+                stat.numBrackets  = 0;
+
+                if (*p == '*') {
+                    // Comment without the '*'.
+                    stat.type      = STAT_COMMENT;
+                    stat.statClass = CLASS_COMMENT;
+                    stat.numTokens = 1;
+                    tokens.push_back(std::string_view(p + 1, lineEnd - p - 1));
+                    statList.push_back(stat);
+                } else {
+                    statList.push_back(stat);
+                    parseLine(p, lineEnd, line);
+                }
+            }
+        }
+        lineStart = next;
+    }
+    numLines = line;
+    finishStatement();
+}
+
+void
+cirMappedFile::parseLine(const char *begin, const char *end, unsigned int line) {
+    Statement &stat = statList.back();
+    const char *wordStart = 0;
+    bool insideQuotes = false;
+
+    for (const char *p = begin; p <= end; p++) {
+        // The end of the line ends the current word.
+        char c = (p < end) ? *p : ' ';
+
+        // Quoted strings are a part of the current word and may contain any
+        // characters.
+        if (c == '"' || insideQuotes) {
+            if (p == end) {
+                error("Unterminated quoted string", line);
+            }
+            if (c == '"') {
+                insideQuotes = !insideQuotes;
+            }
+            if (!wordStart) {
+                wordStart = p;
+            }
+            continue;
+        }
+
+        unsigned char charClass = charClasses[(unsigned char) c];
+        if (charClass == CHAR_INVALID) {
+            error(std::string("Invalid character '") + c + "'", line);
+        }
+
+        if (charClass == CHAR_OPEN) {
+            if (insideBrackets) {
+                error("Nested brackets are not allowed", line);
+            }
+            insideBrackets = true;
+
+            Bracket bracket;
+            bracket.firstToken = bracketTokens.size();
+            bracket.numTokens  = 0;
+            if (wordStart) { // NAME(...
+                bracket.name = std::string_view(wordStart, p - wordStart);
+                wordStart = 0;
+            } else {         // NAME (...
+                // Name is the previous word of the statement.
+                if (tokens.size() == stat.firstToken) {
+                    error("Cannot start bracket without name", line);
+                }
+                bracket.name = tokens.back();
+                tokens.pop_back();
+            }
+            brackets.push_back(bracket);
+        } else if (charClass == CHAR_CLOSE) {
+            if (!insideBrackets) {
+                error("Cannot end non-started brackets", line);
+            }
+            if (wordStart) {
+                bracketTokens.push_back(std::string_view(wordStart, p - wordStart));
+                wordStart = 0;
+            }
+            insideBrackets = false;
+            brackets.back().numTokens = bracketTokens.size() - brackets.back().firstToken;
+        } else if (charClass == CHAR_SEPARATOR) {
+            if (wordStart) {
+                std::string_view word(wordStart, p - wordStart);
+                if (insideBrackets) {
+                    bracketTokens.push_back(word);
+                } else {
+                    tokens.push_back(word);
+                }
+                wordStart = 0;
+            }
+        } else if (!wordStart) {
+            wordStart = p;
+        }
+    }
+}
+
+void
+cirMappedFile::finishStatement() {
+    if (statList.size() == 0 || statList.back().type != STAT_EMPTY) {
+        return;
+    }
+    Statement &stat = statList.back();
+    if (insideBrackets) {
+        error("Unterminated bracket", stat.line);
+    }
+    stat.numTokens   = tokens.size() - stat.firstToken;
+    stat.numBrackets = brackets.size() - stat.firstBracket;
+    if (stat.numTokens == 0) {
+        error("Statement without a name", stat.line);
+    }
+
+    // Determine the type of the SPICE statement from the first word.
+    std::string_view first = tokens[stat.firstToken];
+    bool found = false;
+
+    for (unsigned int statType = 0; statType < numStatements; statType++) {
+        if (statements[statType].singleChar) {
+            found = std::toupper(first[0]) == statements[statType].statStr[0];
+        } else {
+            found = equalNoCase(first, statements[statType].statStr);
+        }
+        if (found) {
+            stat.statClass = statements[statType].classNum;
+            stat.type      = statements[statType].statNum;
+            break;
+        }
+    }
+    if (!found) {
+        error("Unknown statement type \"" + std::string(first) + "\"", stat.line);
+    }
+    if (!statements[stat.type].implemented) {
+        error(std::string("Statement \"") + statements[stat.type].statStr + "\" not implemented", stat.line);
+    }
+}
+
+void
+cirMappedFile::error(const std::string &message, unsigned int line) const {
+    // Line numbers of the chunks are relative to their beginning.
+    for (const char *p = mapping->data; p < rangeBegin; p++) {
+        if (*p == '\n') line++;
+    }
+    std::cerr << fileName << ":" << line << ": " << message << "!" << std::endl;
+    exit(-1);
+}
+
+bool
+cirMappedFile::equalNoCase(std::string_view a, std::string_view b) {
+    if (a.length() != b.length()) {
+        return false;
+    }
+    for (unsigned int ind = 0; ind < a.length(); ind++) {
+        if (std::toupper((unsigned char) a[ind]) != std::toupper((unsigned char) b[ind])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+cirStatement
+cirMappedFile::statement(unsigned int indStat) const {
+    cirStatement cirStat;
+    fillStatement(indStat, cirStat);
+    return cirStat;
+}
+
+void
+cirMappedFile::fillStatement(unsigned int indStat, cirStatement &cirStat) const {
+    const Statement &stat = statList[indStat];
+    cirStat.type      = stat.type;
+    cirStat.statClass = stat.statClass;
+
+    cirStat.strList.reserve(stat.numTokens);
+    for (unsigned int indToken = 0; indToken < stat.numTokens; indToken++) {
+        cirStat.strList.push_back(cirFile::toUpper(std::string(tokens[stat.firstToken + indToken])));
+    }
+    for (unsigned int indBracket = 0; indBracket < stat.numBrackets; indBracket++) {
+        const Bracket &bracket = brackets[stat.firstBracket + indBracket];
+        cirStat.bracketNames.push_back(cirFile::toUpper(std::string(bracket.name)));
+
+        std::vector <std::string> bracketList;
+        bracketList.reserve(bracket.numTokens);
+        for (unsigned int indToken = 0; indToken < bracket.numTokens; indToken++) {
+            bracketList.push_back(cirFile::toUpper(std::string(bracketTokens[bracket.firstToken + indToken])));
+        }
+        cirStat.bracketList.push_back(bracketList);
+    }
+}
+
+void
+cirMappedFile::getStatements(std::vector <cirStatement> &statements, unsigned int numThreads) const {
+    size_t numOld = statements.size();
+    statements.resize(numOld + statList.size());
+
+    numThreads = std::max(1u, std::min(numThreads, (unsigned int) (statList.size()/1024 + 1)));
+    std::vector <std::thread> threads;
+    for (unsigned int indThread = 0; indThread < numThreads; indThread++) {
+        threads.push_back(std::thread([&, indThread]() {
+            size_t first = statList.size()*indThread/numThreads,
+                   last  = statList.size()*(indThread + 1)/numThreads;
+            for (size_t indStat = first; indStat < last; indStat++) {
+                fillStatement(indStat, statements[numOld + indStat]);
+            }
+        }));
+    }
+    for (unsigned int indThread = 0; indThread < numThreads; indThread++) {
+        threads[indThread].join();
+    }
+}
+
+#ifdef CIRMAPPEDFILE_TEST
+
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+
+// Returns true if the statements a and b are identical.
+static bool
+equalStatements(const cirStatement &a, const cirStatement &b) {
+    return a.type == b.type && a.statClass == b.statClass && a.strList == b.strList
+        && a.bracketNames == b.bracketNames && a.bracketList == b.bracketList;
+}
+
+int
+main(int argc, char **argv) {
+    // The statements of the given .cir-files must be identical to those read
+    // with cirFile. The output of cirFile is suppressed.
+    std::streambuf *coutBuf = std::cout.rdbuf();
+    std::stringstream nullStream;
+
+    for (int indFile = 1; indFile < argc; indFile++) {
+        std::cout.rdbuf(nullStream.rdbuf());
+        cirFile cir(argv[indFile]);
+        std::cout.rdbuf(coutBuf);
+        nullStream.str("");
+
+        cirMappedFile mapped(argv[indFile]);
+        std::vector <cirStatement> statements;
+        mapped.getStatements(statements);
+
+        unsigned int numDiff = 0;
+        for (unsigned int indStat = 0; indStat < statements.size(); indStat++) {
+            if (indStat >= cir.statList.size()
+             || !equalStatements(statements[indStat], cir.statList[indStat])) {
+                numDiff++;
+            }
+        }
+        std::cout << argv[indFile] << ": " << statements.size() << "/" << cir.statList.size()
+                  << " statements, " << numDiff << " differences, title \""
+                  << mapped.title << "\"" << std::endl;
+    }
+
+    // Throughput on a generated netlist with numLines elements.
+    unsigned int numLines = 2000000;
+    const char *benchName = "/tmp/cirMappedFile_bench.cir";
+    FILE *file = fopen(benchName, "w");
+    fprintf(file, "Generated RC ladder\n");
+    fprintf(file, "V1 N0 0 SIN(0 1 1k)\n");
+    for (unsigned int ind = 0; ind < numLines/2; ind++) {
+        fprintf(file, "R%u N%u N%u 1k ; series\n", ind, ind, ind + 1);
+        fprintf(file, "c%u n%u 0\n+ 1p\n", ind, ind + 1);
+        if (ind % 1000 == 0) {
+            fprintf(file, "* Section %u\n\n  ; empty\n", ind/1000);
+        }
+    }
+    fprintf(file, ".tran 1n 1u\n.end\n");
+    long fileSize = ftell(file);
+    fclose(file);
+
+    clock_t clockStart = clock();
+    cirMappedFile mapped(benchName);
+    double timeMapped = (double)(clock() - clockStart)/CLOCKS_PER_SEC;
+
+    clockStart = clock();
+    std::vector <cirStatement> statements;
+    mapped.getStatements(statements);
+    double timeConvert = (double)(clock() - clockStart)/CLOCKS_PER_SEC;
+
+    std::cout.rdbuf(nullStream.rdbuf());
+    clockStart = clock();
+    cirFile cir(benchName);
+    double timeCir = (double)(clock() - clockStart)/CLOCKS_PER_SEC;
+    std::cout.rdbuf(coutBuf);
+
+    unsigned int numDiff = 0;
+    for (unsigned int indStat = 0; indStat < statements.size(); indStat++) {
+        if (!equalStatements(statements[indStat], cir.statList[indStat])) numDiff++;
+    }
+
+    std::cout << fileSize/1e6 << " MB, " << mapped.statList.size() << " statements, "
+              << numDiff << " differences" << std::endl
+              << "  cirMappedFile " << timeMapped << " s (" << fileSize/1e6/timeMapped << " MB/s)" << std::endl
+              << "  + statements  " << timeConvert << " s" << std::endl
+              << "  cirFile       " << timeCir << " s (" << fileSize/1e6/timeCir << " MB/s)" << std::endl;
+
+    // Reading with multiple threads must give the same tokens, statements and
+    // line numbers. The times are wall-clock times.
+    for (unsigned int numThreads = 1; numThreads <= 8; numThreads *= 2) {
+        std::chrono::steady_clock::time_point timeStart = std::chrono::steady_clock::now();
+        cirMappedFile parallel(benchName, numThreads);
+        std::chrono::steady_clock::time_point timeRead = std::chrono::steady_clock::now();
+        std::vector <cirStatement> parallelStatements;
+        parallel.getStatements(parallelStatements, numThreads);
+        std::chrono::steady_clock::time_point timeEnd = std::chrono::steady_clock::now();
+
+        numDiff = 0;
+        for (unsigned int indStat = 0; indStat < statements.size(); indStat++) {
+            if (indStat >= parallel.statList.size()
+             || parallel.statList[indStat].line != mapped.statList[indStat].line
+             || !equalStatements(statements[indStat], parallelStatements[indStat])) {
+                numDiff++;
+            }
+        }
+        std::cout << "  " << numThreads << " threads: read "
+                  << std::chrono::duration<double>(timeRead - timeStart).count() << " s, statements "
+                  << std::chrono::duration<double>(timeEnd - timeRead).count() << " s, "
+                  << parallel.statList.size() << " statements, " << numDiff << " differences" << std::endl;
+    }
+
+    // The parallel front end of cirFile.
+    std::cout.rdbuf(nullStream.rdbuf());
+    cirFile cirParallel(benchName, 4);
+    std::cout.rdbuf(coutBuf);
+    numDiff = 0;
+    for (unsigned int indStat = 0; indStat < statements.size(); indStat++) {
+        if (!equalStatements(statements[indStat], cirParallel.statList[indStat])) numDiff++;
+    }
+    std::cout << "  cirFile with 4 threads: " << numDiff << " differences, title \""
+              << cirParallel.title << "\"" << std::endl;
+    remove(benchName);
+}
+
+#endif
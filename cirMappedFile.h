@@ -0,0 +1,105 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CIRMAPPEDFILE_H
+#define CIRMAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+#include "cirFile.h"
+#include "mappedFile.h"
+
+/* cirMappedFile object reads a .cir-file through a memory mapping without
+ * copying its contents. The statements are tokenized with the same rules as
+ * in cirStatement, but the words are stored as string_views into the mapping
+ * in the order of the file:
+ *
+ *   tokens         Words outside brackets. Statement s has the words
+ *                  tokens[firstToken ... firstToken + numTokens - 1].
+ *   bracketTokens  Words inside brackets.
+ *   brackets       NAME(...) of the statements.
+ *
+ * The case of the words is not changed. Statement types are selected with
+ * case-insensitive comparisons and upper-case copies are made only by
+ * statement() for the Parser. Continuation lines starting with '+' continue
+ * the tokens of the previous statement. Unlike in cirFile, a word never
+ * continues across lines.
+ *
+ * With numThreads > 1, the file is split into numThreads chunks, which are
+ * tokenized on separate threads and merged in order. The chunks start at
+ * lines beginning a statement: a boundary is moved forward past the
+ * continuation lines and the empty lines, so that the continuation lines of
+ * a statement are always in the same chunk as the statement. Files smaller
+ * than minChunkSize bytes per thread are read with fewer threads.
+ */
+
+class cirMappedFile {
+public:
+    cirMappedFile(const std::string &_fileName, unsigned int numThreads = 1);
+
+    class Bracket {
+    public:
+        std::string_view name;
+        unsigned int firstToken, numTokens;
+    };
+
+    class Statement {
+    public:
+        unsigned int type, statClass, line;
+        unsigned int firstToken, numTokens, firstBracket, numBrackets;
+    };
+
+    std::string fileName;
+    std::string_view title;
+
+    std::vector <std::string_view> tokens, bracketTokens;
+    std::vector <Bracket>          brackets;
+    std::vector <Statement>        statList;
+
+    // Upper-case copy of the statement indStat, and of all statements
+    // converted on numThreads threads.
+    cirStatement statement(unsigned int indStat) const;
+    void getStatements(std::vector <cirStatement> &statements, unsigned int numThreads = 1) const;
+
+    static bool equalNoCase(std::string_view a, std::string_view b);
+    static const size_t minChunkSize = 1 << 20;
+private:
+    // Chunk [begin, end) of the file. Only the first chunk contains the
+    // title. Line numbers of the statements are relative to begin.
+    cirMappedFile(const cirMappedFile &file, const char *begin, const char *end);
+
+    std::shared_ptr <MappedFile> mapping;
+    const char *rangeBegin;
+    unsigned int numLines;
+
+    // Tokenizer state of the current statement, which may continue on the
+    // following lines.
+    bool insideBrackets;
+
+    void parse(const char *begin, const char *end, bool readTitle);
+    void parseChunks(unsigned int numThreads);
+    void parseLine(const char *begin, const char *end, unsigned int line);
+    void finishStatement();
+    void fillStatement(unsigned int indStat, cirStatement &cirStat) const;
+    void error(const std::string &message, unsigned int line) const;
+};
+
+#endif // CIRMAPPEDFILE_H
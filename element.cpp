@@ -24,11 +24,28 @@
 Element::Element() {
     elemType = STAT_EMPTY;
     elemClass = CLASS_EMPTY;
+    nameId = 0;
     waveForm = 0;
 }
 
+std::atomic <unsigned long> Element::numCopies(0);
+
 Element::Element(const Element &elem) {
-    std::cout << "COPY : " << elem.name << std::endl;
+    waveForm = 0;
+    *this = elem;
+}
+
+Element::Element(Element &&elem) noexcept {
+    waveForm = 0;
+    *this = std::move(elem);
+}
+
+Element &
+Element::operator=(const Element &elem) {
+    if (this == &elem) {
+        return *this;
+    }
+    numCopies++;
 
     elemType  = elem.elemType;
     elemClass = elem.elemClass;
@@ -37,13 +54,38 @@ Element::Element(const Element &elem) {
     elemList  = elem.elemList;
     typeList  = elem.typeList;
     valueList = elem.valueList;
+    nameId    = elem.nameId;
+    nodeIds   = elem.nodeIds;
+    elemIds   = elem.elemIds;
 
+    delete waveForm;
+    waveForm = 0;
     if (elem.waveForm) {
-        std::cout << "COPY -- waveform" << std::endl;
-        waveForm = new Waveform(elem.waveForm->strList, elem.waveForm->name);
-    } else {
-        waveForm = 0;
+        waveForm = new Waveform(*elem.waveForm);
     }
+    return *this;
+}
+
+Element &
+Element::operator=(Element &&elem) noexcept {
+    if (this == &elem) {
+        return *this;
+    }
+    elemType  = elem.elemType;
+    elemClass = elem.elemClass;
+    name      = std::move(elem.name);
+    nodeList  = std::move(elem.nodeList);
+    elemList  = std::move(elem.elemList);
+    typeList  = std::move(elem.typeList);
+    valueList = std::move(elem.valueList);
+    nameId    = elem.nameId;
+    nodeIds   = std::move(elem.nodeIds);
+    elemIds   = std::move(elem.elemIds);
+
+    delete waveForm;
+    waveForm = elem.waveForm;
+    elem.waveForm = 0;
+    return *this;
 }
 
 Element::Element(const cirStatement &stat) {
@@ -52,7 +94,7 @@ Element::Element(const cirStatement &stat) {
     name  = stat.strList[0];
     waveForm = 0;
 
-    std::vector <std::string> strList = stat.strList;
+    const std::vector <std::string> &strList = stat.strList;
 
     assert(elemClass == CLASS_SOURCE || elemClass == CLASS_PASSIVE
            || elemClass == CLASS_NONLINEAR);
@@ -96,6 +138,7 @@ Element::Element(const cirStatement &stat) {
 
                     typeList.push_back(bracketName);
                     waveForm = new Waveform(bracket, bracketName);
+                    waveForm->setSourceName(name);
                 } else {
                     std::cerr << "Incorrect number of parameters for voltage source" << std::endl;
                     exit(-1);
@@ -128,6 +171,7 @@ Element::Element(const cirStatement &stat) {
 
                     typeList.push_back(bracketName);
                     waveForm = new Waveform(bracket, bracketName);
+                    waveForm->setSourceName(name);
                 } else {
                     std::cerr << "Incorrect number of parameters for current source" << std::endl;
                     exit(-1);
@@ -176,22 +220,45 @@ Element::Element(const cirStatement &stat) {
     case CLASS_NONLINEAR:
         break;
     }
+
+    nameId = symbols.intern(name);
+    for (unsigned int nodeInd = 0; nodeInd < nodeList.size(); nodeInd++) {
+        nodeIds.push_back(symbols.intern(nodeList[nodeInd]));
+    }
+    for (unsigned int refInd = 0; refInd < elemList.size(); refInd++) {
+        elemIds.push_back(symbols.intern(elemList[refInd]));
+    }
 }
 
 Element::~Element() {
-    if (waveForm) {
-        delete waveForm;
-        std::cout << "delete waveform" << std::endl;
-    }
+    delete waveForm;
     waveForm = 0;
 }
 
-ElementList::ElementList(std::vector <Element> &_elements) {
+ElementList::ElementList(const std::vector <Element> &_elements) {
     elements = _elements;
+    countTypes();
+}
+
+ElementList::ElementList(std::vector <Element> &&_elements) {
+    elements = std::move(_elements);
+    countTypes();
+}
 
+int
+ElementList::find(const std::string &name) const {
+    int symbolId = symbols.find(name);
+    if (symbolId < 0) {
+        return -1;
+    }
+    return elem(symbolId);
+}
+
+void
+ElementList::countTypes() {
     // Create a node list and count the number of elements with each type.
     for (unsigned int elemInd = 0; elemInd < elements.size(); elemInd++) {
-        Element elem = elements[elemInd];
+        const Element &elem = elements[elemInd];
 
         if (typeCount.find(elem.elemType) == typeCount.end()) {
             typeCount[elem.elemType] = 1;
@@ -199,7 +266,10 @@ ElementList::ElementList(std::vector <Element> &_elements) {
             typeCount[elem.elemType]++;
         }
 
-        mapNameElem[elem.name] = elemInd;
+        if (elem.nameId >= symbolElem.size()) {
+            symbolElem.resize(elem.nameId + 1, -1);
+        }
+        symbolElem[elem.nameId] = elemInd;
     }
 }
 
@@ -208,7 +278,7 @@ ElementList::disp() {
     std::cout << std::endl << "Element List:" << std::endl;
     // Create a node list and count the number of elements with each type.
     for (unsigned int elemInd = 0; elemInd < elements.size(); elemInd++) {
-        Element elem = elements[elemInd];
+        const Element &elem = elements[elemInd];
 
         std::cout << "Element " << elemInd << " \"" << elem.name << "\""<< " :";
         for (unsigned int nodeInd = 0; nodeInd < elem.nodeList.size(); nodeInd++) {
@@ -220,12 +290,9 @@ ElementList::disp() {
 
     std::cout << std::endl << "Element Mapping:" << std::endl;
     // Element list:
-    for (std::map<std::string, unsigned int>::iterator it=mapNameElem.begin();
-         it != mapNameElem.end(); ++it) {
-        std::string  name    = it->first;
-        unsigned int elemInd = it->second;
-        std::cout << "  " << name << "->" << elemInd << std::endl;
-
+    for (unsigned int symbolId = 0; symbolId < symbolElem.size(); symbolId++) {
+        if (symbolElem[symbolId] < 0) continue;
+        std::cout << "  " << symbols.name(symbolId) << "->" << symbolElem[symbolId] << std::endl;
     }
 }
 
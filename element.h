@@ -21,12 +21,14 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <atomic>
 #include <assert.h>
 
 #include "cirFile.h"
 #include "value.h"
 #include "statements.h"
 #include "waveform.h"
+#include "symbolTable.h"
 
 /* Element objects correspond to circuit elements or their models in the
  * circuits.
@@ -46,6 +48,14 @@
  *
  * typeList vector is used to contain additional parameters such as the wave
  * shapes for sources.
+ *
+ * nameId, nodeIds and elemIds are the ids of name, nodeList and elemList in
+ * the global SymbolTable. They are assigned by the constructor and used by
+ * the solvers instead of the strings, which are kept for output.
+ *
+ * Elements own their waveforms. They are moved, e.g., from the Parser into
+ * the ElementList, and copied only when a solver needs its own values.
+ * numCopies counts the copies for profiling of the parse and setup paths.
  */
 
 class Element {
@@ -53,6 +63,9 @@ public:
     Element();
     Element(const cirStatement &stat);
     Element(const Element &elem);
+    Element(Element &&elem) noexcept;
+    Element &operator=(const Element &elem);
+    Element &operator=(Element &&elem) noexcept;
     ~Element();
 
     unsigned int elemType, elemClass;
@@ -62,23 +75,44 @@ public:
     std::vector <std::string> typeList;
     std::vector <double> valueList;
 
+    unsigned int nameId;
+    std::vector <unsigned int> nodeIds;
+    std::vector <unsigned int> elemIds;
+
     Waveform *waveForm;
+
+    static std::atomic <unsigned long> numCopies;
 };
 
 /* ElementList objects are vectors of Element objects with basic functionality
  * such as mapping between the names of the elements and their indices. The
  * typeCount map maps the type of element to the number of such elements in
- * the element list. */
+ * the element list. symbolElem maps the symbol ids of the names to the
+ * indices of the elements or -1, and the names are resolved through the
+ * SymbolTable. */
 
 class ElementList {
 public:
-    ElementList(std::vector <Element> &_elements);
+    ElementList(const std::vector <Element> &_elements);
+    ElementList(std::vector <Element> &&_elements);
     ~ElementList();
     void disp();
 
+    // Index of the element with the given symbol id or -1 if not found.
+    int elem(unsigned int symbolId) const {
+        if (symbolId >= symbolElem.size()) {
+            return -1;
+        }
+        return symbolElem[symbolId];
+    }
+    // Index of the element with the given name or -1 if not found.
+    int find(const std::string &name) const;
+
     std::vector <Element> elements;
-    std::map <std::string, unsigned int> mapNameElem;
+    std::vector <int> symbolElem;
     std::map <unsigned int, unsigned int> typeCount;
+private:
+    void countTypes();
 };
 
 #endif // ELEMENT_H
@@ -0,0 +1,560 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ensembleTransient.h"
+
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <math.h>
+
+EnsembleTransient::EnsembleTransient(Parser *_parser, unsigned int _numVariants, double _dt,
+                                     double _t2, double _t1, double _theta,
+                                     unsigned int _numThreads) {
+    parser      = _parser;
+    numVariants = _numVariants;
+    dt          = _dt;
+    t1          = _t1;
+    t2          = _t2;
+    theta       = _theta;
+    numThreads  = _numThreads;
+    writer      = 0;
+
+    if (theta <= 0 || theta > 1) {
+        std::cerr << "ENSEMBLE : Theta must be within (0, 1]!" << std::endl;
+        exit(-1);
+    }
+    numSteps = (unsigned int) ceil((t2 - t1)/dt - 1e-9);
+    h = (t2 - t1)/numSteps;
+
+    NodeList *nodeList = parser->nodeList;
+    std::vector <Element> &elements = parser->elemList->elements;
+
+    values.assign(elements.size()*numVariants, 0);
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        if (elements[indElem].valueList.size() > 0) {
+            for (unsigned int variant = 0; variant < numVariants; variant++) {
+                values[indElem*numVariants + variant] = elements[indElem].valueList[0];
+            }
+        }
+    }
+
+    // The varied elements and the sources with waveforms are stamped
+    // separately from the elements with fixed values. Voltage sources keep
+    // their names for the DoF mapping and current-controlled sources.
+    std::vector <Element> fixedElems;
+    std::vector <int> elemVaried(elements.size(), -1);
+    std::vector <unsigned int> wfVoltageSources;
+
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        const Element &elem = elements[indElem];
+
+        switch (elem.elemType) {
+        case STAT_RESISTANCE:
+        case STAT_CAPACITANCE:
+        case STAT_INDUCTANCE:
+            elemVaried[indElem] = variedElems.size();
+            if (elem.elemType != STAT_RESISTANCE) {
+                companions.push_back(variedElems.size());
+            }
+            variedElems.push_back(indElem);
+            variedNode1.push_back((int) nodeList->node(elem.nodeIds[0]) - 1);
+            variedNode2.push_back((int) nodeList->node(elem.nodeIds[1]) - 1);
+            break;
+        case STAT_VOLTAGESOURCE:
+        case STAT_CURRENTSOURCE:
+            if (elem.waveForm) {
+                // The parameters are set on the copy so that the circuit
+                // of the parser is not modified.
+                sourceWfs.push_back(*elem.waveForm);
+                sourceWfs.back().setTransientParameters(h, t1, t2);
+                if (elem.elemType == STAT_VOLTAGESOURCE) {
+                    std::string strVS = elem.name + " " + elem.nodeList[0] + " "
+                                      + elem.nodeList[1] + " 0";
+                    Element elemVS(strVS);
+                    fixedElems.push_back(std::move(elemVS));
+                    wfVoltageSources.push_back(sourceWfs.size() - 1);
+                    sourceRow1.push_back(-1);
+                    sourceRow2.push_back(-1);
+                } else {
+                    sourceRow1.push_back((int) nodeList->node(elem.nodeIds[0]) - 1);
+                    sourceRow2.push_back((int) nodeList->node(elem.nodeIds[1]) - 1);
+                }
+                break;
+            }
+            fixedElems.push_back(elem);
+            break;
+        default:
+            fixedElems.push_back(elem);
+        }
+    }
+
+    ElementList fixedList(std::move(fixedElems));
+    Assembly ass(nodeList, &fixedList, false, false);
+    numDoF = ass.numDoF;
+    fixedMatrix.assign(numDoF*numDoF, 0);
+    fixedExcitation.assign(ass.systemExcitation, ass.systemExcitation + numDoF);
+    for (unsigned int row = 0; row < numDoF; row++) {
+        for (unsigned int col = 0; col < numDoF; col++) {
+            fixedMatrix[row*numDoF + col] = ass.systemMNA->value(row, col);
+        }
+    }
+
+    // The value of a voltage source is the excitation of its DoF.
+    unsigned int indWf = 0;
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        const Element &elem = elements[indElem];
+        if ((elem.elemType == STAT_VOLTAGESOURCE || elem.elemType == STAT_CURRENTSOURCE)
+            && elem.waveForm) {
+            if (elem.elemType == STAT_VOLTAGESOURCE) {
+                sourceRow2[indWf] = ass.sourceDoF(elem.nameId) - 1;
+            }
+            indWf++;
+        }
+    }
+
+    // Output variables.
+    probes = parser->probes;
+    if (probes.size() == 0) {
+        for (unsigned int indNode = 1; indNode < nodeList->numNodes; indNode++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_VOLTAGE;
+            probe.name  = "V(" + nodeList->mapNodeString[indNode] + ")";
+            probe.args.push_back(nodeList->mapNodeString[indNode]);
+            probe.node1 = indNode;
+            probe.node2 = 0;
+            probe.elemInd = 0;
+            probes.push_back(probe);
+        }
+    }
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        Probe &probe = probes[indProbe];
+        int node1 = -1, node2 = -1, varied = -1, dof = -1;
+
+        if (probe.type == Probe::PROBE_VOLTAGE) {
+            node1 = (int) probe.node1 - 1;
+            node2 = (int) probe.node2 - 1;
+        } else if (elemVaried[probe.elemInd] >= 0) {
+            varied = elemVaried[probe.elemInd];
+            node1  = variedNode1[varied];
+            node2  = variedNode2[varied];
+        } else if (elements[probe.elemInd].elemType == STAT_VOLTAGESOURCE) {
+            dof = ass.sourceDoF(elements[probe.elemInd].nameId) - 1;
+        } else {
+            std::cerr << "ENSEMBLE : Output variable " << probe.name
+                      << " is not supported!" << std::endl;
+            exit(-1);
+        }
+        probeNode1.push_back(node1);
+        probeNode2.push_back(node2);
+        probeVaried.push_back(varied);
+        probeDoF.push_back(dof);
+    }
+    outputs.assign(probes.size()*numVariants, 0);
+}
+
+void
+EnsembleTransient::randomize(double relTol, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution <double> distribution(1 - relTol, 1 + relTol);
+
+    std::vector <Element> &elements = parser->elemList->elements;
+    for (unsigned int indVaried = 0; indVaried < variedElems.size(); indVaried++) {
+        unsigned int indElem = variedElems[indVaried];
+        for (unsigned int variant = 0; variant < numVariants; variant++) {
+            values[indElem*numVariants + variant] = elements[indElem].valueList[0]
+                                                  * distribution(generator);
+        }
+    }
+}
+
+void
+EnsembleTransient::factor(unsigned int variant, double _theta) {
+    unsigned int n = numDoF;
+    double *M = &luData[variant*n*n];
+    unsigned int *perm = &luPerm[variant*n];
+
+    // The conductances of the companion models are C/(_theta*h) and
+    // _theta*h/L.
+    std::copy(fixedMatrix.begin(), fixedMatrix.end(), M);
+    for (unsigned int indVaried = 0; indVaried < variedElems.size(); indVaried++) {
+        unsigned int indElem = variedElems[indVaried];
+        double value = values[indElem*numVariants + variant], G;
+        switch (parser->elemList->elements[indElem].elemType) {
+        case STAT_RESISTANCE:
+            G = 1/value;
+            break;
+        case STAT_CAPACITANCE:
+            G = value/(_theta*h);
+            break;
+        default:
+            G = _theta*h/value;
+        }
+        int node1 = variedNode1[indVaried], node2 = variedNode2[indVaried];
+        if (node1 >= 0) M[node1*n + node1] += G;
+        if (node2 >= 0) M[node2*n + node2] += G;
+        if (node1 >= 0 && node2 >= 0) {
+            M[node1*n + node2] -= G;
+            M[node2*n + node1] -= G;
+        }
+    }
+
+    // LU decomposition with partial pivoting. perm[k] is the row swapped
+    // with the row k.
+    for (unsigned int k = 0; k < n; k++) {
+        unsigned int pivRow = k;
+        for (unsigned int row = k + 1; row < n; row++) {
+            if (fabs(M[row*n + k]) > fabs(M[pivRow*n + k])) {
+                pivRow = row;
+            }
+        }
+        if (M[pivRow*n + k] == 0) {
+            std::cerr << "ENSEMBLE : Singular matrix in variant " << variant << "!" << std::endl;
+            exit(-1);
+        }
+        perm[k] = pivRow;
+        if (pivRow != k) {
+            for (unsigned int col = 0; col < n; col++) {
+                std::swap(M[k*n + col], M[pivRow*n + col]);
+            }
+        }
+        for (unsigned int row = k + 1; row < n; row++) {
+            double factor = M[row*n + k] /= M[k*n + k];
+            for (unsigned int col = k + 1; col < n; col++) {
+                M[row*n + col] -= factor*M[k*n + col];
+            }
+        }
+    }
+}
+
+void
+EnsembleTransient::solve(unsigned int variant, double *rhs) {
+    unsigned int n = numDoF;
+    const double *M = &luData[variant*n*n];
+    const unsigned int *perm = &luPerm[variant*n];
+
+    for (unsigned int k = 0; k < n; k++) {
+        std::swap(rhs[k], rhs[perm[k]]);
+    }
+    for (unsigned int row = 1; row < n; row++) {
+        double val = rhs[row];
+        for (unsigned int col = 0; col < row; col++) {
+            val -= M[row*n + col]*rhs[col];
+        }
+        rhs[row] = val;
+    }
+    for (int row = n - 1; row >= 0; row--) {
+        double val = rhs[row];
+        for (unsigned int col = row + 1; col < n; col++) {
+            val -= M[row*n + col]*rhs[col];
+        }
+        rhs[row] = val/M[row*n + row];
+    }
+}
+
+void
+EnsembleTransient::conductances(unsigned int variantStart, unsigned int variantEnd,
+                                double _theta) {
+    unsigned int N = numVariants;
+    std::vector <Element> &elements = parser->elemList->elements;
+
+    for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+        factor(variant, _theta);
+    }
+    for (unsigned int indComp = 0; indComp < companions.size(); indComp++) {
+        unsigned int indVaried = companions[indComp],
+                     indElem   = variedElems[indVaried];
+        bool capacitance = elements[indElem].elemType == STAT_CAPACITANCE;
+        const double *value = &values[indElem*N];
+        double *G = &compG[indComp*N];
+        for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+            G[variant] = capacitance ? value[variant]/(_theta*h) : _theta*h/value[variant];
+        }
+    }
+}
+
+void
+EnsembleTransient::worker(unsigned int variantStart, unsigned int variantEnd) {
+    unsigned int n = numDoF, N = numVariants, numProbes = probes.size();
+    std::vector <Element> &elements = parser->elemList->elements;
+
+    // The currents of the energy storage elements are not known at t1 and
+    // the first step is taken with Backward Euler. The Norton currents of
+    // the zero initial state are zero for any theta.
+    conductances(variantStart, variantEnd, 1);
+
+    // Solutions of the variants of the chunk. Each worker evaluates the
+    // waveforms with its own states.
+    std::vector <double> excitation(n), solutions((variantEnd - variantStart)*n);
+    std::vector <WaveformState> wfStates(sourceWfs.size());
+
+    for (unsigned int step = 1; step <= numSteps; step++) {
+        double tNew = t1 + step*h;
+
+        excitation = fixedExcitation;
+        for (unsigned int indWf = 0; indWf < sourceWfs.size(); indWf++) {
+            double u = sourceWfs[indWf].eval(tNew, wfStates[indWf]);
+            if (sourceRow1[indWf] >= 0) excitation[sourceRow1[indWf]] -= u;
+            if (sourceRow2[indWf] >= 0) excitation[sourceRow2[indWf]] += u;
+        }
+
+        for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+            double *x = &solutions[(variant - variantStart)*n];
+            std::copy(excitation.begin(), excitation.end(), x);
+
+            // The Norton currents flow from node1 to node2.
+            for (unsigned int indComp = 0; indComp < companions.size(); indComp++) {
+                unsigned int indVaried = companions[indComp];
+                double J = compJ[indComp*N + variant];
+                if (variedNode1[indVaried] >= 0) x[variedNode1[indVaried]] -= J;
+                if (variedNode2[indVaried] >= 0) x[variedNode2[indVaried]] += J;
+            }
+            solve(variant, x);
+
+            for (unsigned int indComp = 0; indComp < companions.size(); indComp++) {
+                unsigned int indVaried = companions[indComp];
+                int node1 = variedNode1[indVaried], node2 = variedNode2[indVaried];
+                compVoltage[indComp*N + variant] = (node1 >= 0 ? x[node1] : 0)
+                                                 - (node2 >= 0 ? x[node2] : 0);
+            }
+        }
+
+        // Companion updates over the variants of the chunk. After the first
+        // step, the conductances of the theta method are set and the
+        // matrices refactored before the Norton currents of the next step.
+        for (unsigned int indComp = 0; indComp < companions.size(); indComp++) {
+            const double *G = &compG[indComp*N], *V = &compVoltage[indComp*N],
+                         *J = &compJ[indComp*N];
+            double *I = &compCurrent[indComp*N];
+            for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+                I[variant] = G[variant]*V[variant] + J[variant];
+            }
+        }
+        if (step == 1 && theta != 1) {
+            conductances(variantStart, variantEnd, theta);
+        }
+        for (unsigned int indComp = 0; indComp < companions.size(); indComp++) {
+            unsigned int indElem = variedElems[companions[indComp]];
+            const double *value = &values[indElem*N];
+            const double *G = &compG[indComp*N], *V = &compVoltage[indComp*N],
+                         *I = &compCurrent[indComp*N];
+            double *J = &compJ[indComp*N];
+
+            if (elements[indElem].elemType == STAT_CAPACITANCE) {
+                double c = (1 - theta)/theta;
+                for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+                    J[variant] = -G[variant]*V[variant] - c*I[variant];
+                }
+            } else {
+                double c = (1 - theta)*h;
+                for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+                    J[variant] = I[variant] + c*V[variant]/value[variant];
+                }
+            }
+        }
+
+        for (unsigned int indProbe = 0; indProbe < numProbes; indProbe++) {
+            int node1 = probeNode1[indProbe], node2 = probeNode2[indProbe],
+                varied = probeVaried[indProbe], dof = probeDoF[indProbe];
+            double *out = &outputs[indProbe*N];
+
+            for (unsigned int variant = variantStart; variant < variantEnd; variant++) {
+                const double *x = &solutions[(variant - variantStart)*n];
+                if (dof >= 0) {
+                    out[variant] = -x[dof];
+                    continue;
+                }
+                double voltage = (node1 >= 0 ? x[node1] : 0) - (node2 >= 0 ? x[node2] : 0);
+                if (varied < 0) {
+                    out[variant] = voltage;
+                } else if (elements[variedElems[varied]].elemType == STAT_RESISTANCE) {
+                    out[variant] = voltage/values[variedElems[varied]*N + variant];
+                } else {
+                    unsigned int indComp = std::find(companions.begin(), companions.end(),
+                                                     (unsigned int) varied) - companions.begin();
+                    out[variant] = compCurrent[indComp*N + variant];
+                }
+            }
+            if (writer) {
+                std::copy(out + variantStart, out + variantEnd,
+                          &history[((step - 1)*numProbes + indProbe)*N + variantStart]);
+            }
+        }
+    }
+}
+
+void
+EnsembleTransient::run() {
+    unsigned int n = numDoF, N = numVariants, numProbes = probes.size();
+
+    luData.assign(N*n*n, 0);
+    luPerm.assign(N*n, 0);
+    compG.assign(companions.size()*N, 0);
+    compVoltage.assign(companions.size()*N, 0);
+    compCurrent.assign(companions.size()*N, 0);
+    compJ.assign(companions.size()*N, 0);
+    if (writer) {
+        history.assign(numSteps*numProbes*N, 0);
+    }
+
+    unsigned int chunk = (N + numThreads - 1)/numThreads;
+    std::vector <std::thread> threads;
+    for (unsigned int variantStart = 0; variantStart < N; variantStart += chunk) {
+        unsigned int variantEnd = std::min(variantStart + chunk, N);
+        threads.push_back(std::thread(&EnsembleTransient::worker, this,
+                                      variantStart, variantEnd));
+    }
+    for (unsigned int thread = 0; thread < threads.size(); thread++) {
+        threads[thread].join();
+    }
+
+    if (!writer) {
+        return;
+    }
+    std::vector <double> row(2*numProbes);
+    for (unsigned int step = 1; step <= numSteps; step++) {
+        for (unsigned int indProbe = 0; indProbe < numProbes; indProbe++) {
+            const double *out = &history[((step - 1)*numProbes + indProbe)*N];
+            double mean = 0, var = 0;
+            for (unsigned int variant = 0; variant < N; variant++) {
+                mean += out[variant];
+            }
+            mean /= N;
+            for (unsigned int variant = 0; variant < N; variant++) {
+                var += (out[variant] - mean)*(out[variant] - mean);
+            }
+            row[2*indProbe]     = mean;
+            row[2*indProbe + 1] = (N > 1) ? sqrt(var/(N - 1)) : 0;
+        }
+        writer->addRow(t1 + step*h, row);
+    }
+}
+
+void
+EnsembleTransient::signalNames(std::vector <std::string> &names) {
+    names.clear();
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        names.push_back("mean(" + probes[indProbe].name + ")");
+        names.push_back("std(" + probes[indProbe].name + ")");
+    }
+}
+
+#ifdef ENSEMBLE_TEST
+
+#include "transient.h"
+#include <string.h>
+
+// An RC circuit, which starts from zero, is charged by a DC source. The
+// first step is taken with Backward Euler as in Transient and the voltage
+// of the capacitance after ten steps is compared to Transient.
+static void
+checkFirstStep() {
+    std::vector <std::string> lines;
+    lines.push_back("VDC 1 0 1");
+    lines.push_back("R1 2 1 10000");
+    lines.push_back("C1 0 2 1u");
+    lines.push_back(".PRINT TRAN V(2)");
+    std::vector <cirStatement> stats;
+    for (unsigned int ind = 0; ind < lines.size(); ind++) {
+        stats.push_back(cirStatement(lines[ind]));
+    }
+    Parser parser(stats);
+
+    double h = 1e-4, t2 = 1e-3;
+    Transient tran(&parser, h, t2, 0, 0.5);
+    tran.verbose = false;
+    tran.run();
+    EnsembleTransient ens(&parser, 1, h, t2, 0, 0.5, 1);
+    ens.run();
+
+    double exact = 1 - exp(-t2/0.01);
+    std::cout << std::endl << "RC at t = " << t2 << ": ensemble " << ens.outputs[0]
+              << ", Transient " << tran.outputs[0] << " (exact " << exact << ")" << std::endl;
+    assert(fabs(ens.outputs[0] - tran.outputs[0]) < 1e-12);
+}
+
+int
+main(int argc, char **argv) {
+    checkFirstStep();
+
+    std::string fileName = "test_sinusoidal.cir";
+    unsigned int numVariants = 1000, numThreads = 4;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (argc >= 3) {
+        numVariants = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        numThreads = atoi(argv[3]);
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+
+    // The nominal variant is compared to Transient.
+    Transient tran(&parser, 0.0001, 0.1, 0, 0.5);
+    tran.verbose = false;
+    tran.run();
+
+    // The ensemble sets the transient parameters of its own copies of the
+    // waveforms and leaves the circuit of the parser unchanged.
+    std::vector <Element> &elements = parser.elemList->elements;
+    std::vector <Waveform> parserWfs;
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        if (elements[indElem].waveForm) {
+            parserWfs.push_back(*elements[indElem].waveForm);
+        }
+    }
+    EnsembleTransient ens(&parser, numVariants, 0.0001, 0.1, 0, 0.5, numThreads);
+    for (unsigned int indElem = 0, indWf = 0; indElem < elements.size(); indElem++) {
+        if (elements[indElem].waveForm) {
+            assert(memcmp(&parserWfs[indWf].par, &elements[indElem].waveForm->par,
+                          sizeof(parserWfs[indWf].par)) == 0);
+            indWf++;
+        }
+    }
+    ens.randomize(0.1, 1);
+    for (unsigned int indElem = 0; indElem < parser.elemList->elements.size(); indElem++) {
+        if (parser.elemList->elements[indElem].valueList.size() > 0) {
+            ens.values[indElem*numVariants] = parser.elemList->elements[indElem].valueList[0];
+        }
+    }
+
+    clock_t clockStart = clock();
+    ens.run();
+    double elapsed = (double)(clock() - clockStart)/CLOCKS_PER_SEC;
+
+    std::cout << std::endl << numVariants << " variants, " << ens.numSteps << " steps in "
+              << elapsed << " s of CPU time" << std::endl;
+    for (unsigned int indProbe = 0; indProbe < ens.probes.size(); indProbe++) {
+        const double *out = &ens.outputs[indProbe*numVariants];
+        double minVal = out[0], maxVal = out[0];
+        for (unsigned int variant = 0; variant < numVariants; variant++) {
+            minVal = std::min(minVal, out[variant]);
+            maxVal = std::max(maxVal, out[variant]);
+        }
+        std::cout << ens.probes[indProbe].name << " : nominal " << out[0]
+                  << " (Transient " << tran.outputs[indProbe] << "), range "
+                  << minVal << " - " << maxVal << std::endl;
+        assert(fabs(out[0] - tran.outputs[indProbe]) <= 1e-9*(1 + fabs(tran.outputs[indProbe])));
+    }
+}
+
+#endif
@@ -0,0 +1,119 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ENSEMBLETRANSIENT_H
+#define ENSEMBLETRANSIENT_H
+
+#include "parser.h"
+#include "assembly.h"
+#include "waveform.h"
+#include "rawWriter.h"
+
+#include <vector>
+#include <string>
+
+/* EnsembleTransient object performs transient solution of numVariants
+ * variants of a linear circuit, which differ only in the values of their
+ * resistances, capacitances and inductances, for example, in Monte Carlo
+ * analysis of component tolerances.
+ *
+ * The variants are integrated in lockstep with the theta method (0 < theta
+ * <= 1) and a fixed time step h, the largest step not longer than dt that
+ * divides t2 - t1. The breakpoints of the sources are not landed on. The
+ * currents of the energy storage elements are not known at t1, so the first
+ * step is taken with Backward Euler as in Transient.
+ * The MNA structure is shared by all variants: the matrix is the sum of the
+ * matrix of the elements with fixed values and the conductance stamps of the
+ * varied elements and their companion models. Since the time step is fixed,
+ * the LU decomposition of the matrix of each variant is computed once.
+ *
+ * The values of the varied elements and the branch voltages, currents and
+ * Norton currents of the companion models are stored as structure-of-arrays:
+ * the values of all variants for one element are contiguous, so that the
+ * companion updates are loops over the variants. The variants are divided
+ * into numThreads contiguous chunks integrated by separate threads.
+ *
+ * values   Values of the elements. values[indElem*numVariants + variant]
+ *          is used for resistances, capacitances and inductances and the
+ *          nominal values for the other elements.
+ * outputs  Output variables at t2. outputs[indProbe*numVariants + variant].
+ *
+ * The output variables can be node voltages and currents of resistances,
+ * capacitances, inductances and voltage sources. When writer is set, the mean
+ * and the standard deviation of each output variable over the variants are
+ * written after each time step.
+ */
+
+class EnsembleTransient {
+public:
+    EnsembleTransient(Parser *_parser, unsigned int _numVariants, double _dt, double _t2,
+                      double _t1=0, double _theta=0.5, unsigned int _numThreads=1);
+
+    // Draw the values of all resistances, capacitances and inductances
+    // uniformly within the relative tolerance relTol of their nominal values.
+    void randomize(double relTol, unsigned int seed);
+    void run();
+    void signalNames(std::vector <std::string> &names);
+
+    double dt, t1, t2, theta, h;
+    unsigned int numVariants, numThreads, numSteps;
+    RawWriter *writer;
+
+    std::vector <double> values;
+    std::vector <Probe> probes;
+    std::vector <double> outputs;
+private:
+    Parser *parser;
+    unsigned int numDoF;
+
+    // Matrix and excitation of the elements with fixed values.
+    std::vector <double> fixedMatrix, fixedExcitation;
+
+    // Indices of the varied elements in the original element list and the
+    // system indices of their nodes (-1 for the ground).
+    std::vector <unsigned int> variedElems;
+    std::vector <int> variedNode1, variedNode2;
+
+    // Indices of the capacitances and inductances among the varied elements
+    // and the SoA state of their companion models.
+    std::vector <unsigned int> companions;
+    std::vector <double> compG, compVoltage, compCurrent, compJ;
+
+    // Sources with waveforms and the system indices of their excitation.
+    // The waveforms are copies configured with the time step of the ensemble.
+    std::vector <Waveform> sourceWfs;
+    std::vector <int> sourceRow1, sourceRow2;
+
+    // Output variables of each probe: system indices of the nodes, the
+    // varied element, and the DoF of a voltage source.
+    std::vector <int> probeNode1, probeNode2, probeVaried, probeDoF;
+
+    // LU decompositions with row permutations of all variants.
+    std::vector <double> luData;
+    std::vector <unsigned int> luPerm;
+
+    // Output variables of all steps, when writer is set.
+    std::vector <double> history;
+
+    void factor(unsigned int variant, double _theta);
+    void conductances(unsigned int variantStart, unsigned int variantEnd, double _theta);
+    void solve(unsigned int variant, double *rhs);
+    void worker(unsigned int variantStart, unsigned int variantEnd);
+};
+
+#endif // ENSEMBLETRANSIENT_H
@@ -0,0 +1,632 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "expTransient.h"
+
+#include <math.h>
+
+ExpTransient::ExpTransient(Parser *_parser, StateSpace *_stateSpace, double _dt,
+                           double _t2, double _t1) {
+    parser     = _parser;
+    stateSpace = _stateSpace;
+    dt = _dt;
+    t1 = _t1;
+    t2 = _t2;
+    t  = t1;
+    krylovDim = 30;
+    tol       = 1e-8;
+    verbose   = true;
+    writer    = 0;
+    hMin      = dt*1e-9;
+    numSteps = numSubsteps = numArnoldi = 0;
+
+    constInputs.assign(stateSpace->numInputs, 0);
+    for (unsigned int indInput = 0; indInput < stateSpace->numInputs; indInput++) {
+        const Element &elem = parser->elemList->elements[stateSpace->inputElems[indInput]];
+        if (elem.waveForm) {
+            // The parameters are set on the copy so that the circuit of the
+            // parser is not modified.
+            sourceWfs.push_back(*elem.waveForm);
+            sourceWfs.back().setTransientParameters(dt, t1, t2);
+            sourceStates.push_back(WaveformState());
+            wfInputInds.push_back(indInput);
+        } else {
+            constInputs[indInput] = elem.valueList[0];
+        }
+    }
+
+    reduce();
+
+    // The energy storage elements are initially without charge.
+    z.assign(numDiff, 0);
+    outputs.assign(stateSpace->numOutputs, 0);
+    std::vector <double> u;
+    inputs(t, u);
+    computeOutputs(u);
+}
+
+void
+ExpTransient::reduce() {
+    unsigned int n = stateSpace->numStates,
+                 m = stateSpace->numInputs,
+                 p = stateSpace->numOutputs;
+
+    std::vector <double> E(n*n), A(n*n), B(n*m), rowScale(n, 0);
+    std::vector <unsigned int> colPerm(n);
+    for (unsigned int row = 0; row < n; row++) {
+        for (unsigned int col = 0; col < n; col++) {
+            E[row*n + col] = stateSpace->E->value(row, col);
+            A[row*n + col] = stateSpace->A->value(row, col);
+            if (fabs(E[row*n + col]) > rowScale[row]) {
+                rowScale[row] = fabs(E[row*n + col]);
+            }
+        }
+        for (unsigned int col = 0; col < m; col++) {
+            B[row*m + col] = stateSpace->B->value(row, col);
+        }
+        colPerm[row] = row;
+    }
+
+    // Gaussian elimination of E with complete pivoting. The row operations
+    // are applied also to A and B and the column permutations to A. Pivots
+    // comparable to the rounding errors of their original rows are zero.
+    numDiff = 0;
+    for (unsigned int k = 0; k < n; k++) {
+        unsigned int pivRow = k, pivCol = k;
+        double pivRel = 0;
+        for (unsigned int row = k; row < n; row++) {
+            if (rowScale[row] == 0) continue;
+            for (unsigned int col = k; col < n; col++) {
+                double rel = fabs(E[row*n + col])/rowScale[row];
+                if (rel > pivRel) {
+                    pivRel = rel;
+                    pivRow = row;
+                    pivCol = col;
+                }
+            }
+        }
+        if (pivRel < 1e-10) {
+            break;
+        }
+        numDiff++;
+
+        for (unsigned int col = 0; col < n; col++) {
+            std::swap(E[k*n + col], E[pivRow*n + col]);
+            std::swap(A[k*n + col], A[pivRow*n + col]);
+        }
+        for (unsigned int col = 0; col < m; col++) {
+            std::swap(B[k*m + col], B[pivRow*m + col]);
+        }
+        std::swap(rowScale[k], rowScale[pivRow]);
+        for (unsigned int row = 0; row < n; row++) {
+            std::swap(E[row*n + k], E[row*n + pivCol]);
+            std::swap(A[row*n + k], A[row*n + pivCol]);
+        }
+        std::swap(colPerm[k], colPerm[pivCol]);
+
+        for (unsigned int row = k + 1; row < n; row++) {
+            double factor = E[row*n + k]/E[k*n + k];
+            if (factor == 0) continue;
+            for (unsigned int col = 0; col < n; col++) {
+                E[row*n + col] -= factor*E[k*n + col];
+                A[row*n + col] -= factor*A[k*n + col];
+            }
+            for (unsigned int col = 0; col < m; col++) {
+                B[row*m + col] -= factor*B[k*m + col];
+            }
+        }
+    }
+
+    // With y = P^T x, the eliminated system reads
+    // [U11 U12; 0 0] y' = A y + B u. The column operation y = [I -K; 0 I] w
+    // with K = U11^-1 U12 decouples the differential variables w1 = z from
+    // the algebraic variables w2.
+    unsigned int r = numDiff, q = n - numDiff;
+    std::vector <double> U11(r*r), K(r*q);
+    for (unsigned int row = 0; row < r; row++) {
+        for (unsigned int col = 0; col < r; col++) {
+            U11[row*r + col] = E[row*n + col];
+        }
+        for (unsigned int col = 0; col < q; col++) {
+            K[row*q + col] = E[row*n + r + col];
+        }
+    }
+    if (r > 0 && q > 0) {
+        solveDense(U11, r, K, q);
+    }
+    for (unsigned int row = 0; row < n; row++) {
+        for (unsigned int col = 0; col < q; col++) {
+            for (unsigned int l = 0; l < r; l++) {
+                A[row*n + r + col] -= A[row*n + l]*K[l*q + col];
+            }
+        }
+    }
+
+    // The algebraic equations 0 = A21 z + A22 w2 + B2 u give
+    // w2 = F z + Gu u with [F Gu] = -A22^-1 [A21 B2].
+    std::vector <double> A22(q*q), FG(q*(r + m));
+    for (unsigned int row = 0; row < q; row++) {
+        for (unsigned int col = 0; col < q; col++) {
+            A22[row*q + col] = A[(r + row)*n + r + col];
+        }
+        for (unsigned int col = 0; col < r; col++) {
+            FG[row*(r + m) + col] = -A[(r + row)*n + col];
+        }
+        for (unsigned int col = 0; col < m; col++) {
+            FG[row*(r + m) + r + col] = -B[(r + row)*m + col];
+        }
+    }
+    if (q > 0) {
+        solveDense(A22, q, FG, r + m);
+    }
+
+    // U11 z' = (A11 + A12 F) z + (B1 + A12 Gu) u.
+    std::vector <double> AB(r*(r + m));
+    for (unsigned int row = 0; row < r; row++) {
+        for (unsigned int col = 0; col < r + m; col++) {
+            double val = (col < r) ? A[row*n + col] : B[row*m + col - r];
+            for (unsigned int l = 0; l < q; l++) {
+                val += A[row*n + r + l]*FG[l*(r + m) + col];
+            }
+            AB[row*(r + m) + col] = val;
+        }
+    }
+    if (r > 0) {
+        solveDense(U11, r, AB, r + m);
+    }
+    Ar.assign(r*r, 0);
+    Br.assign(r*m, 0);
+    for (unsigned int row = 0; row < r; row++) {
+        for (unsigned int col = 0; col < r; col++) {
+            Ar[row*r + col] = AB[row*(r + m) + col];
+        }
+        for (unsigned int col = 0; col < m; col++) {
+            Br[row*m + col] = AB[row*(r + m) + r + col];
+        }
+    }
+
+    // y = [z - K w2; w2] and x = P y. The outputs are C x + D u.
+    std::vector <double> Mx(n*r, 0), Mu(n*m, 0);
+    for (unsigned int row = 0; row < q; row++) {
+        for (unsigned int col = 0; col < r + m; col++) {
+            double val = FG[row*(r + m) + col];
+            if (col < r) {
+                Mx[(r + row)*r + col] = val;
+            } else {
+                Mu[(r + row)*m + col - r] = val;
+            }
+            for (unsigned int l = 0; l < r; l++) {
+                if (col < r) {
+                    Mx[l*r + col] -= K[l*q + row]*val;
+                } else {
+                    Mu[l*m + col - r] -= K[l*q + row]*val;
+                }
+            }
+        }
+    }
+    for (unsigned int row = 0; row < r; row++) {
+        Mx[row*r + row] += 1;
+    }
+
+    Cr.assign(p*r, 0);
+    Dr.assign(p*m, 0);
+    for (unsigned int row = 0; row < p; row++) {
+        for (unsigned int col = 0; col < m; col++) {
+            Dr[row*m + col] = stateSpace->D->value(row, col);
+        }
+        for (unsigned int j = 0; j < n; j++) {
+            double c = stateSpace->C->value(row, colPerm[j]);
+            if (c == 0) continue;
+            for (unsigned int col = 0; col < r; col++) {
+                Cr[row*r + col] += c*Mx[j*r + col];
+            }
+            for (unsigned int col = 0; col < m; col++) {
+                Dr[row*m + col] += c*Mu[j*m + col];
+            }
+        }
+    }
+}
+
+void
+ExpTransient::solveDense(std::vector <double> M, unsigned int n,
+                         std::vector <double> &rhs, unsigned int numRhs) {
+    // Gaussian elimination with partial pivoting for the n x n matrix M and
+    // the n x numRhs right-hand side rhs, which is replaced by the solution.
+    for (unsigned int k = 0; k < n; k++) {
+        unsigned int pivRow = k;
+        for (unsigned int row = k + 1; row < n; row++) {
+            if (fabs(M[row*n + k]) > fabs(M[pivRow*n + k])) {
+                pivRow = row;
+            }
+        }
+        if (M[pivRow*n + k] == 0) {
+            std::cerr << "EXPTRANSIENT : Singular matrix - The circuit has floating nodes, "
+                      << "loops of capacitances and voltage sources or cutsets of "
+                      << "inductances and current sources!" << std::endl;
+            exit(-1);
+        }
+        if (pivRow != k) {
+            for (unsigned int col = 0; col < n; col++) {
+                std::swap(M[k*n + col], M[pivRow*n + col]);
+            }
+            for (unsigned int col = 0; col < numRhs; col++) {
+                std::swap(rhs[k*numRhs + col], rhs[pivRow*numRhs + col]);
+            }
+        }
+        for (unsigned int row = k + 1; row < n; row++) {
+            double factor = M[row*n + k]/M[k*n + k];
+            if (factor == 0) continue;
+            for (unsigned int col = k; col < n; col++) {
+                M[row*n + col] -= factor*M[k*n + col];
+            }
+            for (unsigned int col = 0; col < numRhs; col++) {
+                rhs[row*numRhs + col] -= factor*rhs[k*numRhs + col];
+            }
+        }
+    }
+    for (int row = n - 1; row >= 0; row--) {
+        for (unsigned int col = 0; col < numRhs; col++) {
+            double val = rhs[row*numRhs + col];
+            for (unsigned int l = row + 1; l < n; l++) {
+                val -= M[row*n + l]*rhs[l*numRhs + col];
+            }
+            rhs[row*numRhs + col] = val/M[row*n + row];
+        }
+    }
+}
+
+void
+ExpTransient::expm(std::vector <double> &H, unsigned int n) {
+    // Scaling and squaring with the diagonal Pade approximation of degree 6.
+    const unsigned int degree = 6;
+
+    double norm = 0;
+    for (unsigned int row = 0; row < n; row++) {
+        double rowSum = 0;
+        for (unsigned int col = 0; col < n; col++) {
+            rowSum += fabs(H[row*n + col]);
+        }
+        if (rowSum > norm) {
+            norm = rowSum;
+        }
+    }
+    int numSquarings = 0;
+    if (norm > 0.5) {
+        numSquarings = (int) ceil(log(norm/0.5)/log(2.0));
+    }
+    double scale = ldexp(1.0, -numSquarings);
+
+    std::vector <double> X(n*n), power(n*n, 0), tmp(n*n), N(n*n, 0), D(n*n, 0);
+    for (unsigned int ind = 0; ind < n*n; ind++) {
+        X[ind] = H[ind]*scale;
+    }
+    for (unsigned int ind = 0; ind < n; ind++) {
+        power[ind*n + ind] = 1;
+    }
+    double c = 1;
+    for (unsigned int k = 0; k <= degree; k++) {
+        if (k > 0) {
+            c *= (double)(degree - k + 1)/(double)(k*(2*degree - k + 1));
+            for (unsigned int row = 0; row < n; row++) {
+                for (unsigned int col = 0; col < n; col++) {
+                    double val = 0;
+                    for (unsigned int l = 0; l < n; l++) {
+                        val += power[row*n + l]*X[l*n + col];
+                    }
+                    tmp[row*n + col] = val;
+                }
+            }
+            power.swap(tmp);
+        }
+        double sign = (k % 2) ? -1 : 1;
+        for (unsigned int ind = 0; ind < n*n; ind++) {
+            N[ind] += c*power[ind];
+            D[ind] += sign*c*power[ind];
+        }
+    }
+    solveDense(D, n, N, n);
+
+    for (int ind = 0; ind < numSquarings; ind++) {
+        for (unsigned int row = 0; row < n; row++) {
+            for (unsigned int col = 0; col < n; col++) {
+                double val = 0;
+                for (unsigned int l = 0; l < n; l++) {
+                    val += N[row*n + l]*N[l*n + col];
+                }
+                tmp[row*n + col] = val;
+            }
+        }
+        N.swap(tmp);
+    }
+    H.swap(N);
+}
+
+bool
+ExpTransient::krylovStep(double h, const std::vector <double> &b0,
+                         const std::vector <double> &b1, bool force) {
+    // With the sources u(t + s) = u0 + s*(u1 - u0)/h, the solution at t + h
+    // is the first numDiff components of exp(h*Aa) [z; 0; 1], where
+    // Aa = [Ar b1 b0; 0 0 1; 0 0 0], b0 = Br u0 and b1 = Br (u1 - u0)/h.
+    unsigned int r = numDiff, n = numDiff + 2;
+    unsigned int mMax = (krylovDim < n) ? krylovDim : n;
+
+    std::vector <std::vector <double> > V(mMax + 1, std::vector <double> (n, 0));
+    std::vector <double> H((mMax + 1)*mMax, 0);
+
+    double beta = 1;
+    for (unsigned int ind = 0; ind < r; ind++) {
+        beta += z[ind]*z[ind];
+    }
+    beta = sqrt(beta);
+    for (unsigned int ind = 0; ind < r; ind++) {
+        V[0][ind] = z[ind]/beta;
+    }
+    V[0][r + 1] = 1/beta;
+
+    // Arnoldi iteration with modified Gram-Schmidt orthogonalization.
+    unsigned int m = mMax;
+    bool breakdown = false;
+    for (unsigned int j = 0; j < mMax; j++) {
+        std::vector <double> &v = V[j], &w = V[j + 1];
+        for (unsigned int row = 0; row < r; row++) {
+            double val = b1[row]*v[r] + b0[row]*v[r + 1];
+            for (unsigned int col = 0; col < r; col++) {
+                val += Ar[row*r + col]*v[col];
+            }
+            w[row] = val;
+        }
+        w[r]     = v[r + 1];
+        w[r + 1] = 0;
+
+        double normW = 0;
+        for (unsigned int ind = 0; ind < n; ind++) {
+            normW += w[ind]*w[ind];
+        }
+        normW = sqrt(normW);
+
+        for (unsigned int i = 0; i <= j; i++) {
+            double dot = 0;
+            for (unsigned int ind = 0; ind < n; ind++) {
+                dot += w[ind]*V[i][ind];
+            }
+            H[i*mMax + j] = dot;
+            for (unsigned int ind = 0; ind < n; ind++) {
+                w[ind] -= dot*V[i][ind];
+            }
+        }
+        double normNext = 0;
+        for (unsigned int ind = 0; ind < n; ind++) {
+            normNext += w[ind]*w[ind];
+        }
+        normNext = sqrt(normNext);
+        H[(j + 1)*mMax + j] = normNext;
+        numArnoldi++;
+
+        if (normNext <= 1e-12*normW) {
+            m = j + 1;
+            breakdown = true;
+            break;
+        }
+        for (unsigned int ind = 0; ind < n; ind++) {
+            w[ind] /= normNext;
+        }
+    }
+
+    std::vector <double> F(m*m);
+    for (unsigned int row = 0; row < m; row++) {
+        for (unsigned int col = 0; col < m; col++) {
+            F[row*m + col] = h*H[row*mMax + col];
+        }
+    }
+    expm(F, m);
+
+    if (!breakdown && !force) {
+        double err = beta*H[m*mMax + m - 1]*fabs(F[(m - 1)*m]);
+        if (err > tol*beta) {
+            return false;
+        }
+    }
+
+    for (unsigned int ind = 0; ind < r; ind++) {
+        double val = 0;
+        for (unsigned int k = 0; k < m; k++) {
+            val += V[k][ind]*F[k*m];
+        }
+        z[ind] = beta*val;
+    }
+    return true;
+}
+
+double
+ExpTransient::nextBreakpoint(double _t) {
+    double tBreak = HUGE_VAL;
+    for (unsigned int ind = 0; ind < sourceWfs.size(); ind++) {
+        double tWave = sourceWfs[ind].nextBreakpoint(_t + hMin, sourceStates[ind]);
+        if (tWave < tBreak) {
+            tBreak = tWave;
+        }
+    }
+    return tBreak;
+}
+
+void
+ExpTransient::inputs(double _t, std::vector <double> &u) {
+    u = constInputs;
+    for (unsigned int ind = 0; ind < sourceWfs.size(); ind++) {
+        u[wfInputInds[ind]] = sourceWfs[ind].eval(_t, sourceStates[ind]);
+    }
+}
+
+void
+ExpTransient::computeOutputs(const std::vector <double> &u) {
+    unsigned int r = numDiff, m = stateSpace->numInputs;
+    for (unsigned int row = 0; row < stateSpace->numOutputs; row++) {
+        double val = 0;
+        for (unsigned int col = 0; col < r; col++) {
+            val += Cr[row*r + col]*z[col];
+        }
+        for (unsigned int col = 0; col < m; col++) {
+            val += Dr[row*m + col]*u[col];
+        }
+        outputs[row] = val;
+    }
+}
+
+void
+ExpTransient::signalNames(std::vector <std::string> &names) {
+    names = stateSpace->outputNames;
+}
+
+bool
+ExpTransient::step() {
+    if (t >= t2 - hMin) {
+        return false;
+    }
+
+    // The integration is exact between the breakpoints for linear sources
+    // and thus short steps before the breakpoints do not harm accuracy.
+    double h = dt;
+    double tBreak = nextBreakpoint(t);
+    if (tBreak > t2) {
+        tBreak = t2;
+    }
+    if (t + h >= tBreak - hMin) {
+        h = tBreak - t;
+    }
+    double tNew = t + h;
+
+    unsigned int r = numDiff, m = stateSpace->numInputs;
+    std::vector <double> u0, u1;
+    inputs(t, u0);
+    inputs(tNew, u1);
+
+    std::vector <double> b0(r, 0), b1(r, 0);
+    for (unsigned int row = 0; row < r; row++) {
+        for (unsigned int col = 0; col < m; col++) {
+            b0[row] += Br[row*m + col]*u0[col];
+            b1[row] += Br[row*m + col]*(u1[col] - u0[col])/h;
+        }
+    }
+
+    // Substeps are halved until the Krylov approximation is accurate and
+    // then grown again.
+    double s = 0, hSub = h;
+    while (r > 0 && s < h - hMin) {
+        if (s + hSub > h) {
+            hSub = h - s;
+        }
+        std::vector <double> b0Sub(r);
+        for (unsigned int row = 0; row < r; row++) {
+            b0Sub[row] = b0[row] + s*b1[row];
+        }
+        if (krylovStep(hSub, b0Sub, b1, hSub <= hMin)) {
+            s += hSub;
+            hSub *= 2;
+            numSubsteps++;
+        } else {
+            hSub *= 0.5;
+        }
+    }
+
+    t = tNew;
+    computeOutputs(u1);
+    numSteps++;
+
+    if (verbose) {
+        std::cout << "t = " << t;
+        for (unsigned int ind = 0; ind < outputs.size(); ind++) {
+            std::cout << " " << stateSpace->outputNames[ind] << " = " << outputs[ind];
+        }
+        std::cout << std::endl;
+    }
+    if (writer) {
+        writer->addRow(t, outputs);
+    }
+    return true;
+}
+
+void
+ExpTransient::run() {
+    while (step());
+}
+
+#ifdef EXPTRANSIENT_TEST
+
+#include <string.h>
+
+// The default parameters of the PULSE waveform are set from the time step
+// and the end time on the copy in ExpTransient and the waveform of the
+// parser must be left unchanged.
+static void
+checkParserWaveforms() {
+    std::vector <std::string> lines;
+    lines.push_back("VP 1 0 PULSE (0 1)");
+    lines.push_back("R1 1 2 1k");
+    lines.push_back("C1 2 0 1u");
+    std::vector <cirStatement> stats;
+    for (unsigned int ind = 0; ind < lines.size(); ind++) {
+        stats.push_back(cirStatement(lines[ind]));
+    }
+    Parser parser(stats);
+    StateSpace ss(&parser);
+
+    Waveform &parserWf = *parser.elemList->elements[parser.elemList->find("VP")].waveForm;
+    Waveform parserCopy(parserWf);
+    ExpTransient tran(&parser, &ss, 0.001, 0.01, 0);
+    assert(memcmp(&parserCopy.par, &parserWf.par, sizeof(parserWf.par)) == 0);
+}
+
+int
+main(int argc, char **argv) {
+    std::string fileName = "test_pulse.cir";
+    double dt = 0.01;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (argc >= 3) {
+        dt = atof(argv[2]);
+    }
+
+    cirFile cir(fileName);
+    std::cout << std::endl << "Exponential integration of linear circuit: \""
+              << cir.title << "\"" << std::endl;
+    Parser parser(cir.statList);
+    StateSpace ss(&parser);
+    ss.disp();
+
+    checkParserWaveforms();
+
+    ExpTransient tran(&parser, &ss, dt, 1, 0);
+    // With an output file, the waveforms are written in binary form.
+    RawWriter *writer = 0;
+    if (argc >= 4) {
+        std::vector <std::string> names;
+        tran.signalNames(names);
+        writer = new RawWriter(argv[3], names);
+        tran.writer  = writer;
+        tran.verbose = false;
+    }
+    tran.run();
+    delete writer;
+
+    std::cout << std::endl << tran.numSteps << " steps, " << tran.numSubsteps
+              << " substeps, " << tran.numArnoldi << " Arnoldi iterations" << std::endl;
+}
+
+#endif
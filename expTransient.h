@@ -0,0 +1,113 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef EXPTRANSIENT_H
+#define EXPTRANSIENT_H
+
+#include "parser.h"
+#include "stateSpace.h"
+#include "waveform.h"
+#include "rawWriter.h"
+
+#include <vector>
+
+/* ExpTransient object performs transient solution of a linear circuit by
+ * exponential integration of its state-space model.
+ *
+ * The descriptor system E x' = A x + B u is first reduced to the ordinary
+ * differential equation z' = Ar z + Br u of its differential variables z by
+ * Gaussian elimination of E with complete pivoting. The remaining algebraic
+ * variables and the outputs are linear combinations of z and u. Circuits of
+ * higher index than one, such as loops of capacitances and voltage sources or
+ * cutsets of inductances and current sources, are not supported.
+ *
+ * The sources are interpolated linearly within each time step and the exact
+ * solution of the interpolated problem is obtained from the action of the
+ * matrix exponential of an augmented matrix on a vector. The action is
+ * computed in a Krylov subspace of dimension krylovDim by Arnoldi iteration
+ * and the exponential of the small Hessenberg matrix is computed with
+ * scaling and squaring of a Pade approximation. If the error estimate of the
+ * Krylov approximation exceeds tol, the time step is split into substeps.
+ *
+ * Since the integration is exact for linear sources, the step size is not
+ * limited by the stiffness of the circuit. The time steps have the length dt
+ * except that they end exactly at the breakpoints of the source waveforms.
+ *
+ * t1     Initial time
+ * t2     End time
+ * dt     Maximum time step size
+ */
+
+class ExpTransient {
+public:
+    ExpTransient(Parser *_parser, StateSpace *_stateSpace, double _dt, double _t2,
+                 double _t1=0);
+
+    // Perform the time integration from t1 to t2.
+    void run();
+    // Advance the solution by a single time step. Returns false when the
+    // end time t2 has been reached.
+    bool step();
+    // The first breakpoint of the source waveforms after time _t.
+    double nextBreakpoint(double _t);
+    void signalNames(std::vector <std::string> &names);
+
+    double dt, t1, t2;
+    double t;
+    unsigned int krylovDim;
+    double tol;
+    bool verbose;
+    RawWriter *writer;
+
+    // Number of differential variables.
+    unsigned int numDiff;
+    // Differential variables and output variables at time t.
+    std::vector <double> z;
+    std::vector <double> outputs;
+
+    // Number of time steps, substeps and Arnoldi iterations taken.
+    unsigned int numSteps, numSubsteps, numArnoldi;
+private:
+    Parser     *parser;
+    StateSpace *stateSpace;
+
+    // Sources with waveforms, the states of their evaluation and their
+    // indices in the inputs of the state-space model. The values of the
+    // other sources are constant.
+    std::vector <unsigned int> wfInputInds;
+    std::vector <Waveform> sourceWfs;
+    std::vector <WaveformState> sourceStates;
+    std::vector <double> constInputs;
+
+    // Row-major matrices of the reduced system z' = Ar z + Br u and the
+    // outputs y = Cr z + Dr u.
+    std::vector <double> Ar, Br, Cr, Dr;
+
+    double hMin;
+
+    void reduce();
+    void inputs(double _t, std::vector <double> &u);
+    void computeOutputs(const std::vector <double> &u);
+    bool krylovStep(double h, const std::vector <double> &b0,
+                    const std::vector <double> &b1, bool force);
+    void expm(std::vector <double> &H, unsigned int n);
+    void solveDense(std::vector <double> M, unsigned int n,
+                    std::vector <double> &rhs, unsigned int numRhs);
+};
+
+#endif // EXPTRANSIENT_H
@@ -0,0 +1,57 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "mappedFile.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string &fileName, const std::string &description) {
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << description << " \"" << fileName << "\"!" << std::endl;
+        exit(-1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << description << " \"" << fileName << "\" is empty!" << std::endl;
+        exit(-1);
+    }
+    size = st.st_size;
+    void *addr = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Cannot map " << description << " \"" << fileName << "\"!" << std::endl;
+        exit(-1);
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+    data = (const char *) addr;
+}
+
+MappedFile::~MappedFile() {
+    munmap((void *) data, size);
+}
+
+void
+MappedFile::dropPages(size_t offset, size_t length) const {
+    madvise((void *) (data + offset), length, MADV_DONTNEED);
+}
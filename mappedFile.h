@@ -0,0 +1,46 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <stddef.h>
+
+/* MappedFile object maps a file read-only into memory. The file is unmapped
+ * when the object is destroyed, so objects sharing the mapping hold it with a
+ * shared_ptr. description is used in the error messages, e.g., "PWL file".
+ */
+
+class MappedFile {
+public:
+    MappedFile(const std::string &fileName, const std::string &description);
+    ~MappedFile();
+
+    // Release the resident pages of [offset, offset + length). The pages are
+    // read again from the file when accessed.
+    void dropPages(size_t offset, size_t length) const;
+
+    const char *data;
+    size_t size;
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+#endif // MAPPEDFILE_H
@@ -372,7 +372,7 @@ Matrix::LU(Matrix &L, Matrix &U, Matrix &P) {
   }
 
   for (int i = 0; i < rows-1; i++) {
-    int min     = 0;
+    double min  = 0;
     bool minset = false;
     int destrow = 0;
 
@@ -0,0 +1,192 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "nameTable.h"
+
+static const unsigned int minSlots = 16;
+
+NameTable::NameTable() {
+    slots.assign(minSlots, Slot());
+    mask = minSlots - 1;
+}
+
+uint64_t
+NameTable::hash(const char *str, size_t length) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t ind = 0; ind < length; ind++) {
+        h ^= (unsigned char) str[ind];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void
+NameTable::rehash(unsigned int numSlots) {
+    std::vector <Slot> newSlots(numSlots, Slot());
+    uint64_t newMask = numSlots - 1;
+
+    for (unsigned int entry = 0; entry < hashes.size(); entry++) {
+        uint64_t slotInd = hashes[entry] & newMask;
+        while (newSlots[slotInd].entry != 0) {
+            slotInd = (slotInd + 1) & newMask;
+        }
+        newSlots[slotInd].entry    = entry + 1;
+        newSlots[slotInd].hashHigh = hashes[entry] >> 32;
+    }
+    slots.swap(newSlots);
+    mask = newMask;
+}
+
+void
+NameTable::reserve(unsigned int numNames) {
+    unsigned int numSlots = slots.size();
+    while (numSlots < 2 * (uint64_t) numNames) {
+        numSlots *= 2;
+    }
+    if (numSlots > slots.size()) {
+        rehash(numSlots);
+    }
+}
+
+int
+NameTable::find(const std::string &name) const {
+    return find(name, hash(name));
+}
+
+int
+NameTable::find(const std::string &name, uint64_t nameHash) const {
+    uint32_t hashHigh = nameHash >> 32;
+    uint64_t slotInd = nameHash & mask;
+
+    while (slots[slotInd].entry != 0) {
+        const Slot &slot = slots[slotInd];
+        if (slot.hashHigh == hashHigh && hashes[slot.entry - 1] == nameHash
+         && names[slot.entry - 1] == name) {
+            return slot.entry - 1;
+        }
+        slotInd = (slotInd + 1) & mask;
+    }
+    return -1;
+}
+
+unsigned int
+NameTable::insert(const std::string &name, unsigned int value) {
+    return insert(name, hash(name), value);
+}
+
+unsigned int
+NameTable::insert(const std::string &name, uint64_t nameHash, unsigned int value) {
+    int entry = find(name, nameHash);
+    if (entry >= 0) {
+        return entry;
+    }
+    // The load factor is kept at most 1/2.
+    if (2 * (uint64_t) (names.size() + 1) > slots.size()) {
+        rehash(slots.size() * 2);
+    }
+
+    uint64_t slotInd = nameHash & mask;
+    while (slots[slotInd].entry != 0) {
+        slotInd = (slotInd + 1) & mask;
+    }
+    names.push_back(name);
+    hashes.push_back(nameHash);
+    values.push_back(value);
+    slots[slotInd].entry    = names.size();
+    slots[slotInd].hashHigh = nameHash >> 32;
+
+    return names.size() - 1;
+}
+
+#ifdef NAMETABLE_TEST
+#include <iostream>
+#include <map>
+#include <chrono>
+#include <stdlib.h>
+
+int
+main(int argc, char **argv) {
+    unsigned int numNames = 1000000;
+    if (argc >= 2) {
+        numNames = atoi(argv[1]);
+    }
+
+    std::vector <std::string> strs;
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        strs.push_back("N" + std::to_string(ind));
+    }
+
+    // Insertion with growth and lookups of existing and missing names. The
+    // checks do not rely on assert so that the test is valid with NDEBUG.
+    NameTable table;
+    unsigned int numErrors = 0;
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        unsigned int entry = table.insert(strs[ind], 2 * ind);
+        if (entry != ind) numErrors++;
+    }
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        unsigned int entry = table.insert(strs[ind], 0);
+        int found = table.find(strs[ind]);
+        if (entry != ind || found != (int) ind) numErrors++;
+        if (table.value(ind) != 2 * ind || table.name(ind) != strs[ind]) numErrors++;
+    }
+    if (table.find("M0") != -1 || table.find("") != -1) numErrors++;
+    if (table.size() != numNames) numErrors++;
+    if (numErrors > 0) {
+        std::cerr << "NameTable: " << numErrors << " errors!" << std::endl;
+        exit(-1);
+    }
+    std::cout << "NameTable: " << table.size() << " names OK" << std::endl;
+
+    // Comparison of the lookups to std::map.
+    std::map <std::string, unsigned int> mapNames;
+    NameTable bulk;
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        mapNames[strs[ind]] = ind;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    bulk.reserve(numNames);
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        unsigned int entry = bulk.insert(strs[ind], ind);
+        if (entry != ind) numErrors++;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    unsigned long sumMap = 0, sumTable = 0;
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        sumMap += mapNames[strs[(ind * 7919ULL) % numNames]];
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    for (unsigned int ind = 0; ind < numNames; ind++) {
+        sumTable += bulk.value(bulk.find(strs[(ind * 7919ULL) % numNames]));
+    }
+    auto t4 = std::chrono::steady_clock::now();
+    if (sumMap != sumTable || numErrors > 0) {
+        std::cerr << "NameTable: lookups differ from std::map!" << std::endl;
+        exit(-1);
+    }
+
+    std::chrono::duration<double> dMap = t1 - t0, dTable = t2 - t1,
+                                  fMap = t3 - t2, fTable = t4 - t3;
+    std::cout << "Build  : std::map " << dMap.count() << " s, NameTable "
+              << dTable.count() << " s" << std::endl;
+    std::cout << "Lookup : std::map " << fMap.count() << " s, NameTable "
+              << fTable.count() << " s" << std::endl;
+}
+#endif
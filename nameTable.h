@@ -0,0 +1,91 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+/* NameTable object is a hash table from strings to unsigned integers used to
+ * resolve the names of nodes and elements in large netlists.
+ *
+ * The table uses open addressing with linear probing in a power-of-two
+ * number of slots, which is kept at least twice the number of names. Each
+ * slot contains the index of the entry and the upper half of the 64-bit hash
+ * of its name so that the names are compared only when the hashes match.
+ * The full hashes of the entries are stored so that the table is grown
+ * without hashing the names again.
+ *
+ * The entries are numbered in the order of insertion and never removed. The
+ * names are stored in a deque so that the references returned by name stay
+ * valid when the table grows.
+ */
+
+class NameTable {
+public:
+    NameTable();
+
+    // Allocate the slots for numNames names, e.g., before a bulk insertion.
+    void reserve(unsigned int numNames);
+
+    // Returns the index of the entry of the name, which is added with the
+    // given value if not found. The value of an existing entry is unchanged.
+    unsigned int insert(const std::string &name, unsigned int value);
+    unsigned int insert(const std::string &name, uint64_t nameHash, unsigned int value);
+    // Returns the index of the entry of the name or -1 if not found.
+    int find(const std::string &name) const;
+    int find(const std::string &name, uint64_t nameHash) const;
+
+    unsigned int size() const {
+        return names.size();
+    }
+    const std::string &name(unsigned int entry) const {
+        return names[entry];
+    }
+    unsigned int &value(unsigned int entry) {
+        return values[entry];
+    }
+    unsigned int value(unsigned int entry) const {
+        return values[entry];
+    }
+
+    // 64-bit FNV-1a hash.
+    static uint64_t hash(const char *str, size_t length);
+    static uint64_t hash(const std::string &str) {
+        return hash(str.data(), str.size());
+    }
+private:
+    // entry is the index of the entry plus one, zero in empty slots.
+    struct Slot {
+        uint32_t entry;
+        uint32_t hashHigh;
+    };
+    std::vector <Slot> slots;
+    uint64_t mask;
+
+    std::deque <std::string> names;
+    std::vector <uint64_t> hashes;
+    std::vector <unsigned int> values;
+
+    void rehash(unsigned int numSlots);
+};
+
+#endif // NAMETABLE_H
@@ -16,7 +16,6 @@
 */
 
 #include "nodeList.h"
-#include <sstream>
 
 NodeList::NodeList(std::vector<std::string> &_nodeStrings) {
     std::set<std::string> nodeStrSet;
@@ -30,9 +29,38 @@ NodeList::NodeList(std::set<std::string> &_nodeStrings) {
     parseSet(_nodeStrings);
 }
 
+NodeList::NodeList(const std::vector<Element> &elements) {
+    unsigned int groundId = symbols.intern(std::string("0"));
+
+    // symbolNode is allocated for all the symbols at once and marks the
+    // nodes already found.
+    symbolNode.assign(symbols.size(), -1);
+    mapSymbol(std::string("0"), 0);
+    mapNodeString.push_back(std::string("0"));
+
+    bool gndFound = false;
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        const std::vector <unsigned int> &nodeIds = elements[indElem].nodeIds;
+
+        for (unsigned int indNode = 0; indNode < nodeIds.size(); indNode++) {
+            unsigned int symbolId = nodeIds[indNode];
+            if (symbolId == groundId) {
+                gndFound = true;
+            } else if (symbolNode[symbolId] < 0) {
+                symbolNode[symbolId] = nodeSymbol.size();
+                nodeSymbol.push_back(symbolId);
+                mapNodeString.push_back(elements[indElem].nodeList[indNode]);
+            }
+        }
+    }
+    assert(gndFound || elements.size() == 0);
+    numNodes = mapNodeString.size();
+}
+
 NodeList::NodeList(const NodeList &nodeList) {
     mapNodeString = nodeList.mapNodeString;
-    mapStringNode = nodeList.mapStringNode;
+    symbolNode    = nodeList.symbolNode;
+    nodeSymbol    = nodeList.nodeSymbol;
     numNodes      = nodeList.numNodes;
 }
 
@@ -41,8 +69,8 @@ NodeList::parseSet(std::set<std::string> &_nodeStrings) {
     unsigned int nodeInd = 0;
     bool gndFound = false;
 
-    mapStringNode[std::string("0")] = 0;
     mapNodeString.push_back(std::string("0"));
+    mapSymbol(std::string("0"), 0);
 
     for (std::set<std::string>::iterator it=_nodeStrings.begin(); it!=_nodeStrings.end(); ++it) {
         std::string nodeStr = *it;
@@ -53,8 +81,8 @@ NodeList::parseSet(std::set<std::string> &_nodeStrings) {
             gndFound = true;
         } else {
             nodeInd++;
-            mapStringNode[nodeStr] = nodeInd;
             mapNodeString.push_back(nodeStr);
+            mapSymbol(nodeStr, nodeInd);
         }
     }
     assert(gndFound);
@@ -63,11 +91,11 @@ NodeList::parseSet(std::set<std::string> &_nodeStrings) {
 }
 
 unsigned int
-NodeList::addNode(std::string &nodeStr) {
+NodeList::addNode(const std::string &nodeStr) {
     assert(!nodeExists(nodeStr));
 
-    mapStringNode[nodeStr] = numNodes;
     mapNodeString.push_back(nodeStr);
+    mapSymbol(nodeStr, numNodes);
     numNodes++;
 
     return numNodes-1;
@@ -76,30 +104,44 @@ NodeList::addNode(std::string &nodeStr) {
 unsigned int
 NodeList::addNode() {
     unsigned int strint = numNodes;
-    std::stringstream ss;
-    std::string s;
 
     // If the string constructed from the new node number is reserved, select
     // smallest free positive integer for the name.
-    while (1) {
-        ss.str(std::string());
-        ss << strint;
-        s = ss.str();
-        if  (!nodeExists(s)) break;
+    while (nodeExists(std::to_string(strint))) {
         strint++;
     }
-    return addNode(s);
+    return addNode(std::to_string(strint));
+}
+
+void
+NodeList::mapSymbol(const std::string &nodeStr, unsigned int nodeInd) {
+    unsigned int symbolId = symbols.intern(nodeStr);
+    if (symbolId >= symbolNode.size()) {
+        symbolNode.resize(symbolId + 1, -1);
+    }
+    symbolNode[symbolId] = nodeInd;
+    assert(nodeSymbol.size() == nodeInd);
+    nodeSymbol.push_back(symbolId);
+}
+
+int
+NodeList::findNode(const std::string &nodeStr) const {
+    int symbolId = symbols.find(nodeStr);
+    if (symbolId < 0 || !hasNode(symbolId)) {
+        return -1;
+    }
+    return symbolNode[symbolId];
 }
 
 bool
-NodeList::nodeExists(std::string &nodeStr) {
-    return mapStringNode.find(nodeStr) != mapStringNode.end();
+NodeList::nodeExists(const std::string &nodeStr) const {
+    return findNode(nodeStr) >= 0;
 }
 
 void
 NodeList::disp() {
-    for (std::map<std::string, unsigned int>::iterator it=mapStringNode.begin(); it!=mapStringNode.end(); ++it) {
-        std::cout << "\"" << it->first << "\" -> " << it->second << std::endl;
+    for (unsigned int nodeInd = 0; nodeInd < numNodes; nodeInd++) {
+        std::cout << "\"" << mapNodeString[nodeInd] << "\" -> " << nodeInd << std::endl;
     }
 }
 
@@ -121,14 +163,40 @@ main(int argc, char **argv) {
 
     std::cout << node << std::endl;
     std::cout << nl.mapNodeString[0] << "<->"
-              << nl.mapStringNode[std::string("0")] << std::endl;
+              << nl.findNode(std::string("0")) << std::endl;
     std::cout << nl.mapNodeString[1] << "<->"
-              << nl.mapStringNode[std::string("foo")] << std::endl;
+              << nl.findNode(std::string("foo")) << std::endl;
     std::cout << nl.mapNodeString[2] << "<->"
-              << nl.mapStringNode[std::string("omena")] << std::endl;
+              << nl.findNode(std::string("omena")) << std::endl;
     std::cout << nl.mapNodeString[3] << "<->"
-              << nl.mapStringNode[std::string("4")] << std::endl;
+              << nl.findNode(std::string("4")) << std::endl;
     std::cout << nl.mapNodeString[4] << "<->"
-              << nl.mapStringNode[std::string("5")] << std::endl;
+              << nl.findNode(std::string("5")) << std::endl;
+
+    for (unsigned int nodeInd = 0; nodeInd < nl.numNodes; nodeInd++) {
+        unsigned int symbolId = symbols.intern(nl.mapNodeString[nodeInd]);
+        assert(nl.node(symbolId) == nodeInd);
+        assert(nl.nodeSymbol[nodeInd] == symbolId);
+        assert(symbols.name(symbolId) == nl.mapNodeString[nodeInd]);
+    }
+    assert(!nl.hasNode(symbols.intern(std::string("bar"))));
+    assert(nl.findNode(std::string("bar")) == -1);
+
+    // Bulk construction from elements numbers the nodes in the order of
+    // first appearance.
+    std::vector <Element> elements;
+    std::string strR1("R1 omena 0 1"), strR2("R2 foo omena 2"), strV1("V1 bar 0 1");
+    elements.push_back(Element(strR1));
+    elements.push_back(Element(strR2));
+    elements.push_back(Element(strV1));
+    NodeList bulk(elements);
+    assert(bulk.numNodes == 4);
+    assert(bulk.findNode(std::string("0")) == 0);
+    assert(bulk.findNode(std::string("omena")) == 1);
+    assert(bulk.findNode(std::string("foo")) == 2);
+    assert(bulk.findNode(std::string("bar")) == 3);
+    assert(bulk.mapNodeString[2] == "foo");
+    assert(bulk.findNode(std::string("4")) == -1);
+    std::cout << symbols.size() << " symbols" << std::endl;
 }
 #endif
@@ -21,36 +21,59 @@
 #include <iostream>
 #include <vector>
 #include <set>
-#include <map>
 #include <assert.h>
 
+#include "symbolTable.h"
+#include "element.h"
+
 // The nodes in a SPICE circuits are labeled with strings. A NodeList object
 // maps the names of the nodes in a NetList to integer indices. The mandatory
 // ground node "0" is always given the integer value dof 0.
 
-// The constructor is given a vector or set of node names.
+// The constructor is given a vector or set of node names, which are numbered
+// in alphabetical order, or the elements of the circuit, whose nodes are
+// numbered in the order of first appearance. The latter is used by Parser to
+// build large node lists without sorting or hashing the node names.
+
+// symbolNode maps the ids of the node names in the global SymbolTable to the
+// integer indices, or -1 for names not in the list, so that the solvers can
+// look up the nodes of the elements without comparing strings. nodeSymbol is
+// the inverse mapping. The names are resolved through the SymbolTable.
 
 class NodeList {
 public:
     NodeList(const NodeList &nodeList);
     NodeList(std::set<std::string> &_nodeStrings);
     NodeList(std::vector<std::string> &_nodeStrings);
+    NodeList(const std::vector<Element> &elements);
 
     ~NodeList();
 
     // Addition of dummy nodes is necessary when replacing an element with
     // a series combination of elements.
-    bool nodeExists(std::string &nodeStr);
-    unsigned int addNode(std::string &nodeStr);
+    bool nodeExists(const std::string &nodeStr) const;
+    unsigned int addNode(const std::string &nodeStr);
     unsigned int addNode();
     void disp();
 
-    std::map <std::string, unsigned int> mapStringNode;
+    bool hasNode(unsigned int symbolId) const {
+        return symbolId < symbolNode.size() && symbolNode[symbolId] >= 0;
+    }
+    unsigned int node(unsigned int symbolId) const {
+        assert(hasNode(symbolId));
+        return symbolNode[symbolId];
+    }
+    // Index of the node with the given name or -1 if not found.
+    int findNode(const std::string &nodeStr) const;
+
     std::vector <std::string> mapNodeString;
+    std::vector <int> symbolNode;
+    std::vector <unsigned int> nodeSymbol;
 
     unsigned int numNodes;
 private:
     void parseSet(std::set <std::string> &_nodeStrings);
+    void mapSymbol(const std::string &nodeStr, unsigned int nodeInd);
 };
 
 #endif // NODELIST_H
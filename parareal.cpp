@@ -0,0 +1,266 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "parareal.h"
+
+#include <thread>
+#include <algorithm>
+#include <math.h>
+#include <time.h>
+
+// CPU time of the calling thread in seconds.
+static double
+threadTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+Parareal::Parareal(Parser *_parser, double _dt, double _t2, double _t1, double _theta,
+                   unsigned int _method, unsigned int _numSlices, unsigned int _numThreads) {
+    parser     = _parser;
+    dt         = _dt;
+    t1         = _t1;
+    t2         = _t2;
+    theta      = _theta;
+    method     = _method;
+    numSlices  = _numSlices;
+    numThreads = _numThreads;
+    maxIter    = numSlices;
+    numIter    = 0;
+    fineTime   = 0;
+    coarseTime = 0;
+    tol        = 1e-6;
+    writer     = 0;
+    coarse     = 0;
+
+    assert(numSlices > 0 && numThreads > 0);
+
+    // By default, the coarse propagator takes four steps over each slice
+    // except at the breakpoints of the sources.
+    coarseDt = 0.25*(t2 - t1)/numSlices;
+
+    for (unsigned int slice = 0; slice <= numSlices; slice++) {
+        sliceTimes.push_back(t1 + (t2 - t1)*slice/numSlices);
+    }
+    sliceTimes[numSlices] = t2;
+
+    // The fine propagators are constructed here since the construction is
+    // not thread-safe.
+    for (unsigned int slice = 0; slice < numSlices; slice++) {
+        Transient *tran = new Transient(parser, dt, t2, t1, theta, method);
+        tran->verbose = false;
+        fine.push_back(tran);
+    }
+    fineStates.resize(numSlices);
+    fineRows.resize(numSlices);
+    threadTimes.resize(numThreads);
+}
+
+Parareal::~Parareal() {
+    for (unsigned int slice = 0; slice < numSlices; slice++) {
+        delete fine[slice];
+    }
+    fine.clear();
+    delete coarse;
+    coarse = 0;
+}
+
+void
+Parareal::signalNames(std::vector <std::string> &names) {
+    fine[0]->signalNames(names);
+}
+
+void
+Parareal::propagateCoarse(unsigned int slice, const std::vector <double> &state,
+                          std::vector <double> &result) {
+    // The currents of the initial state of the first slice are not consistent.
+    coarse->setState(sliceTimes[slice], state, slice > 0);
+    coarse->advance(sliceTimes[slice + 1]);
+    coarse->getState(result);
+}
+
+void
+Parareal::propagateFine(unsigned int slice) {
+    Transient *tran = fine[slice];
+
+    fineRows[slice].clear();
+    tran->setState(sliceTimes[slice], states[slice], slice > 0);
+    if (writer) {
+        tran->advance(sliceTimes[slice + 1], &fineRows[slice]);
+    } else {
+        tran->advance(sliceTimes[slice + 1]);
+    }
+    tran->getState(fineStates[slice]);
+}
+
+void
+Parareal::fineWorker(unsigned int firstSlice, unsigned int thread) {
+    double timeStart = threadTime();
+    for (unsigned int slice = firstSlice + thread; slice < numSlices; slice += numThreads) {
+        propagateFine(slice);
+    }
+    threadTimes[thread] = threadTime() - timeStart;
+}
+
+void
+Parareal::run() {
+    delete coarse;
+    coarse = new Transient(parser, coarseDt, t2, t1, theta, Transient::METHOD_TRBDF2);
+    coarse->verbose = false;
+    fineTime = coarseTime = 0;
+
+    // Initial state and the initial coarse sweep. coarseStates[n] contains
+    // the coarse propagation of states[n].
+    double timeStart = threadTime();
+    std::vector <std::vector <double> > coarseStates(numSlices);
+    states.resize(numSlices + 1);
+    coarse->getState(states[0]);
+    for (unsigned int slice = 0; slice < numSlices; slice++) {
+        propagateCoarse(slice, states[slice], coarseStates[slice]);
+        states[slice + 1] = coarseStates[slice];
+    }
+    coarseTime += threadTime() - timeStart;
+
+    unsigned int numState = states[0].size();
+    std::vector <double> coarseNew;
+
+    for (numIter = 0; numIter < maxIter; numIter++) {
+        // Fine propagation of the slices not yet exact in parallel.
+        std::vector <std::thread> threads;
+        for (unsigned int thread = 0; thread < numThreads; thread++) {
+            threads.push_back(std::thread(&Parareal::fineWorker, this, numIter, thread));
+        }
+        for (unsigned int thread = 0; thread < numThreads; thread++) {
+            threads[thread].join();
+        }
+        fineTime += *std::max_element(threadTimes.begin(), threadTimes.end());
+
+        // Sequential correction with the coarse propagator. The state at the
+        // end of slice numIter is that of the fine propagation.
+        timeStart = threadTime();
+        std::vector <double> scale(numState, 0);
+        double maxChange = 0;
+        std::vector <double> change(numState, 0);
+
+        for (unsigned int slice = numIter; slice < numSlices; slice++) {
+            std::vector <double> stateNew(numState);
+            if (slice == numIter) {
+                stateNew = fineStates[slice];
+                propagateCoarse(slice, states[slice], coarseNew);
+            } else {
+                propagateCoarse(slice, states[slice], coarseNew);
+                for (unsigned int ind = 0; ind < numState; ind++) {
+                    stateNew[ind] = coarseNew[ind] + fineStates[slice][ind]
+                                  - coarseStates[slice][ind];
+                }
+            }
+            coarseStates[slice] = coarseNew;
+
+            for (unsigned int ind = 0; ind < numState; ind++) {
+                double diff = fabs(stateNew[ind] - states[slice + 1][ind]);
+                if (diff > change[ind]) change[ind] = diff;
+                if (fabs(stateNew[ind]) > scale[ind]) scale[ind] = fabs(stateNew[ind]);
+            }
+            states[slice + 1] = stateNew;
+        }
+        coarseTime += threadTime() - timeStart;
+        for (unsigned int ind = 0; ind < numState; ind++) {
+            if (scale[ind] > 0 && change[ind]/scale[ind] > maxChange) {
+                maxChange = change[ind]/scale[ind];
+            }
+        }
+
+        if (maxChange <= tol) {
+            numIter++;
+            break;
+        }
+    }
+
+    // The fine solutions of the last iteration start from the converged
+    // states. Slices before the last iteration were exact already earlier.
+    if (writer) {
+        for (unsigned int slice = 0; slice < numSlices; slice++) {
+            std::vector <double> &rows = fineRows[slice];
+            unsigned int rowLength = writer->numSignals + 1;
+            for (unsigned int indRow = 0; indRow + rowLength <= rows.size(); indRow += rowLength) {
+                writer->addRow(rows[indRow], &rows[indRow + 1]);
+            }
+        }
+    }
+}
+
+#ifdef PARAREAL_TEST
+
+// Wall-clock time in seconds.
+static double
+wallTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+int
+main(int argc, char **argv) {
+    std::string fileName = "test_pulse.cir";
+    unsigned int numSlices = 16, numThreads = 16;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (argc >= 3) {
+        numSlices = atoi(argv[2]);
+        numThreads = numSlices;
+    }
+    if (argc >= 4) {
+        numThreads = atoi(argv[3]);
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+
+    Transient tran(&parser, 0.0001, 0.2, 0, 0.5, Transient::METHOD_TRBDF2);
+    tran.verbose = false;
+    double timeStart = threadTime();
+    tran.run();
+    double serialTime = threadTime() - timeStart;
+
+    Parareal para(&parser, 0.0001, 0.2, 0, 0.5, Transient::METHOD_TRBDF2, numSlices, numThreads);
+    timeStart = wallTime();
+    para.run();
+    double paraWallTime = wallTime() - timeStart;
+
+    // The wall-clock time of Parareal with numThreads cores is the CPU time
+    // of the coarse propagations and the slowest thread of each iteration.
+    // On fewer cores, the measured wall-clock time is longer.
+    std::vector <double> state;
+    tran.getState(state);
+    double paraTime = para.fineTime + para.coarseTime;
+    std::cout << std::endl << "Parareal: " << para.numIter << " iterations, " << numSlices
+              << " slices, " << numThreads << " threads" << std::endl
+              << "  serial fine " << serialTime << " s, Parareal " << paraTime << " s ("
+              << para.fineTime << " s fine, " << para.coarseTime << " s coarse) with "
+              << numThreads << " cores, speedup " << serialTime/paraTime << std::endl
+              << "  measured wall-clock " << paraWallTime << " s on "
+              << std::thread::hardware_concurrency() << " cores" << std::endl;
+    for (unsigned int ind = 0; ind < state.size(); ind++) {
+        std::cout << state[ind] << " " << para.states[numSlices][ind] << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,93 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PARAREAL_H
+#define PARAREAL_H
+
+#include "transient.h"
+
+#include <vector>
+
+/* Parareal object performs transient analysis in parallel in time. The time
+ * interval [t1, t2] is divided into numSlices slices. A cheap coarse
+ * propagator (TR-BDF2 with the time step coarseDt) is applied sequentially
+ * over the slices, whereas the accurate fine propagators (Transient objects
+ * with the given time step and method) are applied to all slices in
+ * parallel with numThreads threads. The states U_n of the energy storage
+ * elements at the slice boundaries are iterated with
+ *
+ *   U^{k+1}_{n+1} = G(U^{k+1}_n) + F(U^k_n) - G(U^k_n),
+ *
+ * where G and F are the coarse and fine propagators, until the relative
+ * change of the states is below tol. After k iterations, the first k slices
+ * are exact and are not propagated again.
+ *
+ * Each iteration reduces the error of the states roughly by the error of
+ * the coarse propagator over a slice, so the number of iterations and thus
+ * the speedup depend on its accuracy. By default, coarseDt is a quarter of
+ * a slice, which is cheap compared to the fine steps and L-stable TR-BDF2
+ * keeps its error small for the time constants shorter than the slices.
+ *
+ * fineTime is the CPU time of the slowest thread summed over the fine
+ * propagations of the iterations and coarseTime the CPU time of the
+ * sequential coarse propagations. Their sum is the wall-clock time of run
+ * with numThreads cores.
+ *
+ * When writer has been constructed with the names from signalNames, the
+ * output variables of the converged fine solution are written in order.
+ */
+
+class Parareal {
+public:
+    Parareal(Parser *_parser, double _dt, double _t2, double _t1, double _theta,
+             unsigned int _method, unsigned int _numSlices, unsigned int _numThreads);
+    ~Parareal();
+
+    void run();
+    void signalNames(std::vector <std::string> &names);
+
+    double dt, t1, t2, theta, coarseDt, tol;
+    unsigned int method, numSlices, numThreads, maxIter, numIter;
+    double fineTime, coarseTime;
+    RawWriter *writer;
+
+    // Slice boundaries and the states at the boundaries.
+    std::vector <double> sliceTimes;
+    std::vector <std::vector <double> > states;
+
+private:
+    Parser *parser;
+
+    // The coarse propagator and fine propagators for each slice.
+    Transient *coarse;
+    std::vector <Transient*> fine;
+
+    // Fine states at the end of each slice and the output rows (time and
+    // output variables) of each slice from the latest fine propagation.
+    std::vector <std::vector <double> > fineStates;
+    std::vector <std::vector <double> > fineRows;
+    // CPU time of each thread in the latest fine propagation.
+    std::vector <double> threadTimes;
+
+    void propagateCoarse(unsigned int slice, const std::vector <double> &state,
+                         std::vector <double> &result);
+    void propagateFine(unsigned int slice);
+    void fineWorker(unsigned int firstSlice, unsigned int thread);
+};
+
+#endif // PARAREAL_H
@@ -27,7 +27,7 @@ Parser::Parser(std::vector<cirStatement> &statList) {
 //    numRefBranches = 0;
 
     for (unsigned int indStat = 0; indStat < statList.size(); indStat++) {
-        cirStatement stat = statList[indStat];
+        const cirStatement &stat = statList[indStat];
 
         std::cout << indStat << ": \"" << stat.strList[0] << "\""
                   << " class=" << stat.statClass
@@ -46,27 +46,23 @@ Parser::Parser(std::vector<cirStatement> &statList) {
 
         // Parse circuit elements and circuit nodes from the statement.
         if (stat.statClass == CLASS_PASSIVE) {
-            Element elem(stat);
-            elements.push_back(elem);
+            elements.push_back(Element(stat));
 //            mapNameElem[stat.strList[0]] = elements.size()-1;
-
-            for (unsigned int indNode = 0; indNode < elem.nodeList.size(); indNode++) {
-                nodeSet.insert(elem.nodeList[indNode]);
-            }
         }
         if (stat.statClass == CLASS_SOURCE) {
-            Element elem(stat);
+            elements.push_back(Element(stat));
            // mapNameElem[stat.strList[0]] = elements.size();
-            elements.push_back(elem);
 
             // Extract the names of reference branches.
 /*            if (stat.type == STAT_CCCS || stat.type == STAT_CCVS) {
                 refElements[elem.elemList[0]] = numRefBranches;
                 numRefBranches++;
             }*/
-            for (unsigned int indNode = 0; indNode < elem.nodeList.size(); indNode++) {
-                nodeSet.insert(elem.nodeList[indNode]);
-            }
+        }
+
+        // Parse output variables.
+        if (stat.statClass == CLASS_POSTPROC) {
+            parseProbes(stat);
         }
 
         // Parse analysis statement.
@@ -118,21 +114,23 @@ Parser::Parser(std::vector<cirStatement> &statList) {
         }
     }
 
-    nodeList = new NodeList(nodeSet);
-    elemList = new ElementList(elements);
+    nodeList = new NodeList(elements);
+    elemList = new ElementList(std::move(elements));
 
     std::cout << std::endl << "Node List:" << std::endl;
 
     nodeList->disp();
+    resolveProbes();
 
     // Check topology of the circuit:
     topology = new Topology(*nodeList);
 
-    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
-        Element elem = elements[indElem];
+    for (unsigned int indElem = 0; indElem < elemList->elements.size(); indElem++) {
+        const Element &elem = elemList->elements[indElem];
 //        assert(elem.nodeList.size() == 2);
 
-        topology->addEdge(elem.nodeList[0], elem.nodeList[1], indElem);
+        topology->addEdge(nodeList->node(elem.nodeIds[0]),
+                          nodeList->node(elem.nodeIds[1]), indElem);
     }
 
     std::vector<int> dist, parent;
@@ -189,6 +187,73 @@ Parser::Parser(std::vector<cirStatement> &statList) {
 
 }
 
+void
+Parser::parseProbes(const cirStatement &stat) {
+    // The optional analysis type (e.g. ".PRINT TRAN") is not needed since
+    // the same output variables are used for all analyses.
+    for (unsigned int indStr = 1; indStr < stat.strList.size(); indStr++) {
+        const std::string &str = stat.strList[indStr];
+        if (str != "DC" && str != "AC" && str != "TRAN" && str != "OP") {
+            std::cerr << "Unknown output variable \"" << str << "\"!" << std::endl;
+            exit(-1);
+        }
+    }
+
+    for (unsigned int indBracket = 0; indBracket < stat.bracketList.size(); indBracket++) {
+        const std::string &bracketName = stat.bracketNames[indBracket];
+        const std::vector <std::string> &bracket = stat.bracketList[indBracket];
+
+        Probe probe;
+        probe.args = bracket;
+        probe.node1 = probe.node2 = probe.elemInd = 0;
+
+        if (bracketName == "V" && (bracket.size() == 1 || bracket.size() == 2)) {
+            probe.type = Probe::PROBE_VOLTAGE;
+            probe.name = "V(" + bracket[0];
+            if (bracket.size() == 2) {
+                probe.name += "," + bracket[1];
+            }
+            probe.name += ")";
+        } else if (bracketName == "I" && bracket.size() == 1) {
+            probe.type = Probe::PROBE_CURRENT;
+            probe.name = "I(" + bracket[0] + ")";
+        } else {
+            std::cerr << "Invalid output variable \"" << bracketName << "(...)\"!" << std::endl;
+            exit(-1);
+        }
+        probes.push_back(probe);
+    }
+}
+
+void
+Parser::resolveProbes() {
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        Probe &probe = probes[indProbe];
+
+        if (probe.type == Probe::PROBE_VOLTAGE) {
+            for (unsigned int indArg = 0; indArg < probe.args.size(); indArg++) {
+                if (!nodeList->nodeExists(probe.args[indArg])) {
+                    std::cerr << "Unknown node \"" << probe.args[indArg] << "\" in "
+                              << probe.name << "!" << std::endl;
+                    exit(-1);
+                }
+            }
+            probe.node1 = nodeList->findNode(probe.args[0]);
+            if (probe.args.size() == 2) {
+                probe.node2 = nodeList->findNode(probe.args[1]);
+            }
+        } else {
+            int elemInd = elemList->find(probe.args[0]);
+            if (elemInd < 0) {
+                std::cerr << "Unknown element \"" << probe.args[0] << "\" in "
+                          << probe.name << "!" << std::endl;
+                exit(-1);
+            }
+            probe.elemInd = elemInd;
+        }
+    }
+}
+
 Parser::~Parser() {
     delete nodeList;
     nodeList = 0;
@@ -199,11 +264,92 @@ Parser::~Parser() {
 }
 
 #ifdef PARSE_TEST
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// Writes a resistor ladder with numNodes non-ground nodes driven by a voltage
+// source for measurement of the parse path with large netlists.
+static void
+writeSynthetic(const std::string &fileName, unsigned int numNodes) {
+    std::ofstream out(fileName.c_str());
+    out << "Synthetic resistor ladder" << std::endl;
+    out << "V1 n1 0 1" << std::endl;
+    for (unsigned int node = 1; node < numNodes; node++) {
+        out << "R" << node << " n" << node << " n" << node + 1 << " 1" << std::endl;
+    }
+    out << "RL n" << numNodes << " 0 1" << std::endl;
+}
 
 int
 main(int argc, char **argv) {
-    cirFile cir(std::string("test.cir"));
+    std::string fileName("test.cir");
+    bool synthetic = false;
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (fileName == "-synthetic") {
+        unsigned int numNodes = 1000000;
+        if (argc >= 3) {
+            numNodes = atoi(argv[2]);
+        }
+        fileName = "synthetic.cir";
+        writeSynthetic(fileName, numNodes);
+        synthetic = true;
+    }
+
+    // The output of the Parser is suppressed while the parse path of the
+    // synthetic netlist is timed.
+    std::streambuf *coutBuf = std::cout.rdbuf();
+    if (synthetic) {
+        std::cout.rdbuf(0);
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    cirFile cir(fileName, numThreads);
+    auto t1 = std::chrono::steady_clock::now();
     Parser par(cir.statList);
+    auto t2 = std::chrono::steady_clock::now();
+
+    // The interned ids resolve to the same nodes and elements as the names.
+    // The nodes are resolved as in the assembly of the MNA matrix.
+    unsigned long nodeSum = 0;
+    for (unsigned int indElem = 0; indElem < par.elemList->elements.size(); indElem++) {
+        const Element &elem = par.elemList->elements[indElem];
+        for (unsigned int indNode = 0; indNode < elem.nodeIds.size(); indNode++) {
+            nodeSum += par.nodeList->node(elem.nodeIds[indNode]);
+        }
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    std::cout.rdbuf(coutBuf);
+
+    for (unsigned int indElem = 0; indElem < par.elemList->elements.size(); indElem++) {
+        const Element &elem = par.elemList->elements[indElem];
+        assert(par.elemList->elem(elem.nameId) == (int) indElem);
+        assert(par.elemList->find(elem.name) == (int) indElem);
+        assert(symbols.name(elem.nameId) == elem.name);
+        for (unsigned int indNode = 0; indNode < elem.nodeList.size(); indNode++) {
+            assert(par.nodeList->node(elem.nodeIds[indNode])
+                   == (unsigned int) par.nodeList->findNode(elem.nodeList[indNode]));
+        }
+    }
+    std::cout << std::endl << "Symbols: " << symbols.size() << std::endl;
+
+    if (synthetic) {
+        std::chrono::duration<double> dRead = t1 - t0, dParse = t2 - t1,
+                                      dResolve = t3 - t2, dTotal = t3 - t0;
+        std::cout << par.nodeList->numNodes << " nodes, "
+                  << par.elemList->elements.size() << " elements (" << nodeSum << ")" << std::endl;
+        std::cout << "Read    " << dRead.count() << " s" << std::endl;
+        std::cout << "Parse   " << dParse.count() << " s" << std::endl;
+        std::cout << "Resolve " << dResolve.count() << " s" << std::endl;
+        std::cout << "Total   " << dTotal.count() << " s" << std::endl;
+    }
+
+    // Statements and elements are moved through the parse path.
+    std::cout << std::endl << "Copies: " << cirStatement::numCopies << " statements, "
+              << Element::numCopies << " elements" << std::endl;
 }
 
 #endif
@@ -27,6 +27,23 @@
 
 #include <stdlib.h>
 
+/* Probe objects correspond to the output variables selected with .PRINT,
+ * .PLOT and .PROBE statements. Voltage probes V(n1) and V(n1,n2) refer to
+ * the node indices node1 and node2 (node2 = 0 when omitted) and current
+ * probes I(name) to the index elemInd of the element in the element list.
+ */
+
+class Probe {
+public:
+    enum{PROBE_VOLTAGE, PROBE_CURRENT};
+
+    unsigned int type;
+    std::string name;
+    std::vector <std::string> args;
+
+    unsigned int node1, node2, elemInd;
+};
+
 /* Parser objects parse a list of SPICE statements into the objects necessary
  * for description of nodes, elements, analysis and post-processing. The list
  * of statements used as a parameter to the constructor is typically obtained
@@ -59,10 +76,15 @@ public:
     unsigned int analysisTypeAC;
     unsigned int analysisACnpoints, analysisACstartFreq, analysisACendFreq;
 
+    // Output variables. When empty, all variables are written.
+    std::vector <Probe> probes;
+
 private:
-    // Circuit elements.
+    void parseProbes(const cirStatement &stat);
+    void resolveProbes();
+
+    // Circuit elements until they are moved into elemList.
     std::vector <Element> elements;
-    std::set <std::string> nodeSet;
 };
 
 #endif // PARSER_H
@@ -0,0 +1,88 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+#include <math.h>
+
+/* Philox object is the Philox4x32-10 counter-based random number generator
+ * of Salmon et al. (2011). Each 128-bit counter is mapped to 128 random bits
+ * with the 64-bit key by ten rounds of multiplications and xors, without any
+ * state between the calls. Random numbers at arbitrary positions of a stream
+ * can thus be computed independently in any order and on any thread, and
+ * the results do not depend on how the work is split.
+ */
+
+class Philox {
+public:
+    Philox(uint32_t key0, uint32_t key1) {
+        key[0] = key0;
+        key[1] = key1;
+    }
+
+    // Fills out with the random bits of the counter (ctr0, ctr1, ctr2, ctr3).
+    void generate(uint32_t ctr0, uint32_t ctr1, uint32_t ctr2, uint32_t ctr3,
+                  uint32_t out[4]) const {
+        uint32_t c0 = ctr0, c1 = ctr1, c2 = ctr2, c3 = ctr3;
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for (unsigned int round = 0; round < 10; round++) {
+            uint64_t prod0 = (uint64_t) 0xD2511F53 * c0,
+                     prod1 = (uint64_t) 0xCD9E8D57 * c2;
+            uint32_t hi0 = (uint32_t) (prod0 >> 32), lo0 = (uint32_t) prod0,
+                     hi1 = (uint32_t) (prod1 >> 32), lo1 = (uint32_t) prod1;
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    // Uniform random number in (0, 1) with 53 random bits from the 64-bit
+    // word (hi, lo).
+    static double toUniform(uint32_t hi, uint32_t lo) {
+        uint64_t bits = (((uint64_t) hi << 32) | lo) >> 11;
+        return (bits + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    // Standard normal random number of the counter (index, stream) obtained
+    // with the Box-Muller transform.
+    double gaussian(uint64_t index, uint32_t stream) const {
+        uint32_t out[4];
+        generate((uint32_t) index, (uint32_t) (index >> 32), stream, 0, out);
+        double u1 = toUniform(out[0], out[1]),
+               u2 = toUniform(out[2], out[3]);
+        return sqrt(-2*log(u1)) * cos(2*M_PI*u2);
+    }
+
+    // Uniform random number in (0, 1) of the counter (index, stream).
+    double uniform(uint64_t index, uint32_t stream) const {
+        uint32_t out[4];
+        generate((uint32_t) index, (uint32_t) (index >> 32), stream, 0, out);
+        return toUniform(out[0], out[1]);
+    }
+
+    uint32_t key[2];
+};
+
+#endif // PHILOX_H
@@ -0,0 +1,199 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "prima.h"
+#include "expTransient.h"
+
+#include <math.h>
+
+Prima::Prima(StateSpace *_full, unsigned int _numBlocks, double _s0) {
+    full      = _full;
+    numBlocks = _numBlocks;
+    s0        = _s0;
+
+    unsigned int n = full->numStates, m = full->numInputs;
+
+    // LU decomposition of s0 E - A is shared by all blocks.
+    Matrix M(n, n), L(n, n), U(n, n), P(n, n);
+    for (unsigned int row = 0; row < n; row++) {
+        for (unsigned int col = 0; col < n; col++) {
+            M.set(row, col, s0*full->E->value(row, col) - full->A->value(row, col));
+        }
+    }
+    M.LU(L, U, P);
+    for (unsigned int ind = 0; ind < n; ind++) {
+        if (U.value(ind, ind) == 0) {
+            std::cerr << "PRIMA : Singular matrix s0 E - A - Select nonzero s0 for circuits "
+                      << "without DC path to the ground!" << std::endl;
+            exit(-1);
+        }
+    }
+
+    std::vector <std::vector <double> > columns;
+    unsigned int blockStart = 0, blockEnd = 0;
+    double *rhs = new double[n];
+
+    for (unsigned int indBlock = 0; indBlock < numBlocks; indBlock++) {
+        std::vector <std::vector <double> > block;
+        if (indBlock == 0) {
+            for (unsigned int col = 0; col < m; col++) {
+                for (unsigned int row = 0; row < n; row++) {
+                    rhs[row] = full->B->value(row, col);
+                }
+                double *x = M.LU_solve(L, U, P, rhs);
+                block.push_back(std::vector <double> (x, x + n));
+                delete [] x;
+            }
+        } else {
+            for (unsigned int col = blockStart; col < blockEnd; col++) {
+                for (unsigned int row = 0; row < n; row++) {
+                    double val = 0;
+                    for (unsigned int ind = 0; ind < n; ind++) {
+                        val += full->E->value(row, ind)*columns[col][ind];
+                    }
+                    rhs[row] = val;
+                }
+                double *x = M.LU_solve(L, U, P, rhs);
+                block.push_back(std::vector <double> (x, x + n));
+                delete [] x;
+            }
+        }
+
+        // Orthogonalization against all previous columns is repeated twice
+        // for numerical stability.
+        blockStart = columns.size();
+        for (unsigned int indCol = 0; indCol < block.size(); indCol++) {
+            std::vector <double> &v = block[indCol];
+            double norm0 = 0;
+            for (unsigned int ind = 0; ind < n; ind++) {
+                norm0 += v[ind]*v[ind];
+            }
+            norm0 = sqrt(norm0);
+
+            for (unsigned int pass = 0; pass < 2; pass++) {
+                for (unsigned int col = 0; col < columns.size(); col++) {
+                    double dot = 0;
+                    for (unsigned int ind = 0; ind < n; ind++) {
+                        dot += v[ind]*columns[col][ind];
+                    }
+                    for (unsigned int ind = 0; ind < n; ind++) {
+                        v[ind] -= dot*columns[col][ind];
+                    }
+                }
+            }
+            double norm = 0;
+            for (unsigned int ind = 0; ind < n; ind++) {
+                norm += v[ind]*v[ind];
+            }
+            norm = sqrt(norm);
+
+            if (norm <= 1e-10*norm0 || norm == 0) {
+                continue;
+            }
+            for (unsigned int ind = 0; ind < n; ind++) {
+                v[ind] /= norm;
+            }
+            columns.push_back(v);
+        }
+        blockEnd = columns.size();
+        if (blockEnd == blockStart) {
+            break;
+        }
+    }
+    delete [] rhs;
+
+    order = columns.size();
+    basis = new Matrix(n, order);
+    for (unsigned int col = 0; col < order; col++) {
+        for (unsigned int row = 0; row < n; row++) {
+            basis->set(row, col, columns[col][row]);
+        }
+    }
+    reduced = new StateSpace(full, *basis);
+}
+
+Prima::~Prima() {
+    delete reduced;
+    delete basis;
+    reduced = 0;
+    basis = 0;
+}
+
+#ifdef PRIMA_TEST
+
+int
+main(int argc, char **argv) {
+    std::string fileName = "test_rcline.cir";
+    unsigned int numBlocks = 4;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (argc >= 3) {
+        numBlocks = atoi(argv[2]);
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+    StateSpace full(&parser);
+    Prima prima(&full, numBlocks);
+
+    std::cout << std::endl << "Reduced " << full.numStates << " states to "
+              << prima.order << " states." << std::endl;
+
+    // Compare the frequency responses of the full and the reduced model.
+    std::cout << std::endl << "Frequency response:" << std::endl;
+    for (double freq = 1; freq <= 1e6; freq *= 10) {
+        Matrix Hre(1, 1), Him(1, 1), HreRed(1, 1), HimRed(1, 1);
+        full.frequencyResponse(freq, Hre, Him);
+        prima.reduced->frequencyResponse(freq, HreRed, HimRed);
+
+        double maxErr = 0;
+        for (unsigned int row = 0; row < full.numOutputs; row++) {
+            for (unsigned int col = 0; col < full.numInputs; col++) {
+                double err = hypot(Hre.value(row, col) - HreRed.value(row, col),
+                                   Him.value(row, col) - HimRed.value(row, col));
+                if (err > maxErr) {
+                    maxErr = err;
+                }
+            }
+        }
+        std::cout << freq << " Hz : H(0,0) = " << Hre.value(0, 0) << " + j"
+                  << Him.value(0, 0) << ", max error " << maxErr << std::endl;
+    }
+
+    // Compare the transient solutions of the full and the reduced model.
+    ExpTransient tranFull(&parser, &full, 0.001, 0.1, 0),
+                 tranRed(&parser, prima.reduced, 0.001, 0.1, 0);
+    tranFull.verbose = false;
+    tranRed.verbose  = false;
+
+    double maxErr = 0;
+    while (tranFull.step()) {
+        tranRed.step();
+        for (unsigned int ind = 0; ind < tranFull.outputs.size(); ind++) {
+            double err = fabs(tranFull.outputs[ind] - tranRed.outputs[ind]);
+            if (err > maxErr) {
+                maxErr = err;
+            }
+        }
+    }
+    std::cout << std::endl << "Transient: max error " << maxErr << std::endl;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PRIMA_H
+#define PRIMA_H
+
+#include "stateSpace.h"
+#include "matrix.h"
+
+/* Prima object computes a reduced-order model of a linear circuit with the
+ * Passive Reduced-order Interconnect Macromodeling Algorithm (PRIMA).
+ *
+ * The orthonormal basis X of the block Krylov subspace
+ *
+ *   span{R, M R, M^2 R, ..., M^(numBlocks-1) R},
+ *   R = (s0 E - A)^-1 B,  M = (s0 E - A)^-1 E,
+ *
+ * is computed by block Arnoldi iteration with modified Gram-Schmidt
+ * orthogonalization and the state-space model is projected by congruence onto
+ * it. The reduced model matches numBlocks block moments of the transfer
+ * functions from the inputs to the states at the expansion point s0. Since the
+ * MNA matrices have the structure E >= 0 and A + A^T <= 0 and the projection
+ * is a congruence, the reduced model preserves passivity.
+ *
+ * Columns, which are linearly dependent on the previous ones, are removed
+ * and thus the order of the reduced model can be smaller than
+ * numBlocks*numInputs.
+ */
+
+class Prima {
+public:
+    Prima(StateSpace *_full, unsigned int _numBlocks, double _s0=0);
+    ~Prima();
+
+    unsigned int numBlocks, order;
+    double s0;
+
+    Matrix *basis;
+    StateSpace *reduced;
+private:
+    StateSpace *full;
+};
+
+#endif // PRIMA_H
@@ -0,0 +1,234 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "pwlFile.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <unistd.h>
+
+PWLFile::PWLFile() {
+    binary = false;
+    numKnots = cursor = 0;
+    totalKnots = droppedBytes = 0;
+    chunkIndex = 0;
+    complete = false;
+}
+
+void
+PWLFile::open(const std::string &_fileName) {
+    fileName = _fileName;
+    mapping = std::shared_ptr <MappedFile> (new MappedFile(fileName, "PWL file"));
+
+    const char magic[8] = {'S', 'S', 'P', 'P', 'W', 'L', '0', '1'};
+    binary = mapping->size >= 8 && memcmp(mapping->data, magic, 8) == 0;
+
+    if (binary) {
+        if ((mapping->size - 8) % (2*sizeof(double)) != 0) {
+            std::cerr << "Truncated PWL file \"" << fileName << "\"!" << std::endl;
+            exit(-1);
+        }
+        totalKnots = (mapping->size - 8)/(2*sizeof(double));
+        numKnots   = totalKnots;
+    } else {
+        chunk.reserve(2*(chunkKnots + 1));
+        chunkOffsets.assign(1, 0);
+        chunkTimes.assign(1, 0);
+        parseChunk(0);
+    }
+    if (numKnots == 0) {
+        std::cerr << "No knots in PWL file \"" << fileName << "\"!" << std::endl;
+        exit(-1);
+    }
+}
+
+bool
+PWLFile::isOpen() const {
+    return mapping.get() != 0;
+}
+
+void
+PWLFile::parseChunk(unsigned int index) {
+    // The chunk contains the knots from index*chunkKnots to
+    // (index + 1)*chunkKnots so that consecutive chunks share a knot.
+    const char *data = mapping->data;
+    size_t size = mapping->size, pos = chunkOffsets[index];
+    char line[256];
+
+    chunk.clear();
+    while (chunk.size() < 2*(chunkKnots + 1) && pos < size) {
+        size_t lineStart = pos;
+        const char *end = (const char *) memchr(data + pos, '\n', size - pos);
+        size_t lineEnd = end ? end - data : size;
+        pos = lineEnd + 1;
+
+        if (lineEnd - lineStart >= sizeof(line)) {
+            std::cerr << "Too long line in PWL file \"" << fileName << "\"!" << std::endl;
+            exit(-1);
+        }
+        memcpy(line, data + lineStart, lineEnd - lineStart);
+        line[lineEnd - lineStart] = 0;
+        for (char *c = line; *c; c++) {
+            if (*c == ',') *c = ' ';
+        }
+
+        char *str = line + strspn(line, " \t\r");
+        if (*str == 0 || *str == '*' || *str == '#') continue;
+
+        char *next;
+        double time = strtod(str, &next), value;
+        if (next != str) {
+            str = next;
+            value = strtod(str, &next);
+        }
+        if (next == str) {
+            std::cerr << "Invalid line in PWL file \"" << fileName << "\": \""
+                      << line << "\"" << std::endl;
+            exit(-1);
+        }
+        if (chunk.size() > 0 && time <= chunk[chunk.size() - 2]) {
+            std::cerr << "Time values in PWL file \"" << fileName
+                      << "\" must be in increasing order!" << std::endl;
+            exit(-1);
+        }
+
+        if (chunk.size() == 0) {
+            chunkTimes[index] = time;
+        }
+        if (chunk.size() == 2*chunkKnots && chunkOffsets.size() == index + 1) {
+            chunkOffsets.push_back(lineStart);
+            chunkTimes.push_back(time);
+        }
+        chunk.push_back(time);
+        chunk.push_back(value);
+    }
+    if (chunk.size() < 2*(chunkKnots + 1)) {
+        complete = true;
+    }
+
+    numKnots   = chunk.size()/2;
+    chunkIndex = index;
+    cursor     = 0;
+    dropPages(chunkOffsets[index]);
+}
+
+void
+PWLFile::dropPages(size_t offset) {
+    // The pages more than dropInterval bytes behind offset are released.
+    if (offset < droppedBytes + 2*dropInterval) {
+        return;
+    }
+    size_t pageSize = sysconf(_SC_PAGESIZE),
+           dropEnd  = (offset - dropInterval)/pageSize*pageSize;
+    mapping->dropPages(droppedBytes, dropEnd - droppedBytes);
+    droppedBytes = dropEnd;
+}
+
+const double *
+PWLFile::knotData() const {
+    if (binary) {
+        return (const double *) (mapping->data + 8);
+    }
+    return chunk.size() > 0 ? &chunk[0] : 0;
+}
+
+bool
+PWLFile::findText(double t) {
+    // The chunk with the last first knot at or before t. Unknown chunks are
+    // parsed forward from the last known chunk.
+    if (t < chunkTimes[0]) {
+        return false;
+    }
+    unsigned int index = std::upper_bound(chunkTimes.begin(), chunkTimes.end(), t)
+                       - chunkTimes.begin() - 1;
+    if (index != chunkIndex) {
+        // Pages released before an earlier chunk are read again and can be
+        // released again.
+        if (chunkOffsets[index] < droppedBytes) {
+            droppedBytes = 0;
+        }
+        parseChunk(index);
+    }
+    while (numKnots > 0 && t >= chunk[2*(numKnots - 1)] && chunkOffsets.size() > chunkIndex + 1) {
+        parseChunk(chunkIndex + 1);
+    }
+    return numKnots >= 2 && t < chunk[2*(numKnots - 1)];
+}
+
+bool
+PWLFile::findBinary(double t) {
+    const double *knots = knotData();
+    dropPages(8 + 2*sizeof(double)*cursor);
+    return numKnots >= 2 && t >= knots[0] && t < knots[2*(numKnots - 1)];
+}
+
+bool
+PWLFile::segment(double t) {
+    // Sets the cursor to the interval [knots[2*cursor], knots[2*cursor + 2])
+    // containing t and returns false when t is outside of the knots.
+    const double *knots = knotData();
+    if (numKnots >= 2 && cursor + 1 < numKnots && t >= knots[2*cursor]) {
+        if (t < knots[2*cursor + 2]) {
+            return true;
+        }
+        if (cursor + 2 < numKnots && t < knots[2*cursor + 4]) {
+            cursor++;
+            return true;
+        }
+    }
+    if (!(binary ? findBinary(t) : findText(t))) {
+        return false;
+    }
+
+    knots = knotData();
+    size_t low = 0, high = numKnots - 1;
+    while (high - low > 1) {
+        size_t mid = (low + high)/2;
+        if (knots[2*mid] <= t) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    cursor = low;
+    return true;
+}
+
+double
+PWLFile::eval(double t) {
+    if (!segment(t)) {
+        return 0;
+    }
+    const double *knot = knotData() + 2*cursor;
+    return knot[1] + (knot[3] - knot[1])*(t - knot[0])/(knot[2] - knot[0]);
+}
+
+double
+PWLFile::nextBreakpoint(double t) {
+    double tFirst = binary ? knotData()[0] : chunkTimes[0];
+    if (t < tFirst) {
+        return tFirst;
+    }
+    if (!segment(t)) {
+        return HUGE_VAL;
+    }
+    return knotData()[2*cursor + 2];
+}
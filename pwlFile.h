@@ -0,0 +1,95 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PWLFILE_H
+#define PWLFILE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stddef.h>
+
+#include "mappedFile.h"
+
+/* PWLFile object evaluates a piecewise linear waveform, whose knots are read
+ * from a memory-mapped file, PWL(FILE="name") in the netlist. The knots are
+ * not copied into memory as a whole, so that files with tens of millions of
+ * samples can be used.
+ *
+ * Binary files (native byte order):
+ *   char[8]   magic "SSPPWL01"
+ *   knots:    double time followed by double value
+ * The knots are accessed directly in the mapping with a cursor and binary
+ * search. When the cursor has advanced by dropInterval bytes, the pages
+ * behind it are released so that the resident memory stays bounded.
+ *
+ * Text files contain the time and the value of a knot on each line separated
+ * by spaces, tabs or commas. Empty lines and lines starting with '*' or '#'
+ * are skipped. The knots are parsed incrementally into chunks of chunkKnots
+ * knots as the time advances. The offset of each parsed chunk is stored so
+ * that earlier chunks can be parsed again when the time moves backwards.
+ *
+ * Copies share the mapping but have their own cursors and chunks. As with
+ * PWL(...), the value is zero before the first and after the last knot.
+ */
+
+class PWLFile {
+public:
+    PWLFile();
+
+    void open(const std::string &_fileName);
+    bool isOpen() const;
+
+    double eval(double t);
+    // The first knot strictly after t or HUGE_VAL.
+    double nextBreakpoint(double t);
+
+    std::string fileName;
+    bool binary;
+
+    static const unsigned int chunkKnots = 4096;
+    static const size_t dropInterval = 1 << 24;
+private:
+    // The mapping is unmapped when the last copy is destroyed.
+    std::shared_ptr <MappedFile> mapping;
+
+    // Knots of the current chunk as (time, value) pairs. In binary files,
+    // all knots are in the mapping.
+    size_t numKnots, cursor;
+
+    // Binary files: total number of knots and the start of the dropped pages.
+    size_t totalKnots, droppedBytes;
+
+    // Text files: the parsed chunk, the file offsets of the chunks and the
+    // times of their first knots. The last chunk has been reached, when
+    // complete is set.
+    std::vector <double> chunk;
+    std::vector <size_t> chunkOffsets;
+    std::vector <double> chunkTimes;
+    unsigned int chunkIndex;
+    bool complete;
+
+    const double *knotData() const;
+    bool segment(double t);
+    bool findBinary(double t);
+    bool findText(double t);
+    void parseChunk(unsigned int index);
+    void dropPages(size_t offset);
+};
+
+#endif // PWLFILE_H
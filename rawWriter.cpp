@@ -0,0 +1,191 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "rawWriter.h"
+#include <iostream>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+RawWriter::RawWriter(const std::string &_fileName, const std::vector<std::string> &_signalNames,
+                     unsigned int _chunkRows) {
+    fileName    = _fileName;
+    signalNames = _signalNames;
+    numSignals  = signalNames.size();
+    chunkRows   = _chunkRows;
+    numRows     = 0;
+    ioPending   = false;
+    stopping    = false;
+
+    file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot open \"" << fileName << "\" for writing!" << std::endl;
+        exit(-1);
+    }
+
+    // Header.
+    const char magic[8] = {'S', 'S', 'P', 'R', 'A', 'W', '0', '1'};
+    uint32_t numSignals32 = numSignals;
+    uint64_t numRows64 = 0;
+    fwrite(magic, 1, 8, file);
+    fwrite(&numSignals32, sizeof(uint32_t), 1, file);
+    rowCountPos = ftell(file);
+    fwrite(&numRows64, sizeof(uint64_t), 1, file);
+    for (unsigned int indSignal = 0; indSignal < numSignals; indSignal++) {
+        uint32_t length = signalNames[indSignal].length();
+        fwrite(&length, sizeof(uint32_t), 1, file);
+        fwrite(signalNames[indSignal].c_str(), 1, length, file);
+    }
+
+    fillBuffer.reserve(chunkRows * (numSignals + 1));
+    ioBuffer.reserve(chunkRows * (numSignals + 1));
+
+    ioThread = std::thread(&RawWriter::writeLoop, this);
+}
+
+RawWriter::~RawWriter() {
+    close();
+}
+
+void
+RawWriter::addRow(double t, const double *values) {
+    fillBuffer.push_back(t);
+    fillBuffer.insert(fillBuffer.end(), values, values + numSignals);
+    numRows++;
+
+    if (fillBuffer.size() >= chunkRows * (numSignals + 1)) {
+        submit();
+    }
+}
+
+void
+RawWriter::addRow(double t, const std::vector<double> &values) {
+    assert(values.size() == numSignals);
+    addRow(t, values.data());
+}
+
+void
+RawWriter::submit() {
+    // Wait until the I/O thread has written the previous chunk and swap the
+    // buffers. The capacity of both buffers is retained.
+    std::unique_lock<std::mutex> lock(mutex);
+    while (ioPending) {
+        cond.wait(lock);
+    }
+    fillBuffer.swap(ioBuffer);
+    fillBuffer.clear();
+    ioPending = true;
+    cond.notify_all();
+}
+
+void
+RawWriter::writeLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        while (!ioPending && !stopping) {
+            cond.wait(lock);
+        }
+        if (!ioPending && stopping) {
+            break;
+        }
+
+        // The producer does not touch ioBuffer while ioPending is set.
+        lock.unlock();
+        size_t numValues = ioBuffer.size();
+        if (fwrite(ioBuffer.data(), sizeof(double), numValues, file) != numValues) {
+            std::cerr << "Write to \"" << fileName << "\" failed!" << std::endl;
+            exit(-1);
+        }
+        lock.lock();
+
+        ioPending = false;
+        cond.notify_all();
+    }
+}
+
+void
+RawWriter::close() {
+    if (!file) {
+        return;
+    }
+    if (fillBuffer.size() > 0) {
+        submit();
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        cond.notify_all();
+    }
+    ioThread.join();
+
+    uint64_t numRows64 = numRows;
+    fseek(file, rowCountPos, SEEK_SET);
+    fwrite(&numRows64, sizeof(uint64_t), 1, file);
+    fclose(file);
+    file = 0;
+}
+
+#ifdef RAWWRITER_TEST
+
+int
+main(int argc, char **argv) {
+    std::vector<std::string> names;
+    names.push_back("V(1)");
+    names.push_back("I(R1)");
+
+    unsigned int numRows = 100000;
+    {
+        RawWriter writer("test.raw", names, 1000);
+        double values[2];
+        for (unsigned int ind = 0; ind < numRows; ind++) {
+            values[0] = ind;
+            values[1] = -(double)ind;
+            writer.addRow(ind*0.001, values);
+        }
+    }
+
+    // Read the file back.
+    FILE *file = fopen("test.raw", "rb");
+    char magic[9] = {0};
+    uint32_t numSignals;
+    uint64_t numRowsFile;
+    fread(magic, 1, 8, file);
+    fread(&numSignals, sizeof(uint32_t), 1, file);
+    fread(&numRowsFile, sizeof(uint64_t), 1, file);
+    std::cout << magic << " " << numSignals << " signals, " << numRowsFile << " rows" << std::endl;
+    for (unsigned int indSignal = 0; indSignal < numSignals; indSignal++) {
+        uint32_t length;
+        fread(&length, sizeof(uint32_t), 1, file);
+        std::string name(length, ' ');
+        fread(&name[0], 1, length, file);
+        std::cout << "  " << name << std::endl;
+    }
+    unsigned int numErrors = 0;
+    double row[3];
+    for (unsigned int ind = 0; ind < numRowsFile; ind++) {
+        fread(row, sizeof(double), 3, file);
+        if (row[0] != ind*0.001 || row[1] != ind || row[2] != -(double)ind) {
+            numErrors++;
+        }
+    }
+    fclose(file);
+    std::cout << numErrors << " errors" << std::endl;
+}
+
+#endif
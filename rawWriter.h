@@ -0,0 +1,77 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RAWWRITER_H
+#define RAWWRITER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+
+/* RawWriter objects write transient waveforms into binary files. Formatting
+ * of the values into text is avoided and the rows are collected into large
+ * chunks written by a background I/O thread while the solver proceeds.
+ *
+ * File format (native byte order):
+ *   char[8]   magic "SSPRAW01"
+ *   uint32    number of signals N (excluding time)
+ *   uint64    number of rows (updated when the file is closed)
+ *   N times:  uint32 length of the signal name followed by the name
+ *   rows:     double time followed by N doubles
+ *
+ * If the writer is not closed properly, the number of rows can be obtained
+ * from the size of the file.
+ */
+
+class RawWriter {
+public:
+    RawWriter(const std::string &_fileName, const std::vector<std::string> &_signalNames,
+              unsigned int _chunkRows = 4096);
+    ~RawWriter();
+
+    void addRow(double t, const double *values);
+    void addRow(double t, const std::vector<double> &values);
+    // Write the remaining rows, update the header and close the file.
+    void close();
+
+    std::string fileName;
+    std::vector<std::string> signalNames;
+    unsigned int numSignals, chunkRows;
+    unsigned long long numRows;
+
+private:
+    void writeLoop();
+    void submit();
+
+    FILE *file;
+    long rowCountPos;
+
+    // The rows are added to fillBuffer. Full buffers are swapped with the
+    // empty ioBuffer, which is written by the I/O thread.
+    std::vector<double> fillBuffer, ioBuffer;
+    bool ioPending, stopping;
+
+    std::thread ioThread;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+#endif // RAWWRITER_H
@@ -0,0 +1,473 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "realTimeTransient.h"
+
+#include <algorithm>
+#include <math.h>
+#include <time.h>
+
+RealTimeTransient::RealTimeTransient(Parser *_parser, const std::vector <std::string> &inputNames,
+                                     double _dt, double _t2, double _theta) {
+    theta = _theta;
+    if (theta <= 0 || theta > 1) {
+        std::cerr << "REALTIME : Theta must be within (0, 1]!" << std::endl;
+        exit(-1);
+    }
+
+    NodeList *nodeList = _parser->nodeList;
+    ElementList *elemList = _parser->elemList;
+    std::vector <Element> &elements = elemList->elements;
+
+    std::vector <int> elemInput(elements.size(), -1);
+    for (unsigned int indInput = 0; indInput < inputNames.size(); indInput++) {
+        int symbolId = symbols.find(inputNames[indInput]),
+            indElem  = (symbolId < 0) ? -1 : elemList->elem(symbolId);
+        if (indElem < 0) {
+            std::cerr << "REALTIME : Unknown input \"" << inputNames[indInput] << "\"!" << std::endl;
+            exit(-1);
+        }
+        if (elements[indElem].elemType != STAT_VOLTAGESOURCE
+         && elements[indElem].elemType != STAT_CURRENTSOURCE) {
+            std::cerr << "REALTIME : Input \"" << inputNames[indInput]
+                      << "\" is not an independent source!" << std::endl;
+            exit(-1);
+        }
+        elemInput[indElem] = indInput;
+    }
+    inputRow1.assign(inputNames.size(), -1);
+    inputRow2.assign(inputNames.size(), -1);
+
+    // The energy storage elements, the inputs and the sources with waveforms
+    // are stamped separately from the other elements. Voltage sources keep
+    // their names for the DoF mapping and current-controlled sources.
+    std::vector <Element> fixedElems;
+    std::vector <int> elemComp(elements.size(), -1), sourceElems;
+
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        const Element &elem = elements[indElem];
+        int node1 = (int) nodeList->node(elem.nodeIds[0]) - 1,
+            node2 = (int) nodeList->node(elem.nodeIds[1]) - 1;
+
+        switch (elem.elemType) {
+        case STAT_CAPACITANCE:
+        case STAT_INDUCTANCE:
+            elemComp[indElem] = compValue.size();
+            compCapacitance.push_back(elem.elemType == STAT_CAPACITANCE);
+            compValue.push_back(elem.valueList[0]);
+            compNode1.push_back(node1);
+            compNode2.push_back(node2);
+            break;
+        case STAT_VOLTAGESOURCE:
+        case STAT_CURRENTSOURCE:
+            if (elemInput[indElem] >= 0 || elem.waveForm) {
+                if (elem.elemType == STAT_VOLTAGESOURCE) {
+                    std::string strVS = elem.name + " " + elem.nodeList[0] + " "
+                                      + elem.nodeList[1] + " 0";
+                    Element elemVS(strVS);
+                    fixedElems.push_back(std::move(elemVS));
+                    node1 = node2 = -1;
+                }
+                if (elemInput[indElem] >= 0) {
+                    inputRow1[elemInput[indElem]] = node1;
+                    inputRow2[elemInput[indElem]] = node2;
+                } else {
+                    // The copies are configured, not the waveforms of the
+                    // parser, and made before the real-time loop.
+                    sourceWfs.push_back(*elem.waveForm);
+                    sourceWfs.back().setTransientParameters(_dt, 0, _t2);
+                    sourceStates.push_back(WaveformState());
+                    sourceRow1.push_back(node1);
+                    sourceRow2.push_back(node2);
+                    sourceElems.push_back(indElem);
+                }
+                break;
+            }
+            fixedElems.push_back(elem);
+            break;
+        default:
+            fixedElems.push_back(elem);
+        }
+    }
+
+    ElementList fixedList(std::move(fixedElems));
+    Assembly ass(nodeList, &fixedList, false, false);
+    numDoF = ass.numDoF;
+    fixedMatrix.assign(numDoF*numDoF, 0);
+    fixedExcitation.assign(ass.systemExcitation, ass.systemExcitation + numDoF);
+    for (unsigned int row = 0; row < numDoF; row++) {
+        for (unsigned int col = 0; col < numDoF; col++) {
+            fixedMatrix[row*numDoF + col] = ass.systemMNA->value(row, col);
+        }
+    }
+
+    // The value of a voltage source is the excitation of its DoF.
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        if (elements[indElem].elemType == STAT_VOLTAGESOURCE && elemInput[indElem] >= 0) {
+            inputRow2[elemInput[indElem]] = ass.sourceDoF(elements[indElem].nameId) - 1;
+        }
+    }
+    for (unsigned int indWf = 0; indWf < sourceWfs.size(); indWf++) {
+        const Element &elem = elements[sourceElems[indWf]];
+        if (elem.elemType == STAT_VOLTAGESOURCE) {
+            sourceRow2[indWf] = ass.sourceDoF(elem.nameId) - 1;
+        }
+    }
+
+    // Output variables.
+    probes = _parser->probes;
+    if (probes.size() == 0) {
+        for (unsigned int indNode = 1; indNode < nodeList->numNodes; indNode++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_VOLTAGE;
+            probe.name  = "V(" + nodeList->mapNodeString[indNode] + ")";
+            probe.args.push_back(nodeList->mapNodeString[indNode]);
+            probe.node1 = indNode;
+            probe.node2 = 0;
+            probe.elemInd = 0;
+            probes.push_back(probe);
+        }
+    }
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        Probe &probe = probes[indProbe];
+        int node1 = -1, node2 = -1, comp = -1, dof = -1;
+        double conductance = 0;
+
+        if (probe.type == Probe::PROBE_VOLTAGE) {
+            node1 = (int) probe.node1 - 1;
+            node2 = (int) probe.node2 - 1;
+        } else {
+            const Element &elem = elements[probe.elemInd];
+            if (elem.elemType == STAT_RESISTANCE) {
+                node1 = (int) nodeList->node(elem.nodeIds[0]) - 1;
+                node2 = (int) nodeList->node(elem.nodeIds[1]) - 1;
+                conductance = 1/elem.valueList[0];
+            } else if (elemComp[probe.elemInd] >= 0) {
+                comp = elemComp[probe.elemInd];
+            } else if (elem.elemType == STAT_VOLTAGESOURCE) {
+                dof = ass.sourceDoF(elem.nameId) - 1;
+            } else {
+                std::cerr << "REALTIME : Output variable " << probe.name
+                          << " is not supported!" << std::endl;
+                exit(-1);
+            }
+        }
+        probeNode1.push_back(node1);
+        probeNode2.push_back(node2);
+        probeComp.push_back(comp);
+        probeDoF.push_back(dof);
+        probeConductance.push_back(conductance);
+    }
+    outputs.assign(probes.size(), 0);
+
+    unsigned int numComp = compValue.size();
+    compG.assign(numComp, 0);
+    compVoltage.assign(numComp, 0);
+    compCurrent.assign(numComp, 0);
+    luData.assign(numDoF*numDoF, 0);
+    luPerm.assign(numDoF, 0);
+    x.assign(numDoF, 0);
+    latencyHistogram.assign(numLatencyBins, 0);
+
+    hFactor = 0;
+    thetaFactor = 0;
+    reset(0);
+    resetLatency();
+}
+
+void
+RealTimeTransient::reset(double _t) {
+    t = _t;
+    numSteps = 0;
+    std::fill(compVoltage.begin(), compVoltage.end(), 0);
+    std::fill(compCurrent.begin(), compCurrent.end(), 0);
+    std::fill(outputs.begin(), outputs.end(), 0);
+    restarted = true;
+}
+
+void
+RealTimeTransient::restart() {
+    restarted = true;
+}
+
+void
+RealTimeTransient::resetLatency() {
+    std::fill(latencyHistogram.begin(), latencyHistogram.end(), 0);
+    maxLatency = 0;
+    numFactor = 0;
+}
+
+void
+RealTimeTransient::dispLatency() {
+    std::cout << "Step latency (" << numSteps << " steps, " << numFactor
+              << " factorizations, max " << maxLatency << " ns):" << std::endl;
+    for (unsigned int bin = 0; bin < numLatencyBins; bin++) {
+        if (latencyHistogram[bin] == 0) continue;
+        std::cout << "  " << (1ul << bin) << " - " << (1ul << (bin + 1)) << " ns : "
+                  << latencyHistogram[bin] << std::endl;
+    }
+}
+
+void
+RealTimeTransient::factor(double h, double _theta) {
+    unsigned int n = numDoF;
+    double *M = &luData[0];
+    unsigned int *perm = &luPerm[0];
+
+    // The conductances of the companion models are C/(_theta*h) and
+    // _theta*h/L.
+    std::copy(fixedMatrix.begin(), fixedMatrix.end(), M);
+    for (unsigned int indComp = 0; indComp < compValue.size(); indComp++) {
+        double G;
+        if (compCapacitance[indComp]) {
+            G = compValue[indComp]/(_theta*h);
+        } else {
+            G = _theta*h/compValue[indComp];
+        }
+        compG[indComp] = G;
+
+        int node1 = compNode1[indComp], node2 = compNode2[indComp];
+        if (node1 >= 0) M[node1*n + node1] += G;
+        if (node2 >= 0) M[node2*n + node2] += G;
+        if (node1 >= 0 && node2 >= 0) {
+            M[node1*n + node2] -= G;
+            M[node2*n + node1] -= G;
+        }
+    }
+
+    // LU decomposition with partial pivoting. perm[k] is the row swapped
+    // with the row k.
+    for (unsigned int k = 0; k < n; k++) {
+        unsigned int pivRow = k;
+        for (unsigned int row = k + 1; row < n; row++) {
+            if (fabs(M[row*n + k]) > fabs(M[pivRow*n + k])) {
+                pivRow = row;
+            }
+        }
+        if (M[pivRow*n + k] == 0) {
+            std::cerr << "REALTIME : Singular matrix!" << std::endl;
+            exit(-1);
+        }
+        perm[k] = pivRow;
+        if (pivRow != k) {
+            for (unsigned int col = 0; col < n; col++) {
+                std::swap(M[k*n + col], M[pivRow*n + col]);
+            }
+        }
+        for (unsigned int row = k + 1; row < n; row++) {
+            double factor = M[row*n + k] /= M[k*n + k];
+            for (unsigned int col = k + 1; col < n; col++) {
+                M[row*n + col] -= factor*M[k*n + col];
+            }
+        }
+    }
+    hFactor = h;
+    thetaFactor = _theta;
+    numFactor++;
+}
+
+void
+RealTimeTransient::solve(double *rhs) {
+    unsigned int n = numDoF;
+    const double *M = &luData[0];
+    const unsigned int *perm = &luPerm[0];
+
+    for (unsigned int k = 0; k < n; k++) {
+        std::swap(rhs[k], rhs[perm[k]]);
+    }
+    for (unsigned int row = 1; row < n; row++) {
+        double val = rhs[row];
+        for (unsigned int col = 0; col < row; col++) {
+            val -= M[row*n + col]*rhs[col];
+        }
+        rhs[row] = val;
+    }
+    for (int row = n - 1; row >= 0; row--) {
+        double val = rhs[row];
+        for (unsigned int col = row + 1; col < n; col++) {
+            val -= M[row*n + col]*rhs[col];
+        }
+        rhs[row] = val/M[row*n + row];
+    }
+}
+
+const std::vector <double> &
+RealTimeTransient::step(double h, const double *inputs) {
+    struct timespec clockStart, clockEnd;
+    clock_gettime(CLOCK_MONOTONIC, &clockStart);
+
+    double stepTheta = restarted ? 1 : theta;
+    if (h != hFactor || stepTheta != thetaFactor) {
+        factor(h, stepTheta);
+    }
+    double tNew = t + h;
+
+    std::copy(fixedExcitation.begin(), fixedExcitation.end(), x.begin());
+    for (unsigned int indInput = 0; indInput < inputRow1.size(); indInput++) {
+        if (inputRow1[indInput] >= 0) x[inputRow1[indInput]] -= inputs[indInput];
+        if (inputRow2[indInput] >= 0) x[inputRow2[indInput]] += inputs[indInput];
+    }
+    for (unsigned int indWf = 0; indWf < sourceWfs.size(); indWf++) {
+        double u = sourceWfs[indWf].eval(tNew, sourceStates[indWf]);
+        if (sourceRow1[indWf] >= 0) x[sourceRow1[indWf]] -= u;
+        if (sourceRow2[indWf] >= 0) x[sourceRow2[indWf]] += u;
+    }
+
+    // The Norton currents of the companion models flow from node1 to node2:
+    // J = -G*V - I*(1-theta)/theta for capacitances and
+    // J = I + (1-theta)*h*V/L for inductances with theta of the step.
+    for (unsigned int indComp = 0; indComp < compValue.size(); indComp++) {
+        double J;
+        if (compCapacitance[indComp]) {
+            J = -compG[indComp]*compVoltage[indComp]
+              - compCurrent[indComp]*(1 - stepTheta)/stepTheta;
+        } else {
+            J = compCurrent[indComp] + (1 - stepTheta)*h*compVoltage[indComp]/compValue[indComp];
+        }
+        int node1 = compNode1[indComp], node2 = compNode2[indComp];
+        if (node1 >= 0) x[node1] -= J;
+        if (node2 >= 0) x[node2] += J;
+        compCurrent[indComp] = J;
+    }
+    solve(&x[0]);
+
+    for (unsigned int indComp = 0; indComp < compValue.size(); indComp++) {
+        int node1 = compNode1[indComp], node2 = compNode2[indComp];
+        double voltage = (node1 >= 0 ? x[node1] : 0) - (node2 >= 0 ? x[node2] : 0);
+        compVoltage[indComp] = voltage;
+        compCurrent[indComp] += compG[indComp]*voltage;
+    }
+
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        int node1 = probeNode1[indProbe], node2 = probeNode2[indProbe];
+        if (probeDoF[indProbe] >= 0) {
+            outputs[indProbe] = -x[probeDoF[indProbe]];
+        } else if (probeComp[indProbe] >= 0) {
+            outputs[indProbe] = compCurrent[probeComp[indProbe]];
+        } else {
+            double voltage = (node1 >= 0 ? x[node1] : 0) - (node2 >= 0 ? x[node2] : 0);
+            if (probes[indProbe].type == Probe::PROBE_VOLTAGE) {
+                outputs[indProbe] = voltage;
+            } else {
+                outputs[indProbe] = voltage*probeConductance[indProbe];
+            }
+        }
+    }
+    t = tNew;
+    numSteps++;
+    restarted = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &clockEnd);
+    unsigned long latency = (clockEnd.tv_sec - clockStart.tv_sec)*1000000000ul
+                          + clockEnd.tv_nsec - clockStart.tv_nsec;
+    unsigned int bin = 0;
+    while (bin + 1 < numLatencyBins && (latency >> (bin + 1)) > 0) {
+        bin++;
+    }
+    latencyHistogram[bin]++;
+    maxLatency = std::max(maxLatency, latency);
+
+    return outputs;
+}
+
+#ifdef REALTIME_TEST
+
+#include "transient.h"
+#include <string.h>
+
+int
+main(int argc, char **argv) {
+    std::string fileName = "test_wr.cir";
+    double dt = 0.0001, t2 = 0.1;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+
+    // The sources with waveforms are driven by Transient and their values
+    // at each step are given as the inputs, which is compared to the
+    // solution of Transient with the same fixed steps. Transient restarts
+    // at the breakpoints of the waveforms and so does the real-time solver.
+    Transient tran(&parser, dt, t2, 0, 0.5);
+    tran.verbose = false;
+    std::vector <double> tranRows;
+    tran.advance(t2, &tranRows);
+
+    std::vector <std::string> inputNames;
+    std::vector <Waveform> inputWfs;
+    std::vector <WaveformState> inputStates;
+    std::vector <Element> &elements = parser.elemList->elements;
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        if (elements[indElem].waveForm) {
+            inputNames.push_back(elements[indElem].name);
+            inputWfs.push_back(*elements[indElem].waveForm);
+            inputStates.push_back(WaveformState());
+        }
+    }
+
+    RealTimeTransient rt(&parser, inputNames, dt, t2, 0.5);
+
+    // Without inputs, the waveforms are evaluated from private copies and
+    // the circuit of the parser is left unchanged.
+    {
+        RealTimeTransient rtSources(&parser, std::vector <std::string> (), dt, t2, 0.5);
+        for (unsigned int indElem = 0, indWf = 0; indElem < elements.size(); indElem++) {
+            if (elements[indElem].waveForm) {
+                assert(memcmp(&inputWfs[indWf].par, &elements[indElem].waveForm->par,
+                              sizeof(inputWfs[indWf].par)) == 0);
+                indWf++;
+            }
+        }
+    }
+    std::vector <double> inputs(inputNames.size());
+    unsigned int rowSize = tran.outputs.size() + 1;
+    double maxDiff = 0;
+
+    for (unsigned int row = 0; row < tranRows.size()/rowSize; row++) {
+        double tNew = tranRows[row*rowSize];
+        for (unsigned int indInput = 0; indInput < inputs.size(); indInput++) {
+            inputs[indInput] = inputWfs[indInput].eval(tNew, inputStates[indInput]);
+        }
+        bool atBreak = tNew >= std::min(tran.nextBreakpoint(rt.t), t2) - 1e-9*dt;
+        const std::vector <double> &outputs = rt.step(tNew - rt.t, &inputs[0]);
+        if (atBreak) {
+            rt.restart();
+        }
+        for (unsigned int ind = 0; ind < outputs.size(); ind++) {
+            maxDiff = std::max(maxDiff, fabs(outputs[ind] - tranRows[row*rowSize + ind + 1]));
+        }
+    }
+    std::cout << std::endl << "Maximum difference to Transient: " << maxDiff << std::endl;
+    rt.dispLatency();
+
+    // Steps of constant length without factorizations.
+    rt.reset(0);
+    rt.resetLatency();
+    for (unsigned int step = 0; step < 100000; step++) {
+        for (unsigned int indInput = 0; indInput < inputs.size(); indInput++) {
+            inputs[indInput] = inputWfs[indInput].eval(rt.t + dt, inputStates[indInput]);
+        }
+        rt.step(dt, &inputs[0]);
+    }
+    rt.dispLatency();
+}
+
+#endif
@@ -0,0 +1,119 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef REALTIMETRANSIENT_H
+#define REALTIMETRANSIENT_H
+
+#include "parser.h"
+#include "assembly.h"
+#include "waveform.h"
+
+#include <vector>
+#include <string>
+
+/* RealTimeTransient object advances the transient solution of a linear
+ * circuit one step at a time for co-simulation with an external model, for
+ * example, a plant or a controller in a hardware-in-the-loop test bench.
+ *
+ * All memory is allocated and the circuit is processed in the constructor.
+ * Thereafter, reset and step do not allocate, print or access the parser
+ * and thus have bounded latency. step(h, inputs) advances the solution by
+ * the time step h with the theta method (0 < theta <= 1) and returns the
+ * output variables at the new time. The currents of the energy storage
+ * elements are not known after reset and may jump at discontinuities of
+ * the inputs, so the first step after reset and restart is taken with
+ * Backward Euler. The LU decomposition of the MNA matrix is computed in
+ * place only when h or the integration method differs from the previous
+ * decomposition, so constant steps cost one forward and back substitution.
+ *
+ * dt, t2      Nominal time step and end time used only for the default
+ *             parameters of the source waveforms.
+ * inputNames  Names of the independent voltage and current sources, whose
+ *             values are given by the inputs of each step in this order.
+ *             The other sources use their DC values or waveforms.
+ * outputs     Output variables after the latest step. Node voltages and
+ *             currents of resistances, capacitances, inductances and
+ *             voltage sources are supported.
+ *
+ * The wall-clock latency of each step is measured with the monotonic clock.
+ * latencyHistogram[k] counts the steps with latency in [2^k, 2^(k+1)) ns
+ * and maxLatency is the largest latency in ns. numFactor counts the LU
+ * decompositions since resetLatency.
+ */
+
+class RealTimeTransient {
+public:
+    RealTimeTransient(Parser *_parser, const std::vector <std::string> &inputNames,
+                      double _dt, double _t2, double _theta=0.5);
+
+    // Restart from the zero state at time _t.
+    void reset(double _t=0);
+    // Take the next step with Backward Euler, e.g., after a breakpoint of
+    // the inputs.
+    void restart();
+    const std::vector <double> &step(double h, const double *inputs);
+    void resetLatency();
+    void dispLatency();
+
+    double t, theta;
+    unsigned int numSteps, numFactor;
+
+    std::vector <Probe> probes;
+    std::vector <double> outputs;
+
+    static const unsigned int numLatencyBins = 40;
+    std::vector <unsigned long> latencyHistogram;
+    unsigned long maxLatency;
+private:
+    unsigned int numDoF;
+    double hFactor, thetaFactor;
+    bool restarted;
+
+    // Matrix and excitation of the elements other than the energy storage
+    // elements and the sources with waveforms or inputs.
+    std::vector <double> fixedMatrix, fixedExcitation;
+
+    // Companion models of capacitances and inductances: values, system
+    // indices of the nodes (-1 for the ground), conductances for hFactor and
+    // thetaFactor and branch voltages and currents at time t.
+    std::vector <bool> compCapacitance;
+    std::vector <double> compValue, compG, compVoltage, compCurrent;
+    std::vector <int> compNode1, compNode2;
+
+    // Inputs and sources with waveforms. The value is subtracted from the
+    // excitation at row1 and added at row2. The waveforms are copies made in
+    // the constructor and configured with the time step.
+    std::vector <int> inputRow1, inputRow2;
+    std::vector <Waveform> sourceWfs;
+    std::vector <WaveformState> sourceStates;
+    std::vector <int> sourceRow1, sourceRow2;
+
+    // Output variables of each probe: system indices of the nodes, the
+    // resistance, the companion model and the DoF of a voltage source.
+    std::vector <int> probeNode1, probeNode2, probeComp, probeDoF;
+    std::vector <double> probeConductance;
+
+    // LU decomposition with row permutations and the solution vector.
+    std::vector <double> luData, x;
+    std::vector <unsigned int> luPerm;
+
+    void factor(double h, double _theta);
+    void solve(double *rhs);
+};
+
+#endif // REALTIMETRANSIENT_H
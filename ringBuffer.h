@@ -0,0 +1,102 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <assert.h>
+
+/* RingBuffer object is a lock-free single-producer/single-consumer queue of
+ * preallocated slots. The producer fills the slot returned by writeSlot and
+ * publishes it with push, while the consumer reads the slot returned by
+ * readSlot and returns it with pop. The slots are reused and thus their
+ * contents (e.g. vectors) keep their storage between the passes.
+ *
+ * writeSlot and readSlot return 0 when the buffer is full or empty and the
+ * waiting variants yield the thread until a slot is available. The capacity
+ * is rounded up to a power of two. Exactly one thread may call the producer
+ * methods and one thread the consumer methods.
+ */
+
+template <class T>
+class RingBuffer {
+public:
+    RingBuffer(unsigned int _capacity) {
+        unsigned int capacity = 1;
+        while (capacity < _capacity) {
+            capacity *= 2;
+        }
+        slots.resize(capacity);
+        mask = capacity - 1;
+        head = 0;
+        tail = 0;
+    }
+
+    // Producer:
+    T *writeSlot() {
+        unsigned int ind = head.load(std::memory_order_relaxed);
+        if (ind - tail.load(std::memory_order_acquire) > mask) {
+            return 0;
+        }
+        return &slots[ind & mask];
+    }
+    T *waitWriteSlot() {
+        T *slot;
+        while ((slot = writeSlot()) == 0) {
+            std::this_thread::yield();
+        }
+        return slot;
+    }
+    void push() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer:
+    T *readSlot() {
+        unsigned int ind = tail.load(std::memory_order_relaxed);
+        if (ind == head.load(std::memory_order_acquire)) {
+            return 0;
+        }
+        return &slots[ind & mask];
+    }
+    T *waitReadSlot() {
+        T *slot;
+        while ((slot = readSlot()) == 0) {
+            std::this_thread::yield();
+        }
+        return slot;
+    }
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::vector <T> slots;
+    unsigned int mask;
+
+    // The indices increase monotonically and wrap around modulo 2^32. They
+    // are on separate cache lines to avoid false sharing between the
+    // producer and the consumer.
+    alignas(64) std::atomic <unsigned int> head;
+    alignas(64) std::atomic <unsigned int> tail;
+};
+
+#endif // RINGBUFFER_H
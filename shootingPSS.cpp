@@ -0,0 +1,149 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "shootingPSS.h"
+
+#include <math.h>
+
+ShootingPSS::ShootingPSS(Parser *_parser, double _period, double _dt, double _t1,
+                         double _theta) {
+    parser  = _parser;
+    period  = _period;
+    dt      = _dt;
+    t1      = _t1;
+    theta   = _theta;
+    tol     = 1e-9;
+    maxIter = 10;
+    numIter = 0;
+    converged = false;
+    residual  = 0;
+    writer    = 0;
+
+    tran = new Transient(parser, dt, t1 + period, t1, theta, Transient::METHOD_THETA);
+    tran->verbose = false;
+    tran->getState(state);
+}
+
+ShootingPSS::~ShootingPSS() {
+    delete tran;
+    tran = 0;
+}
+
+void
+ShootingPSS::run() {
+    unsigned int numState = state.size();
+    converged = false;
+
+    for (numIter = 1; numIter <= maxIter; numIter++) {
+        std::vector <double> stateEnd;
+        tran->setState(t1, state);
+        tran->initTangent();
+        tran->advance(t1 + period);
+        tran->getState(stateEnd);
+
+        double maxState = 0;
+        residual = 0;
+        for (unsigned int ind = 0; ind < numState; ind++) {
+            residual = std::max(residual, fabs(stateEnd[ind] - state[ind]));
+            maxState = std::max(maxState, fabs(state[ind]));
+        }
+        if (residual <= tol*(1 + maxState)) {
+            converged = true;
+            break;
+        }
+
+        // Newton update: (dx(T)/dx0 - I) dx0 = -(x(T) - x0).
+        Matrix M(numState, numState), L(numState, numState), U(numState, numState),
+               P(numState, numState);
+        for (unsigned int row = 0; row < numState; row++) {
+            for (unsigned int col = 0; col < numState; col++) {
+                M.set(row, col, tran->tangent[row*numState + col] - (row == col));
+            }
+        }
+        M.LU(L, U, P);
+        for (unsigned int ind = 0; ind < numState; ind++) {
+            if (U.value(ind, ind) == 0) {
+                std::cerr << "PSS : Singular Jacobian - The circuit has no unique "
+                          << "periodic steady state!" << std::endl;
+                exit(-1);
+            }
+        }
+        double *rhs = new double[numState];
+        for (unsigned int ind = 0; ind < numState; ind++) {
+            rhs[ind] = state[ind] - stateEnd[ind];
+        }
+        double *dx = M.LU_solve(L, U, P, rhs);
+        for (unsigned int ind = 0; ind < numState; ind++) {
+            state[ind] += dx[ind];
+        }
+        delete [] dx;
+        delete [] rhs;
+    }
+    if (numIter > maxIter) {
+        numIter = maxIter;
+    }
+    tran->tangent.clear();
+
+    if (writer) {
+        tran->setState(t1, state);
+        tran->writer = writer;
+        tran->advance(t1 + period);
+        tran->writer = 0;
+    }
+}
+
+#ifdef SHOOTINGPSS_TEST
+
+int
+main(int argc, char **argv) {
+    std::string fileName = "test_pulse.cir";
+    double period = 0.1, dt = 0.0001;
+    unsigned int numPeriods = 50;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (argc >= 3) {
+        period = atof(argv[2]);
+    }
+    if (argc >= 4) {
+        numPeriods = atoi(argv[3]);
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+
+    ShootingPSS pss(&parser, period, dt);
+    pss.run();
+
+    // Reference from a long transient settling into the steady state.
+    Transient tran(&parser, dt, numPeriods*period, 0, 0.5);
+    tran.verbose = false;
+    tran.run();
+    std::vector <double> stateTran;
+    tran.getState(stateTran);
+
+    std::cout << std::endl << "PSS: " << pss.numIter << " periods, residual "
+              << pss.residual << (pss.converged ? "" : " (not converged)") << std::endl;
+    std::cout << "State after " << numPeriods << " periods of transient:" << std::endl;
+    for (unsigned int ind = 0; ind < pss.state.size(); ind++) {
+        std::cout << pss.state[ind] << " " << stateTran[ind] << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,67 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHOOTINGPSS_H
+#define SHOOTINGPSS_H
+
+#include "parser.h"
+#include "transient.h"
+#include "rawWriter.h"
+
+#include <vector>
+
+/* ShootingPSS object computes the periodic steady state of a circuit driven
+ * by sources with the period T with the shooting-Newton method.
+ *
+ * The state x of the circuit consists of the branch voltages and currents
+ * of the energy storage elements (see Transient::getState). The initial state
+ * x0 is Newton-iterated to satisfy x(t1 + T) = x0, where x(t1 + T) is
+ * obtained by Transient integration over one period with the theta method.
+ * The Jacobian dx(t1 + T)/dx0 - I is obtained from the sensitivity of the
+ * state propagated together with the time steps (Transient::initTangent).
+ * For linear circuits, one Newton iteration is exact up to rounding and the
+ * convergence is verified by a second period.
+ *
+ * The iteration stops when the maximum of |x(t1 + T) - x0| is below
+ * tol*(1 + max|x0|) or after maxIter periods. When writer is set, the
+ * output variables of the steady-state period are written into it.
+ */
+
+class ShootingPSS {
+public:
+    ShootingPSS(Parser *_parser, double _period, double _dt, double _t1=0,
+                double _theta=0.5);
+    ~ShootingPSS();
+
+    void run();
+
+    double period, dt, t1, theta, tol;
+    unsigned int maxIter, numIter;
+    bool converged;
+    RawWriter *writer;
+
+    // The periodic initial state and the residual of the latest iteration.
+    std::vector <double> state;
+    double residual;
+
+    Transient *tran;
+private:
+    Parser *parser;
+};
+
+#endif // SHOOTINGPSS_H
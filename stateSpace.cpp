@@ -0,0 +1,307 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "stateSpace.h"
+
+#include <sstream>
+#include <assert.h>
+#include <math.h>
+
+StateSpace::StateSpace(Parser *_parser) {
+    parser = _parser;
+    NodeList *nodeList = parser->nodeList;
+    std::vector <Element> &parserElems = parser->elemList->elements;
+
+    // Construct the resistive circuit used in the assembly of G.
+    std::vector <Element> elements;
+    std::vector <unsigned int> indInductances;
+    for (unsigned int indElem = 0; indElem < parserElems.size(); indElem++) {
+        Element &elem = parserElems[indElem];
+
+        switch (elem.elemType) {
+        case STAT_CAPACITANCE:
+            break;
+        case STAT_INDUCTANCE: {
+            std::stringstream ssVS;
+            ssVS << "V_L_" << elem.name << " " << elem.nodeList[0] << " "
+                 << elem.nodeList[1] << " " << 0;
+            std::string strVS = ssVS.str();
+            Element elemVS(strVS);
+            elements.push_back(std::move(elemVS));
+            indInductances.push_back(indElem);
+        } break;
+        case STAT_VOLTAGESOURCE: {
+            // The source keeps its name for current-controlled sources.
+            std::stringstream ssVS;
+            ssVS << elem.name << " " << elem.nodeList[0] << " "
+                 << elem.nodeList[1] << " " << 0;
+            std::string strVS = ssVS.str();
+            Element elemVS(strVS);
+            elements.push_back(std::move(elemVS));
+            inputElems.push_back(indElem);
+        } break;
+        case STAT_CURRENTSOURCE:
+            inputElems.push_back(indElem);
+            break;
+        case STAT_RESISTANCE:
+        case STAT_VCVS:
+        case STAT_VCCS:
+        case STAT_CCVS:
+        case STAT_CCCS:
+            elements.push_back(elem);
+            break;
+        default:
+            std::cerr << "STATESPACE : Unsupported element " << elem.name << "!" << std::endl;
+            exit(-1);
+        }
+    }
+
+    ElementList elemList(std::move(elements));
+    Assembly ass(nodeList, &elemList, false, false);
+
+    numStates = ass.numDoF;
+    numInputs = inputElems.size();
+
+    E = new Matrix(numStates, numStates);
+    A = ass.systemMNA->mul_scalar(-1);
+    B = new Matrix(numStates, numInputs);
+
+    // Capacitances contribute to the KCL equations of the nodes and the
+    // inductances to the equations of their voltage sources:
+    // V(n1) - V(n2) + L dI/dt = 0, where I is the current DoF, which flows
+    // into the node n1 from the source.
+    for (unsigned int indElem = 0; indElem < parserElems.size(); indElem++) {
+        Element &elem = parserElems[indElem];
+        if (elem.elemType != STAT_CAPACITANCE) continue;
+
+        double capValue = elem.valueList[0];
+        int node1 = nodeList->node(elem.nodeIds[0]) - 1,
+            node2 = nodeList->node(elem.nodeIds[1]) - 1;
+        if (node1 >= 0) E->addto(node1, node1,  capValue);
+        if (node2 >= 0) E->addto(node2, node2,  capValue);
+        if (node1 >= 0 && node2 >= 0) {
+            E->addto(node1, node2, -capValue);
+            E->addto(node2, node1, -capValue);
+        }
+    }
+    for (unsigned int ind = 0; ind < indInductances.size(); ind++) {
+        Element &elem = parserElems[indInductances[ind]];
+        unsigned int dof = ass.sourceDoF(symbols.intern("V_L_" + elem.name)) - 1;
+        E->set(dof, dof, elem.valueList[0]);
+    }
+
+    // The voltage sources are the right-hand sides of their equations and
+    // the current sources flow from the node n1 to the node n2.
+    for (unsigned int indInput = 0; indInput < numInputs; indInput++) {
+        Element &elem = parserElems[inputElems[indInput]];
+        if (elem.elemType == STAT_VOLTAGESOURCE) {
+            B->set(ass.sourceDoF(elem.nameId) - 1, indInput, 1);
+        } else {
+            int node1 = nodeList->node(elem.nodeIds[0]) - 1,
+                node2 = nodeList->node(elem.nodeIds[1]) - 1;
+            if (node1 >= 0) B->addto(node1, indInput, -1);
+            if (node2 >= 0) B->addto(node2, indInput,  1);
+        }
+    }
+
+    // Outputs.
+    std::vector <Probe> probes = parser->probes;
+    if (probes.size() == 0) {
+        for (unsigned int indNode = 1; indNode < nodeList->numNodes; indNode++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_VOLTAGE;
+            probe.name  = "V(" + nodeList->mapNodeString[indNode] + ")";
+            probe.node1 = indNode;
+            probe.node2 = 0;
+            probes.push_back(probe);
+        }
+    }
+    numOutputs = probes.size();
+    C = new Matrix(numOutputs, numStates);
+    D = new Matrix(numOutputs, numInputs);
+
+    for (unsigned int indProbe = 0; indProbe < numOutputs; indProbe++) {
+        Probe &probe = probes[indProbe];
+        outputNames.push_back(probe.name);
+
+        if (probe.type == Probe::PROBE_VOLTAGE) {
+            if (probe.node1 > 0) C->addto(indProbe, probe.node1 - 1,  1);
+            if (probe.node2 > 0) C->addto(indProbe, probe.node2 - 1, -1);
+            continue;
+        }
+
+        Element &elem = parserElems[probe.elemInd];
+        int node1 = nodeList->node(elem.nodeIds[0]) - 1,
+            node2 = nodeList->node(elem.nodeIds[1]) - 1;
+
+        // The currents of the sources are defined as in Assembly::postProc.
+        switch (elem.elemType) {
+        case STAT_RESISTANCE:
+            if (node1 >= 0) C->addto(indProbe, node1,  1/elem.valueList[0]);
+            if (node2 >= 0) C->addto(indProbe, node2, -1/elem.valueList[0]);
+            break;
+        case STAT_INDUCTANCE:
+            C->set(indProbe, ass.sourceDoF(symbols.intern("V_L_" + elem.name)) - 1, -1);
+            break;
+        case STAT_VOLTAGESOURCE:
+        case STAT_VCVS:
+        case STAT_CCVS:
+            C->set(indProbe, ass.sourceDoF(elem.nameId) - 1, -1);
+            break;
+        case STAT_CURRENTSOURCE:
+            for (unsigned int indInput = 0; indInput < numInputs; indInput++) {
+                if (inputElems[indInput] == probe.elemInd) {
+                    D->set(indProbe, indInput, 1);
+                }
+            }
+            break;
+        case STAT_VCCS: {
+            double gainValue = elem.valueList[0];
+            int node3 = nodeList->node(elem.nodeIds[2]) - 1,
+                node4 = nodeList->node(elem.nodeIds[3]) - 1;
+            if (node3 >= 0) C->addto(indProbe, node3,  gainValue);
+            if (node4 >= 0) C->addto(indProbe, node4, -gainValue);
+        } break;
+        case STAT_CCCS:
+            C->set(indProbe, ass.sourceDoF(elem.elemIds[0]) - 1, -elem.valueList[0]);
+            break;
+        default:
+            std::cerr << "STATESPACE : Current of " << elem.name
+                      << " cannot be an output!" << std::endl;
+            exit(-1);
+        }
+    }
+}
+
+StateSpace::StateSpace(StateSpace *full, Matrix &basis) {
+    assert(basis.rows == (int) full->numStates);
+
+    parser      = full->parser;
+    inputElems  = full->inputElems;
+    outputNames = full->outputNames;
+    numStates   = basis.cols;
+    numInputs   = full->numInputs;
+    numOutputs  = full->numOutputs;
+
+    Matrix *basisT = basis.transpose();
+    Matrix *EX = full->E->mul_right(basis),
+           *AX = full->A->mul_right(basis);
+
+    E = basisT->mul_right(*EX);
+    A = basisT->mul_right(*AX);
+    B = basisT->mul_right(*full->B);
+    C = full->C->mul_right(basis);
+    D = new Matrix(*full->D);
+
+    delete EX;
+    delete AX;
+    delete basisT;
+}
+
+void
+StateSpace::frequencyResponse(double freq, Matrix &Hre, Matrix &Him) {
+    // As in Assembly, the complex equations (jwE - A) x = B are written as
+    // real equations for the real and imaginary parts of x.
+    unsigned int n = numStates;
+    double omega = 2*M_PI*freq;
+
+    Hre = Matrix(numOutputs, numInputs);
+    Him = Matrix(numOutputs, numInputs);
+    for (unsigned int row = 0; row < numOutputs; row++) {
+        for (unsigned int col = 0; col < numInputs; col++) {
+            Hre.set(row, col, D->value(row, col));
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+
+    Matrix M(2*n, 2*n), L(2*n, 2*n), U(2*n, 2*n), P(2*n, 2*n);
+    for (unsigned int row = 0; row < n; row++) {
+        for (unsigned int col = 0; col < n; col++) {
+            M.set(row,     col,     -A->value(row, col));
+            M.set(row + n, col + n, -A->value(row, col));
+            M.set(row,     col + n, -omega*E->value(row, col));
+            M.set(row + n, col,      omega*E->value(row, col));
+        }
+    }
+    M.LU(L, U, P);
+
+    double *b = new double[2*n];
+    for (unsigned int indInput = 0; indInput < numInputs; indInput++) {
+        for (unsigned int row = 0; row < n; row++) {
+            b[row]     = B->value(row, indInput);
+            b[row + n] = 0;
+        }
+        double *x = M.LU_solve(L, U, P, b);
+
+        for (unsigned int indOutput = 0; indOutput < numOutputs; indOutput++) {
+            double re = 0, im = 0;
+            for (unsigned int ind = 0; ind < n; ind++) {
+                re += C->value(indOutput, ind)*x[ind];
+                im += C->value(indOutput, ind)*x[ind + n];
+            }
+            Hre.addto(indOutput, indInput, re);
+            Him.addto(indOutput, indInput, im);
+        }
+        delete [] x;
+    }
+    delete [] b;
+}
+
+StateSpace::~StateSpace() {
+    delete E;
+    delete A;
+    delete B;
+    delete C;
+    delete D;
+    E = A = B = C = D = 0;
+}
+
+void
+StateSpace::disp() {
+    std::cout << std::endl << "State-space model: " << numStates << " states, "
+              << numInputs << " inputs, " << numOutputs << " outputs" << std::endl;
+    std::cout << "E = ";
+    E->disp();
+    std::cout << "A = ";
+    A->disp();
+    std::cout << "B = ";
+    B->disp();
+    std::cout << "C = ";
+    C->disp();
+    std::cout << "D = ";
+    D->disp();
+}
+
+#ifdef STATESPACE_TEST
+
+int
+main(int argc, char **argv) {
+    std::string fileName = "test_capacitance.cir";
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+    StateSpace ss(&parser);
+    ss.disp();
+}
+
+#endif
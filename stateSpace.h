@@ -0,0 +1,74 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STATESPACE_H
+#define STATESPACE_H
+
+#include "parser.h"
+#include "assembly.h"
+#include "matrix.h"
+
+#include <vector>
+#include <string>
+
+/* StateSpace object extracts the descriptor state-space model
+ *
+ *   E x'(t) = A x(t) + B u(t)
+ *   y(t)    = C x(t) + D u(t)
+ *
+ * of a linear circuit from the MNA equations. The state vector x consists of
+ * the MNA degrees of freedom: the voltages of the non-datum nodes followed by
+ * the currents of the voltage sources, the inductances and the controlled
+ * voltage sources. The inputs u are the values of the independent sources in
+ * the order of the element list. The outputs y are the output variables
+ * selected with .PRINT, .PLOT and .PROBE statements or, by default, the node
+ * voltages. Currents of capacitances cannot be used as outputs.
+ *
+ * A = -G is obtained by assembly of the circuit with the capacitances removed
+ * and the inductances replaced with zero voltage sources, whose current DoFs
+ * are the currents of the inductances. E contains the capacitances and the
+ * inductances.
+ *
+ * A reduced model with the same inputs and outputs is obtained from the
+ * projection x = X xr onto the columns of the basis X:
+ * E = X^T E X, A = X^T A X, B = X^T B, C = C X. See Prima.
+ */
+
+class StateSpace {
+public:
+    StateSpace(Parser *_parser);
+    StateSpace(StateSpace *full, Matrix &basis);
+    ~StateSpace();
+
+    void disp();
+    // The transfer functions H = C (j 2 pi freq E - A)^-1 B + D from the
+    // inputs to the outputs at the frequency freq.
+    void frequencyResponse(double freq, Matrix &Hre, Matrix &Him);
+
+    unsigned int numStates, numInputs, numOutputs;
+    Matrix *E, *A, *B, *C, *D;
+
+    // Indices of the input sources in the element list of the parser.
+    std::vector <unsigned int> inputElems;
+    std::vector <std::string> outputNames;
+
+private:
+    Parser *parser;
+};
+
+#endif // STATESPACE_H
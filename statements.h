@@ -70,9 +70,9 @@ enum {STAT_EMPTY,
       // Post-Processing:
       STAT_NODESET,       //
       STAT_NOISE,         //
-      STAT_PLOT,          //
-      STAT_PRINT,         //
-      STAT_PROBE          //
+      STAT_PLOT,          // .PLOT [type] {V(+n[,-n]) | I(name)}*
+      STAT_PRINT,         // .PRINT [type] {V(+n[,-n]) | I(name)}*
+      STAT_PROBE          // .PROBE {V(+n[,-n]) | I(name)}*
      };
 
 struct {
@@ -114,11 +114,11 @@ struct {
     STAT_SUBCKTCALL,     CLASS_SUBCKT,    "X",          true,  false, 2, 1024, "Subcircuit Call",
     STAT_NODESET,        CLASS_ANALYSIS,  ".NODESET",   false, false, 1, 1024, "Initial Bias Point Guess",
     STAT_NOISE,          CLASS_ANALYSIS,  ".NOISE",     false, false, 2, 3,    "Noise Analysis",
-    STAT_PLOT,           CLASS_POSTPROC,  ".PLOT",      false, false, 2, 1024, "Plot Output",
-    STAT_PRINT,          CLASS_POSTPROC,  ".PRINT",     false, false, 2, 1024, "Print Output",
-    STAT_PROBE,          CLASS_POSTPROC,  ".PROBE",     false, false, 0, 1024, "Save Output"
+    STAT_PLOT,           CLASS_POSTPROC,  ".PLOT",      false, true,  0, 1024, "Plot Output",
+    STAT_PRINT,          CLASS_POSTPROC,  ".PRINT",     false, true,  0, 1024, "Print Output",
+    STAT_PROBE,          CLASS_POSTPROC,  ".PROBE",     false, true,  0, 1024, "Save Output"
 };
 
-const unsigned int numStatements = STAT_PROBE;
+const unsigned int numStatements = STAT_PROBE + 1;
 
 #endif // STATEMENT_H
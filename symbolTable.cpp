@@ -0,0 +1,53 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "symbolTable.h"
+#include <assert.h>
+
+SymbolTable symbols;
+
+unsigned int
+SymbolTable::intern(const std::string &name) {
+    std::lock_guard <std::mutex> lock(mutex);
+    return table.insert(name, 0);
+}
+
+int
+SymbolTable::find(const std::string &name) const {
+    std::lock_guard <std::mutex> lock(mutex);
+    return table.find(name);
+}
+
+const std::string &
+SymbolTable::name(unsigned int id) const {
+    std::lock_guard <std::mutex> lock(mutex);
+    assert(id < table.size());
+    return table.name(id);
+}
+
+unsigned int
+SymbolTable::size() const {
+    std::lock_guard <std::mutex> lock(mutex);
+    return table.size();
+}
+
+void
+SymbolTable::reserve(unsigned int numNames) {
+    std::lock_guard <std::mutex> lock(mutex);
+    table.reserve(numNames);
+}
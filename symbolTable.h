@@ -0,0 +1,55 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <string>
+#include <mutex>
+
+#include "nameTable.h"
+
+/* SymbolTable object interns the names of the nodes and the elements: each
+ * distinct name is given a dense integer id in the order of first
+ * occurrence. The ids are assigned at parse time and stored in the Element
+ * objects, so that NodeList, ElementList and Assembly can resolve nodes and
+ * elements with vectors indexed by the ids instead of comparing strings.
+ *
+ * The names are never removed. The table is shared by all circuits through
+ * the global object symbols and can be used from multiple threads. The ids
+ * are the entries of a NameTable.
+ */
+
+class SymbolTable {
+public:
+    // Returns the id of the name, which is added if not found.
+    unsigned int intern(const std::string &name);
+    // Returns the id of the name or -1 if the name has not been interned.
+    int find(const std::string &name) const;
+    const std::string &name(unsigned int id) const;
+    unsigned int size() const;
+    // Allocate space for numNames names in total.
+    void reserve(unsigned int numNames);
+private:
+    NameTable table;
+    mutable std::mutex mutex;
+};
+
+extern SymbolTable symbols;
+
+#endif // SYMBOLTABLE_H
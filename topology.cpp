@@ -43,7 +43,8 @@ Topology::addEdge(unsigned int node1, unsigned int node2, unsigned int globInd)
 
 void
 Topology::addEdge(std::string node1, std::string node2, unsigned int globInd) {
-    addEdge(mapStringNode[node1], mapStringNode[node2], globInd);
+    assert(nodeExists(node1) && nodeExists(node2));
+    addEdge(findNode(node1), findNode(node2), globInd);
 }
 
 void
@@ -16,113 +16,120 @@
 */
 
 #include "transient.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
-Transient::Transient(Parser *_parser, double _dt, double _t2, double _t1, double _theta) {
+Transient::Transient(Parser *_parser, double _dt, double _t2, double _t1, double _theta,
+                     unsigned int _method) {
+    init(_parser->nodeList, _parser->elemList, _parser->probes, _dt, _t2, _t1, _theta, _method);
+}
+
+Transient::Transient(NodeList *_nodeList, ElementList *_elemList,
+                     const std::vector <Probe> &_probes, double _dt, double _t2,
+                     double _t1, double _theta, unsigned int _method) {
+    init(_nodeList, _elemList, _probes, _dt, _t2, _t1, _theta, _method);
+}
+
+void
+Transient::init(NodeList *_nodeList, ElementList *_elemList,
+                const std::vector <Probe> &_probes, double _dt, double _t2,
+                double _t1, double _theta, unsigned int _method) {
     dt = _dt;
     t1 = _t1;
     t2 = _t2;
     theta = _theta;
-    parser = _parser;
+    method = _method;
+    gearOrder = 2;
+    verbose = true;
+    writer = 0;
+    pipelined = false;
+    pipelineDepth = 64;
+    sampleRing = 0;
+    checkpointInterval = 600;
+    checkpointTime = time(0);
+    nodeList = _nodeList;
+    circuit  = _elemList;
+    t = t1;
+    hMin = dt*1e-9;
+    timeHist[0] = t1;
+    numHist = 1;
+    historyValid = false;
+    stampH = dt;
+    stampThetaParam = theta;
+    tableCursor = 0;
 
     // Construct new element list by replacing energy storage elements with
-    // Norton companion models.
+    // Norton companion models. The values of the elements in the companion
+    // models depend on the time step and are set by stampTheta and stampGear.
     unsigned int indNew = 0;
     std::vector <Element> elements;
-    std::vector <unsigned int> currentInds;
-    std::vector <double> propConstVolt, propConstCur;
 
-    unsigned int indWF = 0;
-    std::vector <unsigned int> wfSourceInds;
-    std::vector <Waveform> sourceWfs;
-
-
-    for (unsigned int indElem = 0; indElem < parser->elemList->elements.size(); indElem++) {
-        Element elem = parser->elemList->elements[indElem];
+    for (unsigned int indElem = 0; indElem < circuit->elements.size(); indElem++) {
+        const Element &elem = circuit->elements[indElem];
 
         std::vector <int> modelList;
-        if (elem.elemType == STAT_CAPACITANCE) {
-            // Norton companion model for the capacitance is parallel combination
-            // of a conductance G=C/dt and current source with J=C/h times voltage
-            // from previous time step.
+        if (elem.elemType == STAT_CAPACITANCE || elem.elemType == STAT_INDUCTANCE) {
+            // Norton companion models for the capacitance and the inductance
+            // are parallel combinations of a conductance and a current source.
+            // See stampTheta and stampGear.
 
             assert(elem.valueList.size() >= 1);
             assert(elem.nodeList.size() >= 2);
-            double capValue = elem.valueList[0];
 
-            std::stringstream ssCurrent, ssRes;
-            ssRes << "R_dummy_" << elem.name << " "
-                  << elem.nodeList[0] << " " << elem.nodeList[1] << " " << dt/capValue;
-            ssCurrent << "I_dummy_" << elem.name << " "
-                      << elem.nodeList[0] << " " << elem.nodeList[1] << " "
-                      << capValue*0/dt;
-            std::string strCurrent = ssCurrent.str(),
-                        strRes     = ssRes.str();
-
-            Element elemRes(strRes), elemCur(strCurrent);
-            elements.push_back(elemRes);
-            modelList.push_back(indNew);
-            indNew++;
-            elements.push_back(elemCur);
-            modelList.push_back(indNew);
-            currentInds.push_back(indNew);
-            indNew++;
-
-            propConstVolt.push_back(capValue/dt);
-            propConstCur.push_back(0);
-
-        } else if (elem.elemType == STAT_INDUCTANCE) {
-            // Norton companion model for the inductance is the parallel combination
-            // of a conductance G=dt*theta/L and current source
-            // J = -I(prev) - (dt/L)*(1-theta)*V(prev).
-
-            assert(elem.valueList.size() >= 1);
-            double indValue = elem.valueList[0];
+            CompanionModel model;
+            model.elemType = elem.elemType;
+            model.value    = elem.valueList[0];
+            model.indRes   = -1;
+            model.node1    = nodeList->node(elem.nodeIds[0]);
+            model.node2    = nodeList->node(elem.nodeIds[1]);
+            for (unsigned int indHist = 0; indHist <= maxGearOrder; indHist++) {
+                model.voltage[indHist] = 0;
+                model.current[indHist] = 0;
+            }
 
             std::stringstream ssCurrent, ssRes;
             ssRes << "R_dummy_" << elem.name << " "
-                  << elem.nodeList[0] << " " << elem.nodeList[1] << " " << indValue/(dt*theta);
+                  << elem.nodeList[0] << " " << elem.nodeList[1] << " " << 1;
             ssCurrent << "I_dummy_" << elem.name << " "
-                      << elem.nodeList[0] << " " << elem.nodeList[1] << " "
-                      << -(1-theta)*0*dt/indValue;
-
+                      << elem.nodeList[0] << " " << elem.nodeList[1] << " " << 0;
             std::string strCurrent = ssCurrent.str(),
                         strRes     = ssRes.str();
 
-            // With Forward Euler, theta = 0 and conductance becomes zero.
-            if (theta != 0) {
-                Element elemRes(strRes);
-                elements.push_back(elemRes);
+            // With Forward Euler, theta = 0 and the conductance of the inductance
+            // becomes zero.
+            if (elem.elemType == STAT_CAPACITANCE || theta != 0 || method != METHOD_THETA) {
+                elements.push_back(Element(strRes));
                 modelList.push_back(indNew);
+                model.indRes = indNew;
                 indNew++;
             }
-            Element elemCur(strCurrent);
-            elements.push_back(elemCur);
+            elements.push_back(Element(strCurrent));
             modelList.push_back(indNew);
-            currentInds.push_back(indNew);
+            model.indCur = indNew;
             indNew++;
 
-            // Current from previous time step included in the source current is the sum
-            // of currents through both branches in the companion model. The part of the
-            // current due to the conductance is included in the proportionality constant
-            // for the voltage. The proportionality constant due to current corresponds
-            // to the part of current due to the current source.
-
-            propConstVolt.push_back(-(1-theta)*dt/indValue - (dt*theta)/indValue);
-            propConstCur.push_back(-1);
+            companions.push_back(model);
         } else if ((elem.elemType == STAT_VOLTAGESOURCE || elem.elemType== STAT_CURRENTSOURCE) && elem.waveForm) {
             std::stringstream ssVS;
-            ssVS << "V_dummy_" << elem.name << " "
-                  << elem.nodeList[0] << " " << elem.nodeList[1] << " "
-                  << 0;
+            if (elem.elemType == STAT_VOLTAGESOURCE) {
+                ssVS << "V_dummy_";
+            } else {
+                ssVS << "I_dummy_";
+            }
+            ssVS << elem.name << " "
+                 << elem.nodeList[0] << " " << elem.nodeList[1] << " "
+                 << 0;
             std::string strVS = ssVS.str();
 
-            elem.waveForm->setTransientParameters(dt, t1, t2);
-            Element elemVS(strVS);
-            elements.push_back(elemVS);
+            elements.push_back(Element(strVS));
             sourceWfs.push_back(*elem.waveForm);
+            sourceWfs.back().setTransientParameters(dt, t1, t2);
+            sourceStates.push_back(WaveformState());
+            sourceBreakpoints.push_back(true);
             wfSourceInds.push_back(indNew);
+            modelList.push_back(indNew);
             indNew++;
-            indWF++;
         } else {
             elements.push_back(elem);
             modelList.push_back(indNew);
@@ -131,21 +138,243 @@ Transient::Transient(Parser *_parser, double _dt, double _t2, double _t1, double
         companionInd.push_back(modelList);
     }
 
-    elemList = new ElementList(elements);
+    elemList = new ElementList(std::move(elements));
+
+    // Without output variables in the circuit, all node voltages and
+    // element currents are written.
+    probes = _probes;
+    if (probes.size() == 0) {
+        for (unsigned int indNode = 1; indNode < nodeList->numNodes; indNode++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_VOLTAGE;
+            probe.name  = "V(" + nodeList->mapNodeString[indNode] + ")";
+            probe.args.push_back(nodeList->mapNodeString[indNode]);
+            probe.node1 = indNode;
+            probe.node2 = 0;
+            probe.elemInd = 0;
+            probes.push_back(probe);
+        }
+        for (unsigned int indElem = 0; indElem < circuit->elements.size(); indElem++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_CURRENT;
+            probe.name  = "I(" + circuit->elements[indElem].name + ")";
+            probe.args.push_back(circuit->elements[indElem].name);
+            probe.node1 = probe.node2 = 0;
+            probe.elemInd = indElem;
+            probes.push_back(probe);
+        }
+    }
+    outputs.assign(probes.size(), 0);
+
+    std::set <unsigned int> postProcSet;
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        if (probes[indProbe].type == Probe::PROBE_CURRENT) {
+            std::vector <int> &modelList = companionInd[probes[indProbe].elemInd];
+            postProcSet.insert(modelList.begin(), modelList.end());
+        }
+    }
+    postProcInds.assign(postProcSet.begin(), postProcSet.end());
+}
+
+void
+Transient::setWaveform(unsigned int indElem, const Waveform &waveForm, bool breakpoints) {
+    assert(indElem < companionInd.size());
+    unsigned int indSource = companionInd[indElem][0];
+    for (unsigned int ind = 0; ind < wfSourceInds.size(); ind++) {
+        if (wfSourceInds[ind] == (unsigned int) indSource) {
+            sourceWfs[ind] = waveForm;
+            sourceWfs[ind].setTransientParameters(dt, t1, t2);
+            sourceStates[ind] = WaveformState();
+            sourceBreakpoints[ind] = breakpoints;
+            tableTimes.clear();
+            return;
+        }
+    }
+    std::cerr << "TRANSIENT : Element " << circuit->elements[indElem].name
+              << " is not a source with a waveform!" << std::endl;
+    exit(-1);
+}
+
+void
+Transient::signalNames(std::vector <std::string> &names) {
+    names.clear();
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        names.push_back(probes[indProbe].name);
+    }
+}
+
+double
+Transient::nodeVoltage(unsigned int node) {
+    if (node == 0) {
+        return 0;
+    }
+    return solution[node - 1];
+}
+
+double
+Transient::nextBreakpoint(double _t) {
+    double tBreak = HUGE_VAL;
+    for (unsigned int ind = 0; ind < sourceWfs.size(); ind++) {
+        if (!sourceBreakpoints[ind]) continue;
+        double tWave = sourceWfs[ind].nextBreakpoint(_t + hMin, sourceStates[ind]);
+        if (tWave < tBreak) {
+            tBreak = tWave;
+        }
+    }
+    return tBreak;
+}
+
+void
+Transient::stampTheta(double h, double _theta) {
+    stampH = h;
+    stampThetaParam = _theta;
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+        double G = 0, J = 0;
+
+        if (model.elemType == STAT_CAPACITANCE) {
+            // _theta*I(next) + (1-_theta)*I(prev) = C*(V(next) - V(prev))/h
+            // leads to G = C/(_theta*h) and
+            // J = -G*V(prev) - I(prev)*(1-_theta)/_theta.
+            // Forward Euler cannot be written as a companion model of the
+            // capacitance and Backward Euler is used instead.
+            if (_theta == 0) {
+                G = model.value/h;
+                J = -G*model.voltage[0];
+            } else {
+                G = model.value/(_theta*h);
+                J = -G*model.voltage[0] - model.current[0]*(1-_theta)/_theta;
+            }
+        } else {
+            // I(next) = I(prev) + (h/L)*(_theta*V(next) + (1-_theta)*V(prev))
+            // leads to G = h*_theta/L and J = I(prev) + (h/L)*(1-_theta)*V(prev).
+            G = h*_theta/model.value;
+            J = model.current[0] + (1-_theta)*h*model.voltage[0]/model.value;
+        }
+        if (model.indRes >= 0) {
+            elemList->elements[model.indRes].valueList[0] = 1/G;
+        }
+        elemList->elements[model.indCur].valueList[0] = J;
+    }
+}
+
+void
+Transient::stampGear(double tNew, unsigned int order) {
+    assert(order >= 1 && order <= maxGearOrder && order <= numHist);
+
+    // The derivative at tNew is approximated by the derivative of the
+    // polynomial interpolating the solution at tNew and the order latest
+    // time points: x'(tNew) = sum_j alpha[j]*x_j, where x_0 = x(tNew) and
+    // x_j with j > 0 are the history points. The coefficients are the
+    // derivatives of the Lagrange basis polynomials at tNew.
+    double times[maxGearOrder + 1], alpha[maxGearOrder + 1];
+    times[0] = tNew;
+    for (unsigned int j = 1; j <= order; j++) {
+        times[j] = timeHist[j-1];
+    }
+    alpha[0] = 0;
+    for (unsigned int m = 1; m <= order; m++) {
+        alpha[0] += 1/(times[0] - times[m]);
+    }
+    for (unsigned int j = 1; j <= order; j++) {
+        double coeff = 1/(times[j] - times[0]);
+        for (unsigned int m = 1; m <= order; m++) {
+            if (m != j) {
+                coeff *= (times[0] - times[m])/(times[j] - times[m]);
+            }
+        }
+        alpha[j] = coeff;
+    }
+
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+        double G = 0, J = 0;
+
+        if (model.elemType == STAT_CAPACITANCE) {
+            // I(next) = C*(alpha_0*V(next) + sum_j alpha_j*V_j)
+            G = model.value*alpha[0];
+            for (unsigned int j = 1; j <= order; j++) {
+                J += model.value*alpha[j]*model.voltage[j-1];
+            }
+        } else {
+            // V(next) = L*(alpha_0*I(next) + sum_j alpha_j*I_j)
+            G = 1/(model.value*alpha[0]);
+            for (unsigned int j = 1; j <= order; j++) {
+                J -= alpha[j]*model.current[j-1]/alpha[0];
+            }
+        }
+        if (model.indRes >= 0) {
+            elemList->elements[model.indRes].valueList[0] = 1/G;
+        }
+        elemList->elements[model.indCur].valueList[0] = J;
+    }
+}
+
+void
+Transient::updateCompanions(double tNew) {
+    for (unsigned int indHist = maxGearOrder; indHist > 0; indHist--) {
+        timeHist[indHist] = timeHist[indHist-1];
+    }
+    timeHist[0] = tNew;
+    if (numHist <= maxGearOrder) {
+        numHist++;
+    }
+
+    // The current through the energy storage element is the sum of the
+    // currents through both branches of the companion model.
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+
+        for (unsigned int indHist = maxGearOrder; indHist > 0; indHist--) {
+            model.voltage[indHist] = model.voltage[indHist-1];
+            model.current[indHist] = model.current[indHist-1];
+        }
+        double voltage = nodeVoltage(model.node1) - nodeVoltage(model.node2);
+        model.voltage[0] = voltage;
+        model.current[0] = elemList->elements[model.indCur].valueList[0];
+        if (model.indRes >= 0) {
+            model.current[0] += voltage/elemList->elements[model.indRes].valueList[0];
+        }
+    }
+}
+
+void
+Transient::solve(double tNew) {
+    // The values of the sources are read from the table of the next time
+    // points, which is refilled when tNew is not the next point in it.
+    if (tableCursor >= tableTimes.size() || tableTimes[tableCursor] != tNew) {
+        fillSourceTable();
+        while (tableCursor < tableTimes.size() && tableTimes[tableCursor] < tNew) {
+            tableCursor++;
+        }
+    }
+    bool inTable = tableCursor < tableTimes.size() && tableTimes[tableCursor] == tNew;
+    unsigned int numTimes = tableTimes.size();
 
-    // Perform the time integration.
-    for (double t=t1; t < t2; t+=dt) {
-        for (unsigned int ind = 0; ind < indWF; ind++) {
-            unsigned int indSource = wfSourceInds[ind];
+    for (unsigned int ind = 0; ind < sourceWfs.size(); ind++) {
+        unsigned int indSource = wfSourceInds[ind];
 
-            double val = sourceWfs[ind].eval(t);
-            elemList->elements[indSource].valueList[0] = val;
-            std::cout << "EFEVAL " << t << "->" << val << std::endl;
+        double val;
+        if (inTable) {
+            val = sourceTable[ind*numTimes + tableCursor];
+        } else {
+            val = sourceWfs[ind].eval(tNew, sourceStates[ind]);
+        }
+        elemList->elements[indSource].valueList[0] = val;
+        if (verbose) {
+            std::cout << "EFEVAL " << tNew << "->" << val << std::endl;
         }
+    }
+
+    if (inTable) {
+        tableCursor++;
+    }
 
-        // Assemble the MNA equations for the modified circuit.
-        Assembly ass(parser->nodeList, elemList, false);
+    // Assemble the MNA equations for the modified circuit.
+    Assembly ass(nodeList, elemList, false, verbose);
+    double *sol = ass.solve();
 
+    if (verbose) {
         std::cout << std::endl << "Full Matrix:" << std::endl;
         ass.fullMNA->disp();
         std::cout << std::endl << "System Matrix:" << std::endl;
@@ -157,49 +386,595 @@ Transient::Transient(Parser *_parser, double _dt, double _t2, double _t1, double
         }
         std::cout << std::endl;
         std::cout << std::endl << "Solution:" << std::endl;
-        double *sol = ass.solve();
         for (unsigned int ind = 0; ind < ass.numDoF; ind++) {
             std::cout << sol[ind] << " ";
         }
         std::cout << std::endl;
+    }
 
-        unsigned int numNodes = parser->nodeList->numNodes;
+    // During pipelined integration, the output variables are computed by
+    // the post-processing stage.
+    if (verbose) {
         ass.postProc(sol);
         ass.disp();
+    } else if (!sampleRing) {
+        ass.postProc(sol, postProcInds);
+    }
+    solution.assign(sol, sol + ass.numDoF);
+    delete [] sol;
 
-        // Update current source values in Norton equivalents for energy
-        // storage elements.
-        delete [] sol;
-        for (unsigned int indElem = 0; indElem < currentInds.size(); indElem++) {
-            unsigned int elemInd = currentInds[indElem];
+    if (!sampleRing) {
+        computeOutputs(ass, &solution[0], outputs);
+    }
 
-            elemList->elements[elemInd].valueList[0] = -propConstVolt[indElem] * ass.voltageRe[elemInd]
-                                                       -propConstCur[indElem] * ass.currentRe[elemInd];
+    if (tangent.size() > 0) {
+        propagateTangent(ass);
+    }
+
+    // Update the branch voltages and currents of energy storage elements
+    // used in the Norton equivalents of the next time steps.
+    updateCompanions(tNew);
+}
+
+void
+Transient::computeOutputs(Assembly &ass, const double *sol, std::vector <double> &out) {
+    // The current of an element in the original circuit is the sum of the
+    // currents of the elements in its companion model.
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        Probe &probe = probes[indProbe];
+
+        if (probe.type == Probe::PROBE_VOLTAGE) {
+            double voltage = 0;
+            if (probe.node1 > 0) {
+                voltage += sol[probe.node1 - 1];
+            }
+            if (probe.node2 > 0) {
+                voltage -= sol[probe.node2 - 1];
+            }
+            out[indProbe] = voltage;
+        } else {
+            std::vector <int> &modelList = companionInd[probe.elemInd];
+            out[indProbe] = 0;
+            for (unsigned int indModel = 0; indModel < modelList.size(); indModel++) {
+                out[indProbe] += ass.currentRe[modelList[indModel]];
+            }
         }
     }
 }
 
-Transient::~Transient() {
+double
+Transient::stepSize(double _t, double &tNew, bool &atBreak) {
+    // Select the time step so that the next breakpoint is not stepped over.
+    // Stepping directly to a breakpoint closer than two time steps would
+    // often leave a very short step after it and thus the remaining interval
+    // is halved.
+    double h = dt;
+    double tBreak = nextBreakpoint(_t);
+    if (tBreak > t2) {
+        tBreak = t2;
+    }
+    if (_t + h >= tBreak - hMin) {
+        h = tBreak - _t;
+    } else if (_t + 2*h > tBreak) {
+        h = 0.5*(tBreak - _t);
+    }
+    tNew = _t + h;
+    atBreak = tNew >= tBreak - hMin;
+    if (atBreak) {
+        tNew = tBreak;
+    }
+    return h;
+}
+
+void
+Transient::fillSourceTable() {
+    // The time steps depend only on the breakpoints and thus the time points
+    // of the next steps, including the intermediate stages of TR-BDF2, are
+    // known in advance.
+    double gamma = 2 - sqrt(2.0);
+    double tCur = t;
+    tableTimes.clear();
+    while (tableTimes.size() < tableBlock && tCur < t2 - hMin) {
+        double tNew;
+        bool atBreak;
+        double h = stepSize(tCur, tNew, atBreak);
+        if (method == METHOD_TRBDF2) {
+            tableTimes.push_back(tCur + gamma*h);
+        }
+        tableTimes.push_back(tNew);
+        tCur = tNew;
+    }
+
+    unsigned int numTimes = tableTimes.size();
+    sourceTable.resize(sourceWfs.size()*numTimes);
+    for (unsigned int ind = 0; ind < sourceWfs.size() && numTimes > 0; ind++) {
+        sourceWfs[ind].evalBlock(&tableTimes[0], &sourceTable[ind*numTimes], numTimes,
+                                 sourceStates[ind]);
+    }
+    tableCursor = 0;
+}
+
+bool
+Transient::step() {
+    if (t >= t2 - hMin) {
+        return false;
+    }
+
+    double tNew;
+    bool atBreak;
+    double h = stepSize(t, tNew, atBreak);
+
+    switch (method) {
+    case METHOD_THETA:
+        if (historyValid) {
+            stampTheta(h, theta);
+        } else {
+            stampTheta(h, 1);
+        }
+        solve(tNew);
+        break;
+    case METHOD_GEAR: {
+        unsigned int order = gearOrder;
+        if (order > numHist) {
+            order = numHist;
+        }
+        stampGear(tNew, order);
+        solve(tNew);
+      } break;
+    case METHOD_TRBDF2: {
+        // The currents of the energy storage elements are not known at the
+        // initial time and jump at the breakpoints. Thus, Backward Euler is
+        // used for the first stage after restart.
+        double gamma = 2 - sqrt(2.0);
+        if (!historyValid) {
+            stampTheta(gamma*h, 1);
+        } else {
+            stampTheta(gamma*h, 0.5);
+        }
+        solve(t + gamma*h);
+        stampGear(tNew, 2);
+        solve(tNew);
+      } break;
+    }
+    t = tNew;
+
+    if (sampleRing) {
+        TransientSample *sample = sampleRing->waitWriteSlot();
+        sample->t    = t;
+        sample->last = false;
+        sample->values.assign(solution.begin(), solution.end());
+        for (unsigned int ind = 0; ind < postProcInds.size(); ind++) {
+            sample->values.push_back(elemList->elements[postProcInds[ind]].valueList[0]);
+        }
+        sampleRing->push();
+    } else if (writer) {
+        writer->addRow(t, outputs);
+    }
+
+    // The solution is not smooth at the breakpoints and the history of
+    // multistep methods is restarted.
+    historyValid = true;
+    if (atBreak) {
+        numHist = 1;
+        historyValid = false;
+    }
+
+    if (checkpointFile.length() > 0 && difftime(time(0), checkpointTime) >= checkpointInterval) {
+        writeCheckpoint(checkpointFile);
+        checkpointTime = time(0);
+    }
+
+    return true;
+}
+
+/* Checkpoint file format (native byte order):
+ *   char[8]   magic "SSPCHK01"
+ *   uint32    method, gear order, maxGearOrder, number of history points,
+ *             number of DoFs, companion models and waveform sources
+ *   double    dt, t1, t2, theta, t
+ *   double    history time points [maxGearOrder + 1]
+ *   double    solution vector [DoFs]
+ *   double    voltage and current history of each companion model
+ *             [2*(maxGearOrder + 1)]
+ *   double    values of the waveform sources and the companion model
+ *             elements
+ * The circuit itself is not included and the file is validated against
+ * the circuit and the parameters of the Transient object reading it.
+ */
+
+void
+Transient::writeCheckpoint(const std::string &fileName) {
+    // The checkpoint is written into a temporary file renamed over the
+    // previous checkpoint so that an interrupted write does not destroy it.
+    std::string tmpName = fileName + ".tmp";
+    FILE *file = fopen(tmpName.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot open \"" << tmpName << "\" for writing!" << std::endl;
+        exit(-1);
+    }
+
+    const char magic[8] = {'S', 'S', 'P', 'C', 'H', 'K', '0', '1'};
+    uint32_t sizes[7] = {method, gearOrder, maxGearOrder, numHist,
+                         (uint32_t) solution.size(), (uint32_t) companions.size(),
+                         (uint32_t) sourceWfs.size()};
+    double params[5] = {dt, t1, t2, theta, t};
+
+    fwrite(magic, 1, 8, file);
+    fwrite(sizes, sizeof(uint32_t), 7, file);
+    fwrite(params, sizeof(double), 5, file);
+    fwrite(timeHist, sizeof(double), maxGearOrder + 1, file);
+    fwrite(solution.data(), sizeof(double), solution.size(), file);
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+        fwrite(model.voltage, sizeof(double), maxGearOrder + 1, file);
+        fwrite(model.current, sizeof(double), maxGearOrder + 1, file);
+    }
+    for (unsigned int ind = 0; ind < sourceWfs.size(); ind++) {
+        fwrite(&elemList->elements[wfSourceInds[ind]].valueList[0], sizeof(double), 1, file);
+    }
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+        if (model.indRes >= 0) {
+            fwrite(&elemList->elements[model.indRes].valueList[0], sizeof(double), 1, file);
+        }
+        fwrite(&elemList->elements[model.indCur].valueList[0], sizeof(double), 1, file);
+    }
+
+    bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed || rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        std::cerr << "Writing of checkpoint \"" << fileName << "\" failed!" << std::endl;
+        exit(-1);
+    }
+}
+
+void
+Transient::readCheckpoint(const std::string &fileName) {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Cannot open checkpoint \"" << fileName << "\"!" << std::endl;
+        exit(-1);
+    }
+
+    char magic[8];
+    uint32_t sizes[7] = {0};
+    double params[5] = {0};
+    bool valid = fread(magic, 1, 8, file) == 8
+              && strncmp(magic, "SSPCHK01", 8) == 0
+              && fread(sizes, sizeof(uint32_t), 7, file) == 7
+              && fread(params, sizeof(double), 5, file) == 5;
+
+    // The number of DoFs is not known before the first solution.
+    unsigned int numDoF = sizes[4];
+    valid = valid && sizes[0] == method && sizes[1] == gearOrder
+                  && sizes[2] == maxGearOrder && sizes[3] <= maxGearOrder + 1
+                  && sizes[5] == companions.size() && sizes[6] == sourceWfs.size()
+                  && (solution.size() == 0 || solution.size() == numDoF)
+                  && params[0] == dt && params[1] == t1 && params[2] == t2
+                  && params[3] == theta;
+    if (!valid) {
+        std::cerr << "Checkpoint \"" << fileName << "\" does not match the transient analysis!"
+                  << std::endl;
+        exit(-1);
+    }
+
+    numHist = sizes[3];
+    historyValid = numHist > 1;
+    t = params[4];
+    solution.resize(numDoF);
+    valid = fread(timeHist, sizeof(double), maxGearOrder + 1, file) == maxGearOrder + 1
+         && fread(solution.data(), sizeof(double), numDoF, file) == numDoF;
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+        valid = valid && fread(model.voltage, sizeof(double), maxGearOrder + 1, file) == maxGearOrder + 1
+                      && fread(model.current, sizeof(double), maxGearOrder + 1, file) == maxGearOrder + 1;
+    }
+    for (unsigned int ind = 0; ind < sourceWfs.size(); ind++) {
+        valid = valid && fread(&elemList->elements[wfSourceInds[ind]].valueList[0],
+                               sizeof(double), 1, file) == 1;
+    }
+    for (unsigned int indModel = 0; indModel < companions.size(); indModel++) {
+        CompanionModel &model = companions[indModel];
+        if (model.indRes >= 0) {
+            valid = valid && fread(&elemList->elements[model.indRes].valueList[0],
+                                   sizeof(double), 1, file) == 1;
+        }
+        valid = valid && fread(&elemList->elements[model.indCur].valueList[0],
+                               sizeof(double), 1, file) == 1;
+    }
+    fclose(file);
+
+    if (!valid) {
+        std::cerr << "Checkpoint \"" << fileName << "\" is truncated!" << std::endl;
+        exit(-1);
+    }
+    checkpointTime = time(0);
+}
+
+void
+Transient::initTangent() {
+    if (method != METHOD_THETA) {
+        std::cerr << "TRANSIENT : Sensitivity requires METHOD_THETA!" << std::endl;
+        exit(-1);
+    }
+    unsigned int numState = 2*companions.size();
+    tangent.assign(numState*numState, 0);
+    for (unsigned int ind = 0; ind < numState; ind++) {
+        tangent[ind*numState + ind] = 1;
+    }
+}
+
+void
+Transient::propagateTangent(Assembly &ass) {
+    // The step is linear in the state: the Norton currents of the companion
+    // models are the formulas of stampTheta applied to the tangents of the
+    // branch voltages and currents and the independent sources vanish.
+    unsigned int numModels = companions.size(),
+                 numState  = 2*numModels,
+                 n         = ass.numDoF;
+    double _theta = stampThetaParam, h = stampH;
+
+    Matrix L(n, n), U(n, n), P(n, n);
+    ass.systemMNA->LU(L, U, P);
+
+    std::vector <double> tangentNew(numState*numState), G(numModels), J(numModels);
+    double *rhs = new double[n];
+    for (unsigned int col = 0; col < numState; col++) {
+        for (unsigned int ind = 0; ind < n; ind++) {
+            rhs[ind] = 0;
+        }
+        for (unsigned int indModel = 0; indModel < numModels; indModel++) {
+            CompanionModel &model = companions[indModel];
+            double dV = tangent[indModel*numState + col],
+                   dI = tangent[(numModels + indModel)*numState + col];
+
+            G[indModel] = 0;
+            if (model.indRes >= 0) {
+                G[indModel] = 1/elemList->elements[model.indRes].valueList[0];
+            }
+            if (model.elemType == STAT_CAPACITANCE) {
+                J[indModel] = -G[indModel]*dV;
+                if (_theta != 0) {
+                    J[indModel] -= dI*(1 - _theta)/_theta;
+                }
+            } else {
+                J[indModel] = dI + (1 - _theta)*h*dV/model.value;
+            }
+            if (model.node1 > 0) rhs[model.node1 - 1] -= J[indModel];
+            if (model.node2 > 0) rhs[model.node2 - 1] += J[indModel];
+        }
+
+        double *x = ass.systemMNA->LU_solve(L, U, P, rhs);
+        for (unsigned int indModel = 0; indModel < numModels; indModel++) {
+            CompanionModel &model = companions[indModel];
+            double dV = (model.node1 > 0 ? x[model.node1 - 1] : 0)
+                      - (model.node2 > 0 ? x[model.node2 - 1] : 0);
+            tangentNew[indModel*numState + col] = dV;
+            tangentNew[(numModels + indModel)*numState + col] = G[indModel]*dV + J[indModel];
+        }
+        delete [] x;
+    }
+    delete [] rhs;
+    tangent.swap(tangentNew);
+}
+
+void
+Transient::getState(std::vector <double> &state) {
+    unsigned int numModels = companions.size();
+    state.resize(2*numModels);
+    for (unsigned int indModel = 0; indModel < numModels; indModel++) {
+        state[indModel]             = companions[indModel].voltage[0];
+        state[numModels + indModel] = companions[indModel].current[0];
+    }
+}
+
+void
+Transient::setState(double _t, const std::vector <double> &state, bool consistent) {
+    unsigned int numModels = companions.size();
+    assert(state.size() == 2*numModels);
+
+    t = _t;
+    timeHist[0] = _t;
+    numHist = 1;
+    historyValid = consistent;
+    for (unsigned int indModel = 0; indModel < numModels; indModel++) {
+        companions[indModel].voltage[0] = state[indModel];
+        companions[indModel].current[0] = state[numModels + indModel];
+    }
+}
+
+void
+Transient::advance(double tEnd, std::vector <double> *rows) {
+    assert(tEnd <= t2);
+
+    // The end time is a breakpoint for step.
+    double t2Saved = t2;
+    t2 = tEnd;
+    while (step()) {
+        if (rows) {
+            rows->push_back(t);
+            rows->insert(rows->end(), outputs.begin(), outputs.end());
+        }
+    }
+    t2 = t2Saved;
+}
+
+void
+Transient::run() {
+    if (pipelined && !verbose) {
+        runPipelined();
+    } else {
+        while (step());
+    }
+}
+
+void
+Transient::postProcStage(Assembly *ass, RingBuffer <TransientSample> *in,
+                         RingBuffer <TransientSample> *out) {
+    std::vector <Element> &elements = ass->elemList->elements;
+    unsigned int numValues = postProcInds.size();
+
+    while (true) {
+        TransientSample *sample = in->waitReadSlot(),
+                        *result = out->waitWriteSlot();
+        bool last = sample->last;
+        result->t    = sample->t;
+        result->last = last;
+
+        if (!last) {
+            unsigned int numSol = sample->values.size() - numValues;
+            for (unsigned int ind = 0; ind < numValues; ind++) {
+                elements[postProcInds[ind]].valueList[0] = sample->values[numSol + ind];
+            }
+            ass->postProc(&sample->values[0], postProcInds);
+            result->values.resize(probes.size());
+            computeOutputs(*ass, &sample->values[0], result->values);
+        }
+        in->pop();
+        out->push();
+        if (last) break;
+    }
+}
 
+void
+Transient::outputStage(RingBuffer <TransientSample> *in) {
+    while (true) {
+        TransientSample *sample = in->waitReadSlot();
+        bool last = sample->last;
+        if (!last) {
+            outputs = sample->values;
+            if (writer) {
+                writer->addRow(sample->t, outputs);
+            }
+        }
+        in->pop();
+        if (last) break;
+    }
+}
+
+void
+Transient::runPipelined() {
+    // The post-processing stage has its own copies of the node and element
+    // lists, since the values of the elements are modified by the main
+    // thread during the integration.
+    NodeList postNodes(*nodeList);
+    ElementList postList(elemList->elements);
+    Assembly postAss(&postNodes, &postList, false, false);
+
+    RingBuffer <TransientSample> solveRing(pipelineDepth), outputRing(pipelineDepth);
+    sampleRing = &solveRing;
+    std::thread postThread(&Transient::postProcStage, this, &postAss, &solveRing, &outputRing);
+    std::thread outThread(&Transient::outputStage, this, &outputRing);
+
+    while (step());
+
+    TransientSample *sample = solveRing.waitWriteSlot();
+    sample->last = true;
+    solveRing.push();
+    postThread.join();
+    outThread.join();
+    sampleRing = 0;
+}
+
+Transient::~Transient() {
+    delete elemList;
+    elemList = 0;
 }
 
 #ifdef TEST_TRANSIENT
 
+// The capacitance of an RC circuit, which starts from zero, is charged by a
+// DC source. Since the current of the capacitance is not known at t = 0, the
+// first step is taken with Backward Euler. The voltage after one step is
+// compared to the analytical solution and to Backward Euler and the voltage
+// at t = RC to the analytical solution.
+static void
+checkFirstStep() {
+    std::vector <std::string> lines;
+    lines.push_back("VDC 1 0 1");
+    lines.push_back("R1 2 1 10000");
+    lines.push_back("C1 0 2 1u");
+    std::vector <cirStatement> stats;
+    for (unsigned int ind = 0; ind < lines.size(); ind++) {
+        stats.push_back(cirStatement(lines[ind]));
+    }
+    Parser parser(stats);
+
+    double RC = 0.01, h = RC/100;
+    Transient tran(&parser, h, RC, 0, 0.5);
+    tran.verbose = false;
+    unsigned int indProbe = 0;
+    while (tran.probes[indProbe].name != "V(2)") {
+        indProbe++;
+    }
+
+    tran.step();
+    double exact = 1 - exp(-h/RC), euler = (h/RC)/(1 + h/RC);
+    double first = tran.outputs[indProbe];
+    std::cout << std::endl << "RC first step: " << first << " (exact " << exact << ", Backward Euler "
+              << euler << ")" << std::endl;
+    assert(fabs(first - euler) < 1e-12);
+    assert(fabs(first - exact) < exact*h/RC);
+
+    while (tran.step());
+    double last = tran.outputs[indProbe];
+    std::cout << "RC at t = RC: " << last << " (exact " << 1 - exp(-1.0) << ")" << std::endl;
+    assert(fabs(last - (1 - exp(-1.0))) < 1e-4);
+}
+
 int
 main(int argc, char **argv) {
+    checkFirstStep();
+
     std::string fileName;
+    double dt = 0.0001;
+    unsigned int method = Transient::METHOD_THETA;
 
     if (argc < 2) {
         fileName = "test2.cir";
     } else {
         fileName = argv[1];
     }
+    if (argc >= 3) {
+        dt = atof(argv[2]);
+    }
+    if (argc >= 4) {
+        method = atoi(argv[3]);
+    }
 
     cirFile cir(fileName);
     std::cout << std::endl << "Transient Analysis of linear circuit: \""
               << cir.title << "\"" << std::endl;
     Parser parser(cir.statList);
-    Transient tran(&parser, 0.0001, 1, 0, 0.5);
+    Transient tran(&parser, dt, 1, 0, 0.5, method);
+
+    // With an output file, the waveforms are written in binary form.
+    RawWriter *writer = 0;
+    if (argc >= 5) {
+        std::vector <std::string> names;
+        tran.signalNames(names);
+        writer = new RawWriter(argv[4], names);
+        tran.writer  = writer;
+        tran.verbose = false;
+    }
+
+    // With a checkpoint file, the integration is continued from an existing
+    // checkpoint and new checkpoints are written every ten seconds.
+    if (argc >= 6 && strlen(argv[5]) > 0) {
+        tran.checkpointFile = argv[5];
+        tran.checkpointInterval = 10;
+
+        FILE *file = fopen(argv[5], "rb");
+        if (file) {
+            fclose(file);
+            tran.readCheckpoint(argv[5]);
+            std::cout << "Continuing from checkpoint at t = " << tran.t << std::endl;
+        }
+    }
+    if (argc >= 7) {
+        tran.pipelined = atoi(argv[6]) != 0;
+    }
+    tran.run();
+    delete writer;
     tran.elemList->disp();
 }
 
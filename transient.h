@@ -28,33 +28,229 @@
 #include "assembly.h"
 
 #include "matrix.h"
+#include "rawWriter.h"
+#include "ringBuffer.h"
+
+#include <time.h>
 
 /* Transient object performs transient solution of a linear circuit by
- * numerical integration with theta methods. Numerical integration is
- * implemented by replacing the energy storage elements with Norton companion
- * models updated each time step.
+ * numerical integration. Numerical integration is implemented by replacing
+ * the energy storage elements with Norton companion models updated each time
+ * step.
  *
  * t1     Initial time
  * t2     End time
- * dt     Time step size
+ * dt     Maximum time step size
  * theta  Theta parameter (0 ~ Forward Euler, 0.5 ~ Trapezoidal, 1 ~ Backward
  *                         Euler)
+ * method Integration method:
+ *        METHOD_THETA   Theta method with the above theta parameter. With
+ *                       Forward Euler, capacitances use Backward Euler.
+ *                       The currents of the energy storage elements are not
+ *                       known at the initial time and may jump at the
+ *                       breakpoints, so the first step after them is taken
+ *                       with Backward Euler.
+ *        METHOD_GEAR    Variable-step, variable-order BDF (Gear) methods up
+ *                       to the order gearOrder. The order is raised from one
+ *                       as history points accumulate and reset to one at the
+ *                       breakpoints of the sources.
+ *        METHOD_TRBDF2  TR-BDF2: Trapezoidal step to t + gamma*h followed by
+ *                       a BDF2 step to t + h with gamma = 2 - sqrt(2).
+ *
+ * The time steps are shortened so that the solution lands exactly on the
+ * breakpoints of the source waveforms. Between the breakpoints, the sources
+ * are smooth and steps of length dt are taken. Since the time points do not
+ * depend on the solution, the sources are evaluated in blocks of tableBlock
+ * time points ahead of the steps.
+ *
+ * The output variables selected in the parser with .PRINT, .PLOT and .PROBE
+ * statements or, by default, the node voltages V(node) and the currents
+ * I(name) of the elements of the original circuit are written after each
+ * time step into writer, when it has been constructed with the names from
+ * signalNames. Only the branch currents needed by the output variables are
+ * post-processed. When verbose is false, nothing is printed during the time
+ * integration.
+ *
+ * When pipelined is set and verbose is false, run overlaps the steps with
+ * their output: the main thread stamps the companion models, solves the MNA
+ * equations and updates the companion models, after which the next step can
+ * start. The solution and the values of the post-processed elements are
+ * passed to a post-processing thread, which computes the output variables
+ * and passes them to an output thread writing them into writer. The stages
+ * are connected by RingBuffer objects with pipelineDepth slots.
+ *
+ * When checkpointFile is set, the full state of the integration is written
+ * into it every checkpointInterval seconds of wall-clock time. A Transient
+ * object constructed with the same circuit and parameters can continue from
+ * the checkpoint after readCheckpoint.
+ */
+
+const unsigned int maxGearOrder = 6;
+
+/* TransientSample objects are passed between the stages of the pipelined
+ * time integration. values contains either the solution vector followed by
+ * the values of the post-processed elements or the output variables at time
+ * t. The last sample terminates the stage.
+ */
+
+class TransientSample {
+public:
+    double t;
+    bool last;
+    std::vector <double> values;
+};
+
+/* CompanionModel objects contain the indices of the conductance and the
+ * current source replacing an energy storage element in the element list,
+ * the indices of its nodes and the branch voltages and currents at the latest accepted time points
+ * (index 0 is the latest). indRes is -1 when the model has no conductance.
  */
 
+class CompanionModel {
+public:
+    unsigned int elemType;
+    double value;
+    int indRes, indCur;
+    unsigned int node1, node2;
+    double voltage[maxGearOrder + 1], current[maxGearOrder + 1];
+};
+
 class Transient {
 public:
-    Transient(Parser *_parser, double _dt, double _t2, double _t1=0, double _theta=1);
+    enum{METHOD_THETA, METHOD_GEAR, METHOD_TRBDF2};
+
+    Transient(Parser *_parser, double _dt, double _t2, double _t1=0, double _theta=1,
+              unsigned int _method=METHOD_THETA);
+    // Transient solution of the circuit in the element list _elemList with
+    // the output variables _probes resolved against _nodeList and _elemList.
+    Transient(NodeList *_nodeList, ElementList *_elemList,
+              const std::vector <Probe> &_probes, double _dt, double _t2,
+              double _t1=0, double _theta=1, unsigned int _method=METHOD_THETA);
     ~Transient();
 
+    // Perform the time integration from t1 to t2.
+    void run();
+    // Advance the solution by a single time step. Returns false when the
+    // end time t2 has been reached.
+    bool step();
+    // Advance the solution to the time tEnd <= t2. If rows is given, the
+    // time and the output variables after each step are appended into it.
+    void advance(double tEnd, std::vector <double> *rows = 0);
+    // The first breakpoint of the source waveforms after time _t.
+    double nextBreakpoint(double _t);
+    void signalNames(std::vector <std::string> &names);
+    // Replace the waveform of the source with the index indElem in the
+    // original element list. Without breakpoints, the time steps are not
+    // shortened to land on the breakpoints of the waveform.
+    void setWaveform(unsigned int indElem, const Waveform &waveForm,
+                     bool breakpoints=true);
+
+    // The state of the circuit consists of the branch voltages of all energy
+    // storage elements followed by their branch currents. After setState,
+    // the integration continues from the time _t with the history of
+    // multistep methods restarted. consistent is false for states, whose
+    // currents are not obtained from a solution, e.g., the initial state,
+    // and then the first step, or the first stage of TR-BDF2, is taken with
+    // Backward Euler.
+    void getState(std::vector <double> &state);
+    void setState(double _t, const std::vector <double> &state, bool consistent=true);
+
+    // Start the propagation of the sensitivity of the state to the state at
+    // the current time. The sensitivity is propagated by solving the MNA
+    // equations of each step for the tangents of the companion models with
+    // the sources removed. Only METHOD_THETA is supported.
+    void initTangent();
+
+    void writeCheckpoint(const std::string &fileName);
+    void readCheckpoint(const std::string &fileName);
+
     double dt, t1, t2, theta;
+    double t;
+    unsigned int method, gearOrder;
+    bool verbose;
+    RawWriter *writer;
+
+    bool pipelined;
+    unsigned int pipelineDepth;
+
+    std::string checkpointFile;
+    double checkpointInterval;
+
+    // Output variables and their values at time t.
+    std::vector <Probe> probes;
+    std::vector <double> outputs;
+
+    // Solution vector of the MNA equations at time t.
+    std::vector <double> solution;
+
+    // Sensitivity of the state at time t to the state at the time of
+    // initTangent. tangent[row*numState + col], where numState is the size
+    // of the state. Empty when not propagated.
+    std::vector <double> tangent;
 
     // The element list, where energy storage elements have been replaced.
     ElementList *elemList;
 private:
-    Parser      *parser;
+    // The original circuit.
+    NodeList    *nodeList;
+    ElementList *circuit;
 
     // Indices of the elements of the companion models in the element list elemList.
     std::vector <std::vector <int> > companionInd;
+    std::vector <CompanionModel> companions;
+
+    // Sources with waveforms, the states of their evaluation and their
+    // indices in the element list elemList.
+    std::vector <unsigned int> wfSourceInds;
+    std::vector <Waveform> sourceWfs;
+    std::vector <WaveformState> sourceStates;
+    std::vector <bool> sourceBreakpoints;
+
+    // Wall-clock time of the latest checkpoint.
+    time_t checkpointTime;
+
+    // Steps shorter than hMin are not taken when approaching a breakpoint.
+    double hMin;
+
+    // Values of the sources with waveforms at the next time points.
+    // sourceTable[indSource*tableTimes.size() + indTime].
+    static const unsigned int tableBlock = 256;
+    std::vector <double> tableTimes, sourceTable;
+    unsigned int tableCursor;
+
+    // Indices of the elements in elemList needed by the output variables.
+    std::vector <unsigned int> postProcInds;
+
+    // Input of the post-processing stage during pipelined integration.
+    RingBuffer <TransientSample> *sampleRing;
+
+    // Time points of the history in the companion models and the number of
+    // points valid for multistep methods.
+    double timeHist[maxGearOrder + 1];
+    unsigned int numHist;
+    // The currents in the history of the companion models are consistent
+    // with the solution, i.e., not at the initial time or a breakpoint.
+    bool historyValid;
+
+    void init(NodeList *_nodeList, ElementList *_elemList,
+              const std::vector <Probe> &_probes, double _dt, double _t2,
+              double _t1, double _theta, unsigned int _method);
+    // Time step and theta parameter of the latest stampTheta.
+    double stampH, stampThetaParam;
+
+    double stepSize(double _t, double &tNew, bool &atBreak);
+    void fillSourceTable();
+    void stampTheta(double h, double _theta);
+    void propagateTangent(Assembly &ass);
+    void stampGear(double tNew, unsigned int order);
+    void solve(double tNew);
+    void computeOutputs(Assembly &ass, const double *sol, std::vector <double> &out);
+    void runPipelined();
+    void postProcStage(Assembly *ass, RingBuffer <TransientSample> *in,
+                       RingBuffer <TransientSample> *out);
+    void outputStage(RingBuffer <TransientSample> *in);
+    void updateCompanions(double tNew);
+    double nodeVoltage(unsigned int node);
 };
 
 #endif // TRANSIENT_H
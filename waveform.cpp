@@ -16,12 +16,21 @@
 */
 
 #include "waveform.h"
+#include "philox.h"
 #include <math.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <type_traits>
+#include <thread>
 
 Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName) {
-    strList = bracket;
-    name = bracketName;
+    std::vector<std::string> &strList = bracket;
+    std::string &name = bracketName;
+    recurrence = true;
 
     if (name == "SIN") {
         mode = WAVEFORM_SIN;
@@ -30,25 +39,25 @@ Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName)
             std::cerr << "SIN() requires at least two parameters!" << std::endl;;
             exit(-1);
         }
-        Value valV0(strList[0]); sinV0 = valV0.val;
-        Value valVA(strList[1]); sinVA = valVA.val;
+        Value valV0(strList[0]); par.sin.V0 = valV0.val;
+        Value valVA(strList[1]); par.sin.VA = valVA.val;
 
         if (strList.size() >= 3) {
-            Value valFREQ(strList[2]); sinFREQ = valFREQ.val;
-            sinFREQset = true;
+            Value valFREQ(strList[2]); par.sin.FREQ = valFREQ.val;
+            par.sin.FREQset = true;
         } else {
-            sinFREQ    = 0;
-            sinFREQset = false;
+            par.sin.FREQ    = 0;
+            par.sin.FREQset = false;
         }
         if (strList.size() >= 4) {
-            Value valTD(strList[3]); sinTD = valTD.val;
+            Value valTD(strList[3]); par.sin.TD = valTD.val;
         } else {
-            sinTD = 0;
+            par.sin.TD = 0;
         }
         if (strList.size() >= 5) {
-            Value valTHETA(strList[4]); sinTHETA = valTHETA.val;
+            Value valTHETA(strList[4]); par.sin.THETA = valTHETA.val;
         } else {
-            sinTHETA = 0;
+            par.sin.THETA = 0;
         }
     } else if (name == "EXP") {
         mode = WAVEFORM_EXP;
@@ -57,32 +66,53 @@ Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName)
             std::cerr << "EXP() requires at least two parameters!" << std::endl;;
             exit(-1);
         }
-        Value valV1(strList[0]); expV1 = valV1.val;
-        Value valV2(strList[1]); expV2 = valV2.val;
+        Value valV1(strList[0]); par.exp.V1 = valV1.val;
+        Value valV2(strList[1]); par.exp.V2 = valV2.val;
 
         if (strList.size() >= 3) {
-            Value valTD1(strList[2]); expTD1 = valTD1.val;
+            Value valTD1(strList[2]); par.exp.TD1 = valTD1.val;
         } else {
-            expTD1 = 0;
+            par.exp.TD1 = 0;
         }
         if (strList.size() >= 4) {
-            Value valTAU1(strList[3]); expTAU1 = valTAU1.val;
-            expTAU1set = true;
+            Value valTAU1(strList[3]); par.exp.TAU1 = valTAU1.val;
+            par.exp.TAU1set = true;
         } else {
-            expTAU1set = false;
+            par.exp.TAU1set = false;
         }
         if (strList.size() >= 5) {
-            Value valTD2(strList[4]); expTD2 = valTD2.val;
-            expTD2set = true;
+            Value valTD2(strList[4]); par.exp.TD2 = valTD2.val;
+            par.exp.TD2set = true;
         } else {
-            expTD2set = false;
+            par.exp.TD2set = false;
         }
         if (strList.size() >= 6) {
-            Value valTAU2(strList[4]); expTAU2 = valTAU2.val;
-            expTAU2set = true;
+            Value valTAU2(strList[4]); par.exp.TAU2 = valTAU2.val;
+            par.exp.TAU2set = true;
         } else {
-            expTAU2set = false;
+            par.exp.TAU2set = false;
         }
+    } else if (name == "PWL" && strList.size() > 0 && strList[0].compare(0, 4, "FILE") == 0) {
+        // PWL(FILE="name"). Without quotes, the name is in upper case.
+        mode = WAVEFORM_PWL;
+
+        std::string strFile;
+        for (unsigned int indStr = 0; indStr < strList.size(); indStr++) {
+            strFile += strList[indStr];
+        }
+        if (strFile.compare(0, 5, "FILE=") != 0 || strFile.length() == 5) {
+            std::cerr << "PWL(FILE=name) requires a file name!" << std::endl;
+            exit(-1);
+        }
+        std::string fileName = strFile.substr(5);
+        if (fileName.length() >= 2 && fileName[0] == '"' && fileName[fileName.length() - 1] == '"') {
+            fileName = fileName.substr(1, fileName.length() - 2);
+        }
+        std::lock_guard <std::mutex> lock(storeMutex);
+        PWLfileStore.push_back(PWLFile());
+        PWLfileStore.back().open(fileName);
+        par.pwl.knots = 0;
+        par.pwl.file  = &PWLfileStore.back();
     } else if (name == "PWL") {
         mode = WAVEFORM_PWL;
 
@@ -91,6 +121,8 @@ Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName)
             exit(-1);
         }
 
+        PWLKnots knots;
+        std::vector<double> &PWLtime = knots.time, &PWLampl = knots.ampl;
         PWLtime.reserve(strList.size()/2);
         PWLampl.reserve(strList.size()/2);
         double t0;
@@ -111,6 +143,11 @@ Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName)
                 PWLampl.push_back(val.val);
             }
         }
+
+        std::lock_guard <std::mutex> lock(storeMutex);
+        PWLknotStore.push_back(std::move(knots));
+        par.pwl.knots = &PWLknotStore.back();
+        par.pwl.file  = 0;
     } else if (name == "SFFM") {
         mode = WAVEFORM_SFFM;
 
@@ -118,11 +155,11 @@ Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName)
             std::cerr << "SFFM() requires five parameters!" << std::endl;;
             exit(-1);
         }
-        Value valVO(strList[0]);  SFFMVO  = valVO.val;
-        Value valVA(strList[1]);  SFFMVA  = valVA.val;
-        Value valFC(strList[2]);  SFFMFC  = valFC.val;
-        Value valMDI(strList[3]); SFFMMDI = valMDI.val;
-        Value valMFS(strList[4]); SFFMFS  = valMFS.val;
+        Value valVO(strList[0]);  par.sffm.VO  = valVO.val;
+        Value valVA(strList[1]);  par.sffm.VA  = valVA.val;
+        Value valFC(strList[2]);  par.sffm.FC  = valFC.val;
+        Value valMDI(strList[3]); par.sffm.MDI = valMDI.val;
+        Value valMFS(strList[4]); par.sffm.FS  = valMFS.val;
     } else if (name == "AM") {
         mode = WAVEFORM_AM;
 
@@ -130,51 +167,92 @@ Waveform::Waveform(std::vector<std::string> &bracket, std::string &bracketName)
             std::cerr << "AM() requires five parameters!" << std::endl;;
             exit(-1);
         }
-        Value valVA(strList[0]); AMVA = valVA.val;
-        Value valVO(strList[1]); AMVO = valVO.val;
-        Value valMF(strList[2]); AMMF = valMF.val;
-        Value valFC(strList[3]); AMFC = valFC.val;
-        Value valTD(strList[4]); AMTD = valTD.val;
+        Value valVA(strList[0]); par.am.VA = valVA.val;
+        Value valVO(strList[1]); par.am.VO = valVO.val;
+        Value valMF(strList[2]); par.am.MF = valMF.val;
+        Value valFC(strList[3]); par.am.FC = valFC.val;
+        Value valTD(strList[4]); par.am.TD = valTD.val;
     } else if (name == "PULSE") {
         mode = WAVEFORM_PULSE;
         if (strList.size() < 2) {
             std::cerr << "PULSE() requires at least two parameters!" << std::endl;;
             exit(-1);
         }
-        Value valV1(strList[0]); pulseV1 = valV1.val;
-        Value valV2(strList[1]); pulseV2 = valV2.val;
+        Value valV1(strList[0]); par.pulse.V1 = valV1.val;
+        Value valV2(strList[1]); par.pulse.V2 = valV2.val;
 
         if (strList.size() >= 3) {
-            Value valTD(strList[2]); pulseTD = valTD.val;
+            Value valTD(strList[2]); par.pulse.TD = valTD.val;
         } else {
-            pulseTD    = 0;
+            par.pulse.TD    = 0;
         }
         if (strList.size() >= 4) {
-            Value valTR(strList[3]); pulseTR = valTR.val;
-            pulseTRset = true;
+            Value valTR(strList[3]); par.pulse.TR = valTR.val;
+            par.pulse.TRset = true;
         } else {
-            pulseTRset = false;
+            par.pulse.TRset = false;
         }
         if (strList.size() >= 5) {
-            Value valTF(strList[4]); pulseTF = valTF.val;
-            pulseTFset = true;
+            Value valTF(strList[4]); par.pulse.TF = valTF.val;
+            par.pulse.TFset = true;
         } else {
-            pulseTFset = false;
+            par.pulse.TFset = false;
         }
         if (strList.size() >= 6) {
-            Value valPW(strList[5]); pulsePW = valPW.val;
-            pulsePWset = true;
+            Value valPW(strList[5]); par.pulse.PW = valPW.val;
+            par.pulse.PWset = true;
         } else {
-            pulsePWset = false;
+            par.pulse.PWset = false;
         }
         if (strList.size() >= 7) {
-            Value valPER(strList[6]); pulsePER = valPER.val;
-            pulsePERset = true;
+            Value valPER(strList[6]); par.pulse.PER = valPER.val;
+            par.pulse.PERset = true;
         } else {
-            pulsePERset = false;
+            par.pulse.PERset = false;
         }
     } else if (name == "NOISE") {
         mode = WAVEFORM_NOISE;
+        recurrence = false;
+
+        if (strList.size() < 2 || strList.size() > 7) {
+            std::cerr << "NOISE() requires two to seven parameters!" << std::endl;
+            exit(-1);
+        }
+        double params[7] = {0, 0, 0, 0, 0, 0, 0};
+        for (unsigned int indVal = 0; indVal < strList.size(); indVal++) {
+            Value val(strList[indVal]);
+            params[indVal] = val.val;
+        }
+        par.noise.NA      = params[0];
+        par.noise.NT      = params[1];
+        par.noise.NALPHA  = params[2];
+        par.noise.NAMP    = params[3];
+        par.noise.RTSAM   = params[4];
+        par.noise.RTSCAPT = params[5];
+        par.noise.RTSEMT  = params[6];
+        par.noise.NTset   = par.noise.NT > 0;
+
+        if (par.noise.NALPHA < 0 || par.noise.NALPHA > 2) {
+            std::cerr << "NALPHA of NOISE() must be between 0 and 2!" << std::endl;
+            exit(-1);
+        }
+        if (par.noise.RTSAM != 0 && (par.noise.RTSCAPT <= 0 || par.noise.RTSEMT <= 0)) {
+            std::cerr << "RTS noise requires positive capture and emission times!" << std::endl;
+            exit(-1);
+        }
+
+        // The variance of the octave j is proportional to 2^(j*(NALPHA-1))
+        // so that the spectrum of the sum is proportional to 1/f^NALPHA.
+        par.noise.pinkRatio = pow(2.0, 0.5*(par.noise.NALPHA - 1));
+        double sumSquares = 0, weight = 1;
+        for (unsigned int octave = 0; octave < numPinkOctaves; octave++) {
+            sumSquares += weight*weight;
+            weight *= par.noise.pinkRatio;
+        }
+        par.noise.pinkScale = par.noise.NAMP / sqrt(sumSquares);
+
+        par.noise.seed     = noiseSeed;
+        par.noise.sourceId = 0;
     } else {
         std::cerr << "Unknown Waveform : " << name << std::endl;
         exit(-1);
@@ -185,125 +263,787 @@ void
 Waveform::setTransientParameters(double timestep, double t1, double t2) {
     switch(mode) {
     case WAVEFORM_SIN:
-        if (!sinFREQset) {
-            sinFREQ = 1/t2;
-            sinFREQset = true;
+        if (!par.sin.FREQset) {
+            par.sin.FREQ = 1/t2;
+            par.sin.FREQset = true;
         }
         break;
     case WAVEFORM_EXP:
-        if (!expTAU1set) {
-            expTAU1 = timestep;
-            expTAU1set = true;
+        if (!par.exp.TAU1set) {
+            par.exp.TAU1 = timestep;
+            par.exp.TAU1set = true;
         }
-        if (!expTD2set) {
-            expTD2 = expTD1 + timestep;
-            expTD2set = true;
+        if (!par.exp.TD2set) {
+            par.exp.TD2 = par.exp.TD1 + timestep;
+            par.exp.TD2set = true;
         }
-        if (!expTAU2set) {
-            expTAU2 = timestep;
-            expTAU2set = true;
+        if (!par.exp.TAU2set) {
+            par.exp.TAU2 = timestep;
+            par.exp.TAU2set = true;
         }
         break;
     case WAVEFORM_PULSE:
-        if (!pulseTRset) {
-            pulseTR = timestep;
-            pulseTRset = true;
+        if (!par.pulse.TRset) {
+            par.pulse.TR = timestep;
+            par.pulse.TRset = true;
         }
-        if (!pulseTFset) {
-            pulseTF = timestep;
-            pulseTFset = true;
+        if (!par.pulse.TFset) {
+            par.pulse.TF = timestep;
+            par.pulse.TFset = true;
         }
-        if (!pulsePWset) {
-            pulsePW = t2;
-            pulsePWset = true;
+        if (!par.pulse.PWset) {
+            par.pulse.PW = t2;
+            par.pulse.PWset = true;
         }
-        if (!pulsePERset) {
-            pulsePER = t2;
-            pulsePERset = true;
+        if (!par.pulse.PERset) {
+            par.pulse.PER = t2;
+            par.pulse.PERset = true;
+        }
+        break;
+    case WAVEFORM_NOISE:
+        if (!par.noise.NTset) {
+            par.noise.NT = timestep;
+            par.noise.NTset = true;
         }
         break;
     }
 }
+// The solvers copy the waveforms of the sources as raw memory.
+static_assert(std::is_trivially_copyable<Waveform>::value,
+              "Waveform must be trivially copyable");
+static_assert(sizeof(Waveform) <= 96, "Waveform must be small");
+
+uint32_t Waveform::noiseSeed = 1;
+std::deque <PWLKnots> Waveform::PWLknotStore;
+std::deque <PWLFile> Waveform::PWLfileStore;
+std::mutex Waveform::storeMutex;
+
+const Waveform::EvalFunction Waveform::evalTable[WAVEFORM_NUM_MODES] = {
+    &Waveform::evalSin,
+    &Waveform::evalExp,
+    &Waveform::evalPWL,
+    &Waveform::evalSFFM,
+    &Waveform::evalAM,
+    &Waveform::evalPulse,
+    &Waveform::evalNoise
+};
+
 double
-Waveform::eval(double t) {
-    switch (mode) {
-    case WAVEFORM_SIN:
-        std::cout << "SIN " << sinV0 << " " << sinVA << " " << sinFREQ << " " << sinTD << std::endl;
-        if (t >= 0 && t < sinTD) {
-            return sinV0;
-        } else if (t >= sinTD) {
-            return sinV0 + sinVA * exp(-(t - sinTD)*sinTHETA)
-                                 * sin(2*M_PI*sinFREQ*(t-sinTD));
+Waveform::evalSin(double t, WaveformState &state) const {
+    if (recurrence) {
+        double value;
+        evalRecurrence(&t, &value, 1, state);
+        return value;
+    }
+    if (t >= 0 && t < par.sin.TD) {
+        return par.sin.V0;
+    } else if (t >= par.sin.TD) {
+        return par.sin.V0 + par.sin.VA * exp(-(t - par.sin.TD)*par.sin.THETA)
+                                       * sin(2*M_PI*par.sin.FREQ*(t-par.sin.TD));
+    } else {
+        return 0;
+    }
+}
+
+double
+Waveform::evalExp(double t, WaveformState &) const {
+    if (t >= 0 && t < par.exp.TD1) {
+        return par.exp.V1;
+    } else if (t >= par.exp.TD1 && t < par.exp.TD2) {
+        return par.exp.V1 + (par.exp.V2 - par.exp.V1)*(1-exp(-(t- par.exp.TD1)/par.exp.TAU1));
+    } else if (t >= par.exp.TD2) {
+        return par.exp.V1 + (par.exp.V2 - par.exp.V1)*(1-exp(-(t- par.exp.TD1)/par.exp.TAU1))
+                          + (par.exp.V1 - par.exp.V2)*(1-exp(-(t- par.exp.TD2)/par.exp.TAU2));
+    } else {
+        return 0;
+    }
+}
+
+double
+Waveform::evalPWL(double t, WaveformState &state) const {
+    if (par.pwl.file) {
+        return stateFile(state).eval(t);
+    }
+    const std::vector<double> &PWLtime = par.pwl.knots->time, &PWLampl = par.pwl.knots->ampl;
+    if (PWLtime.size() < 2 || t < PWLtime[0] || t >= PWLtime.back()) {
+        return 0;
+    }
+    unsigned int knot = PWLsegment(t, state);
+    double timeCur = PWLtime[knot],
+           timeNext= PWLtime[knot+1],
+           amplCur = PWLampl[knot],
+           amplNext= PWLampl[knot+1];
+    return amplCur + (amplNext-amplCur)*(t - timeCur)/(timeNext - timeCur);
+}
+
+double
+Waveform::evalPulse(double t, WaveformState &) const {
+    double tmod = fmod(t, par.pulse.PER);
+
+    double t1 = par.pulse.TD,
+           t2 = par.pulse.TD + par.pulse.TR,
+           t3 = par.pulse.TD + par.pulse.TR + par.pulse.PW,
+           t4 = par.pulse.TD + par.pulse.TR + par.pulse.PW + par.pulse.TF;
+
+    if (tmod >= 0 && tmod < t1) {
+        return par.pulse.V1;
+    } else if (tmod >= t1 && tmod < t2) {
+        if (t1 != t2) {
+            return par.pulse.V1 + (par.pulse.V2 - par.pulse.V1) * (tmod - t1)/(t2 - t1);
+        } else {
+            return par.pulse.V1;
+        }
+    } else if (tmod >= t2 && tmod < t3) {
+        return par.pulse.V2;
+    } else if (tmod >= t3 && tmod < t4) {
+        if (t3 != t4) {
+            return par.pulse.V2 - (par.pulse.V2 - par.pulse.V1) * (tmod - t3)/(t4 - t3);
         } else {
-            return 0;
+            return par.pulse.V2;
+        }
+    } else {
+        return par.pulse.V1;
+    }
+}
+
+double
+Waveform::evalSFFM(double t, WaveformState &state) const {
+    if (recurrence) {
+        double value;
+        evalRecurrence(&t, &value, 1, state);
+        return value;
+    }
+    return par.sffm.VO + par.sffm.VA * sin(2*M_PI*par.sffm.FC*t + par.sffm.MDI * sin(2*M_PI*par.sffm.FS*t));
+}
+
+double
+Waveform::evalAM(double t, WaveformState &state) const {
+    if (recurrence) {
+        double value;
+        evalRecurrence(&t, &value, 1, state);
+        return value;
+    }
+    return par.am.VA * (par.am.VO + sin(2*M_PI*par.am.MF*t))*sin(2*M_PI*par.am.FC*t);
+}
+
+double
+Waveform::evalNoise(double t, WaveformState &state) const {
+    if (t < 0) {
+        return 0;
+    }
+    double value = 0;
+    if ((par.noise.NA != 0 || par.noise.NAMP != 0) && par.noise.NT > 0) {
+        // Linear interpolation between the samples.
+        double pos = t / par.noise.NT;
+        uint64_t k = (uint64_t) pos;
+        if (!state.sampleValid || k != state.sampleIndex) {
+            if (state.sampleValid && k == state.sampleIndex + 1) {
+                state.sampleCur = state.sampleNext;
+            } else {
+                state.sampleCur = noiseSample(k);
+            }
+            state.sampleNext  = noiseSample(k + 1);
+            state.sampleIndex = k;
+            state.sampleValid = true;
         }
+        double frac = pos - k;
+        value = state.sampleCur + frac*(state.sampleNext - state.sampleCur);
+    }
+    if (par.noise.RTSAM != 0) {
+        value += par.noise.RTSAM * RTSstate(t, state.RTSeval);
+    }
+    return value;
+}
+
+double
+Waveform::noiseSample(uint64_t k) const {
+    // Stream 0 is the white noise and streams 1...numPinkOctaves the octaves
+    // of the 1/f noise. As in the Voss-McCartney algorithm, the octave j is
+    // constant over blocks of 2^j samples. The blocks of different octaves
+    // are offset so that the octaves do not all change at the same sample.
+    Philox rng(par.noise.seed, par.noise.sourceId);
+
+    double value = 0;
+    if (par.noise.NA != 0) {
+        value = par.noise.NA * rng.gaussian(k, 0);
+    }
+    if (par.noise.NAMP != 0) {
+        double weight = par.noise.pinkScale;
+        for (unsigned int octave = 0; octave < numPinkOctaves; octave++) {
+            uint64_t offset = 0;
+            if (octave > 0) {
+                offset = (0x9E3779B97F4A7C15ULL * octave) >> (64 - octave);
+            }
+            value += weight * rng.gaussian((k + offset) >> octave, 1 + octave);
+            weight *= par.noise.pinkRatio;
+        }
+    }
+    return value;
+}
+
+unsigned int
+Waveform::RTSstate(double t, RTSCursor &cursor) const {
+    // The lengths of the dwell intervals are exponentially distributed and
+    // the length of the interval m is obtained from the counter m of stream
+    // numPinkOctaves + 1. The even intervals, starting from t = 0, are spent
+    // in state 0 (mean RTSCAPT) and the odd intervals in state 1 (mean
+    // RTSEMT). The intervals are summed in order, which gives identical times
+    // for all copies and cursors, and the cursor makes forward stepping O(1).
+    // Only evaluation backward in time restarts the sum from t = 0.
+    Philox rng(par.noise.seed, par.noise.sourceId);
+    const uint32_t stream = numPinkOctaves + 1;
+
+    if (cursor.end == 0 || t < cursor.start) {
+        cursor.event = 0;
+        cursor.start = 0;
+        cursor.end   = -par.noise.RTSCAPT * log(rng.uniform(0, stream));
+    }
+    while (t >= cursor.end) {
+        cursor.event++;
+        double mean = (cursor.event % 2 == 0) ? par.noise.RTSCAPT : par.noise.RTSEMT;
+        cursor.start = cursor.end;
+        cursor.end  += -mean * log(rng.uniform(cursor.event, stream));
+    }
+    return cursor.event % 2;
+}
+
+void
+Waveform::setSourceName(const std::string &sourceName) {
+    if (mode != WAVEFORM_NOISE) {
+        return;
+    }
+    // FNV-1a hash of the name.
+    uint32_t hash = 2166136261u;
+    for (unsigned int indChar = 0; indChar < sourceName.length(); indChar++) {
+        hash ^= (unsigned char) sourceName[indChar];
+        hash *= 16777619u;
+    }
+    par.noise.sourceId = hash;
+}
+
+void
+Oscillator::start(double _omega, double phase, double h) {
+    omega = _omega;
+    c     = cos(phase);
+    s     = sin(phase);
+    cStep = cos(omega*h);
+    sStep = sin(omega*h);
+    count = 0;
+}
+
+void
+Oscillator::advance() {
+    double cNew = c*cStep - s*sStep;
+    s = s*cStep + c*sStep;
+    c = cNew;
+    if (++count % renormInterval == 0) {
+        // First-order Newton step towards c^2 + s^2 = 1.
+        double scale = 1.5 - 0.5*(c*c + s*s);
+        c *= scale;
+        s *= scale;
+    }
+}
+
+void
+Waveform::startRecurrence(double t, double h, WaveformState &state) const {
+    state.oscAnchor = t;
+    state.oscStep   = h;
+    state.oscCount  = 0;
+    state.oscValid  = h > 0;
+    switch (mode) {
+    case WAVEFORM_SIN: {
+        double tau = t - par.sin.TD;
+        state.osc1.start(2*M_PI*par.sin.FREQ, 2*M_PI*par.sin.FREQ*tau, h);
+        state.oscDecay     = exp(-tau*par.sin.THETA);
+        state.oscDecayStep = exp(-h*par.sin.THETA);
+      } break;
+    case WAVEFORM_SFFM:
+        state.osc2.start(2*M_PI*par.sffm.FS, 2*M_PI*par.sffm.FS*t, h);
         break;
-    case WAVEFORM_EXP:
-        if (t >= 0 && t < expTD1) {
-            return expV1;
-        } else if (t >= expTD1 && t < expTD2) {
-            return expV1 + (expV2 - expV1)*(1-exp(-(t- expTD1)/expTAU1));
-        } else if (t >= expTD2) {
-            return expV1 + (expV2 - expV1)*(1-exp(-(t- expTD1)/expTAU1))
-                         + (expV1 - expV2)*(1-exp(-(t- expTD2)/expTAU2));
+    case WAVEFORM_AM:
+        state.osc1.start(2*M_PI*par.am.FC, 2*M_PI*par.am.FC*t, h);
+        state.osc2.start(2*M_PI*par.am.MF, 2*M_PI*par.am.MF*t, h);
+        break;
+    }
+}
+
+// Sine and exponential of the arrays x into the arrays y, which must not
+// overlap, for the block evaluation. The loops contain no branches or calls
+// so that the compiler can vectorize them. The argument is reduced with
+// integer operations on the bits of the doubles: adding roundShift rounds
+// the quotient to an integer in the low bits of the mantissa. The functions
+// are then evaluated with polynomials with errors of a few ulp.
+//
+// The argument of sin is reduced by multiples of pi/2 split into parts of
+// 26 bits so that the products with the quotient are exact up to
+// |x| = sinReduceMax. Larger arguments are evaluated again in a second loop
+// with the sin of the math library. The exponent of exp is clamped to
+// [-708, 709], where the result is a normal number.
+
+static const double roundShift = 6755399441055744.0;
+static const uint64_t roundBits = 0x4338000000000000ULL;
+static const double sinReduceMax = 6.7e7;
+static const unsigned int kernelChunk = 256;
+
+static void
+blockSin(const double *x, double *y, unsigned int n) {
+    const double twoOverPi = 0.6366197723675814,
+                 pio2_1 = 1.5707963407039642,
+                 pio2_2 = -1.3909067675399456e-08,
+                 pio2_3 = 6.123233932053594e-17,
+                 pio2_4 = 6.36831716351095e-25;
+    // Coefficients of sin and cos on [-pi/4, pi/4] from fdlibm.
+    const double S1 = -1.66666666666666324348e-01, S2 =  8.33333333332248946124e-03,
+                 S3 = -1.98412698298579493134e-04, S4 =  2.75573137070700676789e-06,
+                 S5 = -2.50507602534068634195e-08, S6 =  1.58969099521155010221e-10,
+                 C1 =  4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03,
+                 C3 =  2.48015872894767294178e-05, C4 = -2.75573143513906633035e-07,
+                 C5 =  2.08757232129817482790e-09, C6 = -1.13596475577881948265e-11;
+
+    for (unsigned int ind = 0; ind < n; ind++) {
+        double xi = x[ind];
+        double qd = xi*twoOverPi + roundShift;
+        uint64_t q;
+        memcpy(&q, &qd, sizeof(q));
+        qd -= roundShift;
+        double r = (((xi - qd*pio2_1) - qd*pio2_2) - qd*pio2_3) - qd*pio2_4;
+
+        double z = r*r;
+        double s = r + r*z*(S1 + z*(S2 + z*(S3 + z*(S4 + z*(S5 + z*S6))))),
+               c = 1 - 0.5*z + z*z*(C1 + z*(C2 + z*(C3 + z*(C4 + z*(C5 + z*C6)))));
+
+        // The quadrant q selects between sin and cos of r and the sign.
+        uint64_t sBits, cBits;
+        memcpy(&sBits, &s, sizeof(s));
+        memcpy(&cBits, &c, sizeof(c));
+        uint64_t swap = 0 - (q & 1);
+        uint64_t bits = ((sBits & ~swap) | (cBits & swap)) ^ ((q & 2) << 62);
+        memcpy(&y[ind], &bits, sizeof(bits));
+    }
+    for (unsigned int ind = 0; ind < n; ind++) {
+        if (!(fabs(x[ind]) <= sinReduceMax)) {
+            y[ind] = sin(x[ind]);
+        }
+    }
+}
+
+static void
+blockExp(const double *x, double *y, unsigned int n) {
+    const double invLn2 = 1.4426950408889634,
+                 ln2_1  = 0.6931471806019545,
+                 ln2_2  = -4.2009150726810846e-11;
+    // The exponent is clamped in a separate loop, which would otherwise
+    // not be vectorized.
+    for (unsigned int ind = 0; ind < n; ind++) {
+        double xi = (x[ind] < -708) ? -708 : x[ind];
+        y[ind] = (xi > 709) ? 709 : xi;
+    }
+    for (unsigned int ind = 0; ind < n; ind++) {
+        double xi = y[ind];
+        double kd = xi*invLn2 + roundShift;
+        uint64_t k;
+        memcpy(&k, &kd, sizeof(k));
+        kd -= roundShift;
+        double r = (xi - kd*ln2_1) - kd*ln2_2;
+
+        // Taylor polynomial of exp(r) for |r| <= ln(2)/2 multiplied by 2^k.
+        double p = 1 + r*(1 + r*(0.5 + r*(0.16666666666666666 + r*(0.041666666666666664
+                 + r*(0.008333333333333333 + r*(0.001388888888888889 + r*(0.0001984126984126984
+                 + r*(2.48015873015873e-05 + r*(2.7557319223985893e-06 + r*(2.755731922398589e-07
+                 + r*(2.505210838544172e-08 + r*(2.08767569878681e-09
+                 + r*1.6059043836821613e-10))))))))))));
+        uint64_t scaleBits = (k - roundBits + 1023) << 52;
+        double scale;
+        memcpy(&scale, &scaleBits, sizeof(scale));
+        y[ind] = p*scale;
+    }
+}
+
+void
+Waveform::evalRecurrence(const double *times, double *values, unsigned int numTimes,
+                         WaveformState &state) const {
+    Oscillator &osc1 = state.osc1, &osc2 = state.osc2;
+    for (unsigned int ind = 0; ind < numTimes; ind++) {
+        double t = times[ind];
+        if (mode == WAVEFORM_SIN && t < par.sin.TD) {
+            values[ind] = (t >= 0) ? par.sin.V0 : 0;
+            state.oscValid = false;
+            state.oscPrev  = t;
+            continue;
+        }
+
+        // The oscillators are advanced, when t is the next time point with
+        // the same spacing up to rounding errors. The small difference delta
+        // is corrected to first order.
+        double delta = t - (state.oscAnchor + (state.oscCount + 1)*state.oscStep);
+        if (state.oscValid && state.oscCount + 1 < anchorInterval
+            && fabs(delta) <= 1e-7*state.oscStep) {
+            state.oscCount++;
+            switch (mode) {
+            case WAVEFORM_SIN:
+                osc1.advance();
+                state.oscDecay *= state.oscDecayStep;
+                break;
+            case WAVEFORM_SFFM:
+                osc2.advance();
+                break;
+            case WAVEFORM_AM:
+                osc1.advance();
+                osc2.advance();
+                break;
+            }
         } else {
-            return 0;
+            // The spacing is taken from the next time point or, for single
+            // evaluations, from the previous one.
+            double h = 0;
+            if (ind + 1 < numTimes) {
+                h = times[ind + 1] - t;
+            } else if (t > state.oscPrev) {
+                h = t - state.oscPrev;
+            }
+            startRecurrence(t, h, state);
+            delta = 0;
         }
+        state.oscPrev = t;
+
+        switch (mode) {
+        case WAVEFORM_SIN: {
+            double s = osc1.s + osc1.omega*delta*osc1.c;
+            values[ind] = par.sin.V0 + par.sin.VA*state.oscDecay*(1 - par.sin.THETA*delta)*s;
+          } break;
+        case WAVEFORM_SFFM: {
+            // The phase of the carrier, whose sine is computed below.
+            double sMod = osc2.s + osc2.omega*delta*osc2.c;
+            values[ind] = 2*M_PI*par.sffm.FC*t + par.sffm.MDI*sMod;
+          } break;
+        case WAVEFORM_AM: {
+            double sCar = osc1.s + osc1.omega*delta*osc1.c,
+                   sMod = osc2.s + osc2.omega*delta*osc2.c;
+            values[ind] = par.am.VA*(par.am.VO + sMod)*sCar;
+          } break;
+        }
+    }
+
+    if (mode == WAVEFORM_SFFM) {
+        double phase[kernelChunk];
+        for (unsigned int start = 0; start < numTimes; start += kernelChunk) {
+            unsigned int num = std::min(numTimes - start, kernelChunk);
+            std::copy(values + start, values + start + num, phase);
+            blockSin(phase, values + start, num);
+            for (unsigned int ind = start; ind < start + num; ind++) {
+                values[ind] = par.sffm.VO + par.sffm.VA*values[ind];
+            }
+        }
+    }
+}
+
+void
+Waveform::evalBlock(const double *times, double *values, unsigned int numTimes,
+                    WaveformState &state) const {
+    if (recurrence && (mode == WAVEFORM_SIN || mode == WAVEFORM_SFFM || mode == WAVEFORM_AM)) {
+        evalRecurrence(times, values, numTimes, state);
+        return;
+    }
 
+    // The loops contain no calls and select the branches of eval with
+    // conditional expressions so that they can be vectorized by the
+    // compiler. Sines and exponentials are evaluated with blockSin and
+    // blockExp in chunks of kernelChunk time points.
+    double arg1[kernelChunk], arg2[kernelChunk], res1[kernelChunk], res2[kernelChunk];
+    switch (mode) {
+    case WAVEFORM_SIN: {
+        double omega = 2*M_PI*par.sin.FREQ;
+        for (unsigned int start = 0; start < numTimes; start += kernelChunk) {
+            unsigned int num = std::min(numTimes - start, kernelChunk);
+            const double *t = times + start;
+            for (unsigned int ind = 0; ind < num; ind++) {
+                double tau = t[ind] - par.sin.TD;
+                arg1[ind] = -tau*par.sin.THETA;
+                arg2[ind] = omega*tau;
+            }
+            blockExp(arg1, res1, num);
+            blockSin(arg2, res2, num);
+            for (unsigned int ind = 0; ind < num; ind++) {
+                double tau = t[ind] - par.sin.TD;
+                double val = par.sin.V0 + par.sin.VA*res1[ind]*res2[ind];
+                values[start + ind] = (tau >= 0) ? val : ((t[ind] >= 0) ? par.sin.V0 : 0);
+            }
+        }
+      } break;
+    case WAVEFORM_EXP:
+        for (unsigned int start = 0; start < numTimes; start += kernelChunk) {
+            unsigned int num = std::min(numTimes - start, kernelChunk);
+            const double *t = times + start;
+            for (unsigned int ind = 0; ind < num; ind++) {
+                arg1[ind] = -(t[ind] - par.exp.TD1)/par.exp.TAU1;
+                arg2[ind] = -(t[ind] - par.exp.TD2)/par.exp.TAU2;
+            }
+            blockExp(arg1, res1, num);
+            blockExp(arg2, res2, num);
+            for (unsigned int ind = 0; ind < num; ind++) {
+                double rise = (par.exp.V2 - par.exp.V1)*(1 - res1[ind]),
+                       fall = (par.exp.V1 - par.exp.V2)*(1 - res2[ind]);
+                double val = par.exp.V1;
+                val += (t[ind] >= par.exp.TD1) ? rise : 0;
+                val += (t[ind] >= par.exp.TD2) ? fall : 0;
+                values[start + ind] = (t[ind] >= 0) ? val : 0;
+            }
+        }
         break;
     case WAVEFORM_PWL: {
-        for (unsigned int indPWL = 0; indPWL < PWLampl.size()-1; indPWL++) {
-            double timeCur = PWLtime[indPWL],
-                   timeNext= PWLtime[indPWL+1],
-                   amplCur = PWLampl[indPWL],
-                   amplNext= PWLampl[indPWL+1];
-            if (t >= timeCur && t < timeNext) {
-                return amplCur + (amplNext-amplCur)*(t - timeCur)/(timeNext - timeCur);
+        if (par.pwl.file) {
+            PWLFile &file = stateFile(state);
+            for (unsigned int ind = 0; ind < numTimes; ind++) {
+                values[ind] = file.eval(times[ind]);
             }
+            break;
         }
-        return 0;
-      }  break;
-    case WAVEFORM_PULSE: {
-        double tmod = fmod(t, pulsePER);
-
-        double t1 = pulseTD,
-               t2 = pulseTD + pulseTR,
-               t3 = pulseTD + pulseTR + pulsePW,
-               t4 = pulseTD + pulseTR + pulsePW + pulseTF;
-
-        if (tmod >= 0 && tmod < t1) {
-            return pulseV1;
-        } else if (tmod >= t1 && tmod < t2) {
-            if (t1 != t2) {
-                return pulseV1 + (pulseV2 - pulseV1) * (tmod - t1)/(t2 - t1);
+        const std::vector<double> &PWLtime = par.pwl.knots->time, &PWLampl = par.pwl.knots->ampl;
+        unsigned int numKnots = PWLtime.size();
+        for (unsigned int ind = 0; ind < numTimes; ind++) {
+            double t = times[ind];
+            if (numKnots >= 2 && t >= PWLtime[0] && t < PWLtime[numKnots - 1]) {
+                unsigned int knot = PWLsegment(t, state);
+                double timeCur = PWLtime[knot], timeNext = PWLtime[knot + 1];
+                values[ind] = PWLampl[knot] + (PWLampl[knot + 1] - PWLampl[knot])
+                                            * (t - timeCur)/(timeNext - timeCur);
             } else {
-                return pulseV1;
+                values[ind] = 0;
             }
-        } else if (tmod >= t2 && tmod < t3) {
-            return pulseV2;
-        } else if (tmod >= t3 && tmod < t4) {
-            if (t3 != t4) {
-                return pulseV2 - (pulseV2 - pulseV1) * (tmod - t3)/(t4 - t3);
-            } else {
-                return pulseV2;
+        }
+      } break;
+    case WAVEFORM_PULSE: {
+        double t1 = par.pulse.TD,
+               t2 = par.pulse.TD + par.pulse.TR,
+               t3 = par.pulse.TD + par.pulse.TR + par.pulse.PW,
+               t4 = par.pulse.TD + par.pulse.TR + par.pulse.PW + par.pulse.TF;
+        double riseSlope = (t1 != t2) ? (par.pulse.V2 - par.pulse.V1)/(t2 - t1) : 0,
+               fallSlope = (t3 != t4) ? (par.pulse.V2 - par.pulse.V1)/(t4 - t3) : 0;
+        for (unsigned int ind = 0; ind < numTimes; ind++) {
+            double tmod = fmod(times[ind], par.pulse.PER);
+            double val = par.pulse.V1;
+            val = (tmod >= t1 && tmod < t2) ? par.pulse.V1 + riseSlope*(tmod - t1) : val;
+            val = (tmod >= t2 && tmod < t3) ? par.pulse.V2 : val;
+            val = (tmod >= t3 && tmod < t4) ? par.pulse.V2 - fallSlope*(tmod - t3) : val;
+            values[ind] = val;
+        }
+      } break;
+    case WAVEFORM_SFFM: {
+        double omegaC = 2*M_PI*par.sffm.FC, omegaS = 2*M_PI*par.sffm.FS;
+        for (unsigned int start = 0; start < numTimes; start += kernelChunk) {
+            unsigned int num = std::min(numTimes - start, kernelChunk);
+            const double *t = times + start;
+            for (unsigned int ind = 0; ind < num; ind++) {
+                arg1[ind] = omegaS*t[ind];
+            }
+            blockSin(arg1, res1, num);
+            for (unsigned int ind = 0; ind < num; ind++) {
+                arg2[ind] = omegaC*t[ind] + par.sffm.MDI*res1[ind];
+            }
+            blockSin(arg2, res2, num);
+            for (unsigned int ind = 0; ind < num; ind++) {
+                values[start + ind] = par.sffm.VO + par.sffm.VA*res2[ind];
             }
-        } else if (tmod >= t4) {
-            return pulseV1;
-        } else {
-            return pulseV1;
         }
-      }  break;
-    case WAVEFORM_SFFM:
-        return SFFMVO + SFFMVA * sin(2*M_PI*SFFMFC*t + SFFMMDI * sin(2*M_PI*SFFMFS*t));
+      } break;
+    case WAVEFORM_AM: {
+        double omegaM = 2*M_PI*par.am.MF, omegaC = 2*M_PI*par.am.FC;
+        for (unsigned int start = 0; start < numTimes; start += kernelChunk) {
+            unsigned int num = std::min(numTimes - start, kernelChunk);
+            const double *t = times + start;
+            for (unsigned int ind = 0; ind < num; ind++) {
+                arg1[ind] = omegaM*t[ind];
+                arg2[ind] = omegaC*t[ind];
+            }
+            blockSin(arg1, res1, num);
+            blockSin(arg2, res2, num);
+            for (unsigned int ind = 0; ind < num; ind++) {
+                values[start + ind] = par.am.VA*(par.am.VO + res1[ind])*res2[ind];
+            }
+        }
+      } break;
+    default:
+        for (unsigned int ind = 0; ind < numTimes; ind++) {
+            values[ind] = eval(times[ind], state);
+        }
+    }
+}
+
+double
+Waveform::nextBreakpoint(double t, WaveformState &state) const {
+    switch (mode) {
+    case WAVEFORM_SIN:
+        if (t < par.sin.TD) {
+            return par.sin.TD;
+        }
         break;
-    case WAVEFORM_AM:
-        return AMVA * (AMVO + sin(2*M_PI*AMMF*t))*sin(2*M_PI*AMFC*t);
+    case WAVEFORM_EXP:
+        if (t < par.exp.TD1) {
+            return par.exp.TD1;
+        } else if (t < par.exp.TD2) {
+            return par.exp.TD2;
+        }
         break;
+    case WAVEFORM_PWL: {
+        // eval returns zero outside the knots so that the last knot is also
+        // a discontinuity.
+        if (par.pwl.file) {
+            return stateFile(state).nextBreakpoint(t);
+        }
+        const std::vector<double> &PWLtime = par.pwl.knots->time;
+        std::vector<double>::const_iterator it = std::upper_bound(PWLtime.begin(), PWLtime.end(), t);
+        if (it != PWLtime.end()) {
+            return *it;
+        }
+      } break;
+    case WAVEFORM_NOISE: {
+        // The noise is linear between the samples and RTS noise switches at
+        // the ends of the dwell intervals.
+        double tNext = HUGE_VAL;
+        if ((par.noise.NA != 0 || par.noise.NAMP != 0) && par.noise.NT > 0) {
+            tNext = (floor(t / par.noise.NT) + 1) * par.noise.NT;
+            if (tNext <= t) {
+                tNext += par.noise.NT;
+            }
+        }
+        if (par.noise.RTSAM != 0 && t >= 0) {
+            // Continue from the cursor closest before t.
+            RTSCursor *cursor = &state.RTSbreak[0], &other = state.RTSbreak[1];
+            if (other.start <= t && (cursor->start > t || other.start > cursor->start)) {
+                cursor = &other;
+            }
+            RTSstate(t, *cursor);
+            tNext = std::min(tNext, cursor->end);
+        }
+        return tNext;
+      }
+    case WAVEFORM_PULSE: {
+        // Corners of the pulse relative to the start of the period. As in
+        // eval, corners beyond the period are never reached.
+        double corners[5] = {0,
+                             par.pulse.TD,
+                             par.pulse.TD + par.pulse.TR,
+                             par.pulse.TD + par.pulse.TR + par.pulse.PW,
+                             par.pulse.TD + par.pulse.TR + par.pulse.PW + par.pulse.TF};
+        double tPeriod = 0;
+        if (par.pulse.PER > 0) {
+            tPeriod = floor(t / par.pulse.PER) * par.pulse.PER;
+        }
+        for (unsigned int indPer = 0; indPer < 2; indPer++) {
+            for (unsigned int indCorner = 0; indCorner < 5; indCorner++) {
+                if (par.pulse.PER > 0 && corners[indCorner] >= par.pulse.PER) break;
+                double tCorner = tPeriod + corners[indCorner];
+                if (tCorner > t) {
+                    return tCorner;
+                }
+            }
+            if (par.pulse.PER <= 0) break;
+            tPeriod += par.pulse.PER;
+        }
+      } break;
+    }
+    return HUGE_VAL;
+}
+
+Waveform::Waveform(const std::vector <double> &_PWLtime, const std::vector <double> &_PWLampl) {
+    assert(_PWLtime.size() == _PWLampl.size());
+    mode       = WAVEFORM_PWL;
+    recurrence = false;
+
+    std::lock_guard <std::mutex> lock(storeMutex);
+    PWLknotStore.push_back(PWLKnots());
+    PWLknotStore.back().time = _PWLtime;
+    PWLknotStore.back().ampl = _PWLampl;
+    par.pwl.knots = &PWLknotStore.back();
+    par.pwl.file  = 0;
+}
+
+Waveform::Waveform(const PWLKnots *knots) {
+    assert(knots->time.size() == knots->ampl.size());
+    mode          = WAVEFORM_PWL;
+    recurrence    = false;
+    par.pwl.knots = knots;
+    par.pwl.file  = 0;
+}
+
+unsigned int
+Waveform::PWLsegment(double t, WaveformState &state) const {
+    // During time stepping, t is usually in the interval of the cursor or
+    // in the next one. Otherwise, the interval is found by binary search.
+    const std::vector<double> &PWLtime = par.pwl.knots->time;
+    unsigned int numKnots = PWLtime.size();
+    unsigned int &cursor = state.PWLcursor;
+    if (cursor + 1 < numKnots && t >= PWLtime[cursor]) {
+        if (t < PWLtime[cursor + 1]) {
+            return cursor;
+        }
+        if (cursor + 2 < numKnots && t < PWLtime[cursor + 2]) {
+            return ++cursor;
+        }
     }
+    std::vector<double>::const_iterator it = std::upper_bound(PWLtime.begin(), PWLtime.end(), t);
+    cursor = (it - PWLtime.begin()) - 1;
+    return cursor;
 }
 
-Waveform::~Waveform() {
+PWLFile &
+Waveform::stateFile(WaveformState &state) const {
+    if (!state.PWLfile) {
+        state.PWLfile = new PWLFile(*par.pwl.file);
+    }
+    return *state.PWLfile;
+}
+
+WaveformState::WaveformState() {
+    PWLcursor = 0;
+    PWLfile   = 0;
+    RTSeval.event = 0;
+    RTSeval.start = RTSeval.end = 0;
+    RTSbreak[0] = RTSbreak[1] = RTSeval;
+    sampleValid = false;
+    oscValid = false;
+    oscPrev  = HUGE_VAL;
+}
+
+WaveformState::WaveformState(const WaveformState &state) {
+    PWLfile = 0;
+    *this = state;
+}
+
+WaveformState &
+WaveformState::operator=(const WaveformState &state) {
+    if (this == &state) {
+        return *this;
+    }
+    delete PWLfile;
+    PWLfile = 0;
+    if (state.PWLfile) {
+        PWLfile = new PWLFile(*state.PWLfile);
+    }
+
+    PWLcursor    = state.PWLcursor;
+    RTSeval      = state.RTSeval;
+    RTSbreak[0]  = state.RTSbreak[0];
+    RTSbreak[1]  = state.RTSbreak[1];
+    sampleIndex  = state.sampleIndex;
+    sampleCur    = state.sampleCur;
+    sampleNext   = state.sampleNext;
+    sampleValid  = state.sampleValid;
+
+    osc1         = state.osc1;
+    osc2         = state.osc2;
+    oscDecay     = state.oscDecay;
+    oscDecayStep = state.oscDecayStep;
+    oscAnchor    = state.oscAnchor;
+    oscStep      = state.oscStep;
+    oscPrev      = state.oscPrev;
+    oscCount     = state.oscCount;
+    oscValid     = state.oscValid;
+    return *this;
+}
 
+WaveformState::~WaveformState() {
+    delete PWLfile;
 }
 
 #ifdef TEST_WAVEFORM
@@ -329,12 +1069,379 @@ main(int argc, char **argv) {
 
     Waveform wfSin(vsin, sinName);
     Waveform wfPulse(vpulse, pulseName);
+    WaveformState stSin, stPulse;
+
+    std::cout << "sizeof(Waveform) " << sizeof(Waveform)
+              << " parameters " << sizeof(wfSin.par)
+              << " sizeof(WaveformState) " << sizeof(WaveformState) << std::endl;
 
     for (double t = 0; t < 1; t+= 0.001) {
-        double valSin = wfSin.eval(t),
-               valPulse = wfPulse.eval(t);
+        double valSin = wfSin.eval(t, stSin),
+               valPulse = wfPulse.eval(t, stPulse);
         std::cout << t << " " << valSin << " " << valPulse << std::endl;
     }
+
+    // Block evaluation must agree with eval.
+    std::vector<double> times(1000), valSin(1000), valPulse(1000);
+    for (unsigned int ind = 0; ind < times.size(); ind++) {
+        times[ind] = ind*0.001;
+    }
+    WaveformState stSinBlock, stPulseBlock;
+    wfSin.evalBlock(&times[0], &valSin[0], times.size(), stSinBlock);
+    wfPulse.evalBlock(&times[0], &valPulse[0], times.size(), stPulseBlock);
+
+    double maxDiff = 0;
+    for (unsigned int ind = 0; ind < times.size(); ind++) {
+        maxDiff = std::max(maxDiff, fabs(valSin[ind] - wfSin.eval(times[ind], stSin)));
+        maxDiff = std::max(maxDiff, fabs(valPulse[ind] - wfPulse.eval(times[ind], stPulse)));
+    }
+    std::cout << "evalBlock max difference " << maxDiff << std::endl;
+
+    // Benchmark of PWL evaluation with numKnots knots: linear scan of the
+    // knots from the first one, forward time stepping with the cursor and
+    // random access with binary search.
+    unsigned int numKnots = 1000000, numLinear = 1000, numEval = 1000000;
+    std::vector<double> knotTimes(numKnots), knotValues(numKnots);
+    srand(1);
+    for (unsigned int knot = 0; knot < numKnots; knot++) {
+        knotTimes[knot]  = knot*1e-6;
+        knotValues[knot] = (double) rand()/RAND_MAX;
+    }
+    Waveform wfPWL(knotTimes, knotValues);
+    WaveformState stPWL;
+    double tEnd = knotTimes.back();
+
+    clock_t clockStart = clock();
+    double sumLinear = 0, sumCheck = 0, sum = 0;
+    for (unsigned int ind = 0; ind < numLinear; ind++) {
+        double t = tEnd*ind/numLinear;
+        for (unsigned int knot = 0; knot + 1 < numKnots; knot++) {
+            if (t >= knotTimes[knot] && t < knotTimes[knot + 1]) {
+                sumLinear += knotValues[knot] + (knotValues[knot + 1] - knotValues[knot])
+                                              * (t - knotTimes[knot])/(knotTimes[knot + 1] - knotTimes[knot]);
+                break;
+            }
+        }
+    }
+    double timeLinear = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numLinear;
+
+    for (unsigned int ind = 0; ind < numLinear; ind++) {
+        sumCheck += wfPWL.eval(tEnd*ind/numLinear, stPWL);
+    }
+    clockStart = clock();
+    for (unsigned int ind = 0; ind < numEval; ind++) {
+        sum += wfPWL.eval(tEnd*ind/numEval, stPWL);
+    }
+    double timeCursor = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numEval;
+
+    std::vector<double> randomTimes(numEval);
+    for (unsigned int ind = 0; ind < numEval; ind++) {
+        randomTimes[ind] = tEnd*rand()/RAND_MAX;
+    }
+    clockStart = clock();
+    for (unsigned int ind = 0; ind < numEval; ind++) {
+        sum += wfPWL.eval(randomTimes[ind], stPWL);
+    }
+    double timeRandom = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numEval;
+
+    std::cout << "PWL with " << numKnots << " knots, time per evaluation:" << std::endl
+              << "  linear scan   " << timeLinear*1e9 << " ns" << std::endl
+              << "  cursor        " << timeCursor*1e9 << " ns" << std::endl
+              << "  binary search " << timeRandom*1e9 << " ns" << std::endl
+              << "Difference to linear scan " << fabs(sumLinear - sumCheck)
+              << " (" << sum << ")" << std::endl;
+
+    // PWL(FILE=...) in binary and text formats must agree with PWL(...) for
+    // forward stepping, random access and breakpoints. The knots span
+    // several chunks of the text file.
+    unsigned int numFileKnots = 5*PWLFile::chunkKnots + 17;
+    std::vector<double> fileTimes(numFileKnots), fileValues(numFileKnots);
+    for (unsigned int knot = 0; knot < numFileKnots; knot++) {
+        fileTimes[knot]  = 0.5 + knot*1e-3 + 1e-4*(knot % 3);
+        fileValues[knot] = (double) rand()/RAND_MAX;
+    }
+    Waveform wfInline(fileTimes, fileValues);
+
+    FILE *fileBin = fopen("pwl_test.bin", "wb"), *fileTxt = fopen("pwl_test.txt", "w");
+    fwrite("SSPPWL01", 1, 8, fileBin);
+    fprintf(fileTxt, "* time value\n");
+    for (unsigned int knot = 0; knot < numFileKnots; knot++) {
+        fwrite(&fileTimes[knot], sizeof(double), 1, fileBin);
+        fwrite(&fileValues[knot], sizeof(double), 1, fileBin);
+        fprintf(fileTxt, "%.17g, %.17g\n", fileTimes[knot], fileValues[knot]);
+    }
+    fclose(fileBin);
+    fclose(fileTxt);
+
+    std::string pwlName("PWL");
+    std::vector<std::string> vbin(1, "FILE=\"pwl_test.bin\""), vtxt(1, "FILE=\"pwl_test.txt\"");
+    Waveform wfBin(vbin, pwlName), wfTxt(vtxt, pwlName);
+    WaveformState stInline, stBin, stTxt;
+
+    // Random access may parse a chunk of the text file for each evaluation
+    // and fewer time points are used.
+    double tMax = fileTimes.back() + 0.1;
+    maxDiff = 0;
+    for (unsigned int ind = 0; ind < 100000; ind++) {
+        double tForward = tMax*ind/100000;
+        double ref = wfInline.eval(tForward, stInline);
+        maxDiff = std::max(maxDiff, fabs(wfBin.eval(tForward, stBin) - ref));
+        maxDiff = std::max(maxDiff, fabs(wfTxt.eval(tForward, stTxt) - ref));
+    }
+    for (unsigned int ind = 0; ind < 2000; ind++) {
+        double tRandom = tMax*rand()/RAND_MAX;
+        double ref = wfInline.eval(tRandom, stInline);
+        maxDiff = std::max(maxDiff, fabs(wfBin.eval(tRandom, stBin) - ref));
+        maxDiff = std::max(maxDiff, fabs(wfTxt.eval(tRandom, stTxt) - ref));
+        ref = wfInline.nextBreakpoint(tRandom, stInline);
+        maxDiff = std::max(maxDiff, fabs(wfBin.nextBreakpoint(tRandom, stBin) - ref));
+        maxDiff = std::max(maxDiff, fabs(wfTxt.nextBreakpoint(tRandom, stTxt) - ref));
+    }
+    std::cout << "PWL(FILE=...) max difference " << maxDiff << std::endl;
+    remove("pwl_test.bin");
+    remove("pwl_test.txt");
+
+    // Benchmark of the recurrence against direct evaluation of a damped SIN
+    // over 10^8 fixed steps evaluated in blocks. The direct evaluation is
+    // timed for a sixteenth of the steps and the error of the recurrence is
+    // checked at every 101st step.
+    std::vector<std::string> vdamped;
+    vdamped.push_back("0.5");
+    vdamped.push_back("2");
+    vdamped.push_back("1k");
+    vdamped.push_back("1m");
+    vdamped.push_back("0.01");
+    Waveform wfRec(vdamped, sinName), wfDirect(vdamped, sinName);
+    wfDirect.recurrence = false;
+    WaveformState stRec, stCheck, stDirect;
+
+    unsigned long numSteps = 100000000;
+    unsigned int blockSize = 256;
+    double dt = 1e-6, sumRec = 0, sumDirect = 0;
+    std::vector<double> blockTimes(blockSize), blockValues(blockSize);
+
+    clockStart = clock();
+    for (unsigned long step = 0; step < numSteps; step += blockSize) {
+        for (unsigned int ind = 0; ind < blockSize; ind++) {
+            blockTimes[ind] = (step + ind)*dt;
+        }
+        wfRec.evalBlock(&blockTimes[0], &blockValues[0], blockSize, stRec);
+        sumRec += blockValues[blockSize - 1];
+    }
+    double timeRec = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numSteps;
+
+    clockStart = clock();
+    for (unsigned long step = 0; step < numSteps/16; step += blockSize) {
+        for (unsigned int ind = 0; ind < blockSize; ind++) {
+            blockTimes[ind] = (step + ind)*dt;
+        }
+        wfDirect.evalBlock(&blockTimes[0], &blockValues[0], blockSize, stDirect);
+        sumDirect += blockValues[blockSize - 1];
+    }
+    double timeDirect = (double)(clock() - clockStart)/CLOCKS_PER_SEC/(numSteps/16);
+
+    maxDiff = 0;
+    for (unsigned long step = 0; step < numSteps; step += blockSize) {
+        for (unsigned int ind = 0; ind < blockSize; ind++) {
+            blockTimes[ind] = (step + ind)*dt;
+        }
+        wfRec.evalBlock(&blockTimes[0], &blockValues[0], blockSize, stCheck);
+        for (unsigned int ind = (101 - step % 101) % 101; ind < blockSize; ind += 101) {
+            maxDiff = std::max(maxDiff, fabs(blockValues[ind] - wfDirect.eval(blockTimes[ind], stDirect)));
+        }
+    }
+    std::cout << "Damped SIN over " << numSteps << " steps, time per evaluation:" << std::endl
+              << "  direct     " << timeDirect*1e9 << " ns" << std::endl
+              << "  recurrence " << timeRec*1e9 << " ns" << std::endl
+              << "Maximum error of the recurrence " << maxDiff
+              << " (" << sumRec << " " << sumDirect << ")" << std::endl;
+
+    // SFFM and AM with single evaluations.
+    std::string sffmName("SFFM"), amName("AM");
+    std::vector<std::string> vsffm, vam;
+    vsffm.push_back("0");  vsffm.push_back("1"); vsffm.push_back("10k");
+    vsffm.push_back("5");  vsffm.push_back("1k");
+    vam.push_back("1");    vam.push_back("0.5"); vam.push_back("1k");
+    vam.push_back("20k");  vam.push_back("0");
+    Waveform wfSFFM(vsffm, sffmName), wfAM(vam, amName);
+    Waveform wfSFFMdirect(vsffm, sffmName), wfAMdirect(vam, amName);
+    wfSFFMdirect.recurrence = false;
+    wfAMdirect.recurrence = false;
+    WaveformState stSFFM, stAM, stSFFMdirect, stAMdirect;
+    maxDiff = 0;
+    for (unsigned int step = 0; step < 1000000; step++) {
+        double t = step*dt;
+        maxDiff = std::max(maxDiff, fabs(wfSFFM.eval(t, stSFFM) - wfSFFMdirect.eval(t, stSFFMdirect)));
+        maxDiff = std::max(maxDiff, fabs(wfAM.eval(t, stAM) - wfAMdirect.eval(t, stAMdirect)));
+    }
+    std::cout << "SFFM and AM maximum error of the recurrence " << maxDiff << std::endl;
+
+    // Errors of blockSin and blockExp relative to the math library and the
+    // time per evaluation of both. The ranges of the arguments of sin are
+    // within the reduction, beyond pi/2 * 2^20 and beyond sinReduceMax.
+    unsigned int numKernel = 1 << 22;
+    std::vector<double> kernelArgs(numKernel), kernelValues(numKernel);
+    double sinRanges[3] = {1e3, 5e7, 1e9}, sinError[3];
+    for (unsigned int indRange = 0; indRange < 3; indRange++) {
+        for (unsigned int ind = 0; ind < numKernel; ind++) {
+            kernelArgs[ind] = sinRanges[indRange]*(2.0*rand()/RAND_MAX - 1);
+        }
+        blockSin(&kernelArgs[0], &kernelValues[0], numKernel);
+        sinError[indRange] = 0;
+        for (unsigned int ind = 0; ind < numKernel; ind++) {
+            sinError[indRange] = std::max(sinError[indRange],
+                                          fabs(kernelValues[ind] - sin(kernelArgs[ind])));
+        }
+    }
+    double expRanges[2] = {1, 700}, expError[2];
+    for (unsigned int indRange = 0; indRange < 2; indRange++) {
+        for (unsigned int ind = 0; ind < numKernel; ind++) {
+            kernelArgs[ind] = expRanges[indRange]*(2.0*rand()/RAND_MAX - 1);
+        }
+        blockExp(&kernelArgs[0], &kernelValues[0], numKernel);
+        expError[indRange] = 0;
+        for (unsigned int ind = 0; ind < numKernel; ind++) {
+            double ref = exp(kernelArgs[ind]);
+            expError[indRange] = std::max(expError[indRange], fabs(kernelValues[ind] - ref)/ref);
+        }
+    }
+
+    double timeKernel[4], sumKernel = 0;
+    for (unsigned int ind = 0; ind < numKernel; ind++) {
+        kernelArgs[ind] = 100.0*rand()/RAND_MAX - 50;
+    }
+    for (unsigned int indFunc = 0; indFunc < 4; indFunc++) {
+        clockStart = clock();
+        for (unsigned int start = 0; start < numKernel; start += kernelChunk) {
+            const double *x = &kernelArgs[start];
+            double *y = &kernelValues[start];
+            switch (indFunc) {
+            case 0:
+                for (unsigned int ind = 0; ind < kernelChunk; ind++) y[ind] = sin(x[ind]);
+                break;
+            case 1:
+                blockSin(x, y, kernelChunk);
+                break;
+            case 2:
+                for (unsigned int ind = 0; ind < kernelChunk; ind++) y[ind] = exp(x[ind]);
+                break;
+            case 3:
+                blockExp(x, y, kernelChunk);
+                break;
+            }
+            sumKernel += y[kernelChunk - 1];
+        }
+        timeKernel[indFunc] = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numKernel;
+    }
+    std::cout << "blockSin maximum error " << sinError[0] << " |x| < " << sinRanges[0]
+              << ", " << sinError[1] << " |x| < " << sinRanges[1]
+              << ", " << sinError[2] << " |x| < " << sinRanges[2] << std::endl
+              << "blockExp maximum relative error " << expError[0] << " |x| < " << expRanges[0]
+              << ", " << expError[1] << " |x| < " << expRanges[1] << std::endl
+              << "Time per evaluation in chunks of " << kernelChunk << ":" << std::endl
+              << "  sin " << timeKernel[0]*1e9 << " ns, blockSin " << timeKernel[1]*1e9 << " ns"
+              << std::endl
+              << "  exp " << timeKernel[2]*1e9 << " ns, blockExp " << timeKernel[3]*1e9 << " ns"
+              << " (" << sumKernel << ")" << std::endl;
+
+    // Known answer of Philox4x32-10 for zero counter and key:
+    // 6627e8d5 e169c58d bc57ac4c 9b00dbd8.
+    uint32_t philoxOut[4];
+    Philox(0, 0).generate(0, 0, 0, 0, philoxOut);
+    printf("Philox4x32-10 %08x %08x %08x %08x\n", philoxOut[0], philoxOut[1],
+           philoxOut[2], philoxOut[3]);
+
+    // White, 1/f and RTS noise. The noise evaluated in blocks on numThreads
+    // threads, each with a copy of the Waveform, must be identical to the
+    // serial evaluation.
+    std::string noiseName("NOISE");
+    std::vector<std::string> vnoise;
+    vnoise.push_back("1");    vnoise.push_back("1u");  vnoise.push_back("1");
+    vnoise.push_back("0.5");  vnoise.push_back("0.1"); vnoise.push_back("20u");
+    vnoise.push_back("60u");
+    Waveform wfNoise(vnoise, noiseName);
+    wfNoise.setSourceName("VNOISE");
+
+    unsigned int numNoise = 1000000, numThreads = 4;
+    std::vector<double> noiseTimes(numNoise), noiseSerial(numNoise), noiseParallel(numNoise);
+    for (unsigned int ind = 0; ind < numNoise; ind++) {
+        noiseTimes[ind] = ind*1e-6;
+    }
+    clockStart = clock();
+    WaveformState stNoise;
+    wfNoise.evalBlock(&noiseTimes[0], &noiseSerial[0], numNoise, stNoise);
+    double timeNoise = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numNoise;
+
+    std::vector<std::thread> threads;
+    std::vector<WaveformState> threadStates(numThreads);
+    for (unsigned int indThread = 0; indThread < numThreads; indThread++) {
+        // Threads evaluate interleaved blocks in reverse order with their
+        // own states of the shared Waveform.
+        threads.push_back(std::thread([&, indThread]() {
+            unsigned int blockSize = 1000, numBlocks = numNoise / blockSize;
+            for (unsigned int block = numBlocks; block-- > 0;) {
+                if (block % numThreads != indThread) continue;
+                wfNoise.evalBlock(&noiseTimes[block*blockSize],
+                                  &noiseParallel[block*blockSize], blockSize,
+                                  threadStates[indThread]);
+            }
+        }));
+    }
+    for (unsigned int indThread = 0; indThread < numThreads; indThread++) {
+        threads[indThread].join();
+    }
+    unsigned int numMismatch = 0;
+    for (unsigned int ind = 0; ind < numNoise; ind++) {
+        if (noiseSerial[ind] != noiseParallel[ind]) numMismatch++;
+    }
+
+    // The breakpoints queried ahead of the evaluation in blocks and at the
+    // evaluated times, as by Transient, must not change the noise and must
+    // not slow down the evaluation.
+    WaveformState stAhead;
+    std::vector<double> noiseAhead(numNoise);
+    unsigned int aheadBlock = 256, numAheadMismatch = 0;
+    double sumBreak = 0;
+    clockStart = clock();
+    for (unsigned int start = 0; start < numNoise; start += aheadBlock) {
+        unsigned int end = std::min(start + aheadBlock, numNoise);
+        for (unsigned int ind = start; ind < end; ind++) {
+            sumBreak += wfNoise.nextBreakpoint(noiseTimes[ind], stAhead);
+        }
+        wfNoise.evalBlock(&noiseTimes[start], &noiseAhead[start], end - start, stAhead);
+        for (unsigned int ind = start; ind < end; ind++) {
+            sumBreak += wfNoise.nextBreakpoint(noiseTimes[ind], stAhead);
+        }
+    }
+    double timeAhead = (double)(clock() - clockStart)/CLOCKS_PER_SEC/numNoise;
+    for (unsigned int ind = 0; ind < numNoise; ind++) {
+        if (noiseSerial[ind] != noiseAhead[ind]) numAheadMismatch++;
+    }
+
+    // Statistics of the components: the RMS of the white and 1/f noise and
+    // the fraction of time in the RTS state 1, which should be
+    // RTSEMT/(RTSCAPT + RTSEMT) = 0.75.
+    double sumWhite = 0, sumPink = 0, sumRTS = 0;
+    Waveform wfWhite(wfNoise), wfPink(wfNoise), wfRTS(wfNoise);
+    wfPink.par.noise.NA = wfRTS.par.noise.NA = 0;
+    wfWhite.par.noise.NAMP = wfRTS.par.noise.NAMP = 0;
+    wfWhite.par.noise.RTSAM = wfPink.par.noise.RTSAM = 0;
+    WaveformState stWhite, stPink, stRTS;
+    for (unsigned int ind = 0; ind < numNoise; ind++) {
+        double white = wfWhite.eval(noiseTimes[ind], stWhite),
+               pink  = wfPink.eval(noiseTimes[ind], stPink);
+        sumWhite += white*white;
+        sumPink  += pink*pink;
+        sumRTS   += wfRTS.eval(noiseTimes[ind], stRTS);
+    }
+    std::cout << "NOISE time per evaluation " << timeNoise*1e9 << " ns, "
+              << numMismatch << " differences with " << numThreads << " threads" << std::endl
+              << "  with breakpoint lookahead " << timeAhead*1e9 << " ns, "
+              << numAheadMismatch << " differences (mean breakpoint "
+              << sumBreak/(2*numNoise) << ")" << std::endl
+              << "  white RMS " << sqrt(sumWhite/numNoise)
+              << " 1/f RMS " << sqrt(sumPink/numNoise)
+              << " RTS state 1 fraction " << sumRTS/numNoise/0.1 << std::endl;
 }
 
 #endif
@@ -23,7 +23,191 @@
 #include <string>
 #include <math.h>
 #include <iostream>
+#include <deque>
+#include <mutex>
 #include "value.h"
+#include "pwlFile.h"
+#include <stdint.h>
+
+/* Oscillator object generates cos(omega*t) and sin(omega*t) at equally
+ * spaced time points by rotating the phasor (c, s) by the angle omega*h at
+ * each step. Rounding errors in the magnitude of the phasor are removed every
+ * renormInterval steps.
+ */
+
+class Oscillator {
+public:
+    void start(double _omega, double phase, double h);
+    void advance();
+
+    double omega, c, s, cStep, sStep;
+    unsigned int count;
+    static const unsigned int renormInterval = 64;
+};
+
+/* Parameters of the waveforms. Each struct is trivially copyable and only
+ * the one selected by the mode of the Waveform is stored.
+ */
+
+/* SIN(V0 VA FREQ TD THETA)
+ *                       Default
+ *  V0   Offset             -
+ *  VA   Amplitude          -
+ * FREQ  Frequency         1/t2
+ *  TD   Delay              0
+ * THETA Damping factor     0
+ */
+struct SinParams {
+    double V0, VA, FREQ, TD, THETA;
+    bool FREQset;
+};
+
+/* PULSE(V1 V2 TD TR TF PW PER)
+ *                      Default
+ * V1   Initial value      -
+ * V2   Pulsed value       -
+ * TD   Delay time         0
+ * TR   Rise time       time step
+ * TF   Fall time       time step
+ * PW   Pulse width        t2
+ * PER  Period             t2
+ */
+struct PulseParams {
+    double V1, V2, TD, TR, TF, PW, PER;
+    bool TRset, TFset, PWset, PERset;
+};
+
+/* EXP(V1 V2 TD1 TAU1 TD2 TAU2)
+ *                            Default
+ * V1    Initial value           -
+ * V2    Pulsed value            -
+ * TD1   Rise delay time         0
+ * TAU1  Rise time constant  time step
+ * TD2   Fall delay time     t1 + time step
+ * TAU2  Fall time constant  time step
+ */
+struct ExpParams {
+    double V1, V2, TD1, TAU1, TD2, TAU2;
+    bool TAU1set, TD2set, TAU2set;
+};
+
+/* SFFM(VO VA FC MDI FS)
+ *                           Default
+ *  VO   Offset                 -
+ *  VA   Amplitude              -
+ *  FC   Carrier frequency      -
+ *  MDI  Modulation index       -
+ *  FS   Signal frequency       -
+ */
+struct SFFMParams {
+    double VO, VA, FC, MDI, FS;
+};
+
+/* AM(VA VO MF DC tD)
+ *                           Default
+ *  VA   Amplitude              -
+ *  VO   Offset                 -
+ *  MF   Modulation frequency   -
+ *  FC   Carrier frequency      -
+ *  TD   Signal delay           -
+ */
+struct AMParams {
+    double VA, VO, MF, FC, TD;
+};
+
+/* NOISE(NA NT NALPHA NAMP RTSAM RTSCAPT RTSEMT)
+ *                                  Default
+ *  NA      White noise RMS            -
+ *  NT      Time between samples   time step
+ *  NALPHA  1/f exponent (0...2)       0
+ *  NAMP    1/f noise RMS              0
+ *  RTSAM   RTS amplitude              0
+ *  RTSCAPT RTS mean capture time      0
+ *  RTSEMT  RTS mean emission time     0
+ *
+ * The random numbers are generated with the key (seed, sourceId). pinkScale
+ * and pinkRatio are the weight of the first octave of 1/f noise and the ratio
+ * of the weights of consecutive octaves.
+ */
+struct NoiseParams {
+    double NA, NT, NALPHA, NAMP, RTSAM, RTSCAPT, RTSEMT;
+    bool NTset;
+    uint32_t seed, sourceId;
+    double pinkScale, pinkRatio;
+};
+
+// Knots of PWL(T0 A0 T1 A1 T2 A2 ...).
+struct PWLKnots {
+    std::vector <double> time, ampl;
+};
+
+/* PWL(T0 A0 T1 A1 T2 A2 ...)
+ * PWL(FILE="name")
+ *
+ * The waveform refers to its knots, or to the file opened at parsing, which
+ * are never modified during evaluation. Exactly one of knots and file is
+ * set.
+ */
+struct PWLParams {
+    const PWLKnots *knots;
+    const PWLFile *file;
+};
+
+// The dwell interval [start, end) of RTS noise with the index event.
+struct RTSCursor {
+    uint64_t event;
+    double start, end;
+};
+
+/* WaveformState object contains the state of the evaluation of a Waveform,
+ * which is modified by eval, evalBlock and nextBreakpoint. A solver keeps a
+ * state for each of its waveforms, and each thread its own states, so that
+ * the Waveform stays immutable during the solution. A default-constructed
+ * state is valid for any Waveform, but a state must not be shared between
+ * different Waveforms.
+ *
+ * PWLcursor    Index of the knot interval of the latest PWL evaluation.
+ * PWLfile      Copy of the file of PWL(FILE=...) with its own cursor, which
+ *              is made at the first evaluation.
+ * RTSeval      Dwell interval of RTS noise of the latest evaluation.
+ * RTSbreak     Dwell intervals of the breakpoint queries. The solvers query
+ *              the breakpoints both at the current time and ahead of it, so
+ *              that two cursors keep both moving forward.
+ * sampleCur    Noise samples sampleIndex and sampleIndex + 1 of the latest
+ * sampleNext   evaluation, which are reused during time stepping.
+ * osc1, osc2   State of the recurrence: the oscillators, the decay of SIN and
+ * oscDecay     its multiplier, the time of the latest restart, the spacing,
+ * ...          the time of the previous evaluation and the number of steps
+ *              since the restart.
+ */
+
+class WaveformState {
+public:
+    WaveformState();
+    WaveformState(const WaveformState &state);
+    WaveformState &operator=(const WaveformState &state);
+    ~WaveformState();
+
+    unsigned int PWLcursor;
+    PWLFile *PWLfile;
+
+    RTSCursor RTSeval, RTSbreak[2];
+    uint64_t sampleIndex;
+    double sampleCur, sampleNext;
+    bool sampleValid;
+
+    Oscillator osc1, osc2;
+    double oscDecay, oscDecayStep, oscAnchor, oscStep, oscPrev;
+    unsigned int oscCount;
+    bool oscValid;
+};
+
+/* Waveform object stores the mode and the parameters of the active mode in a
+ * union. The parameters are not modified by the evaluation, whose state is
+ * kept in a WaveformState, so that a Waveform is trivially copyable and the
+ * copies of the sources used by the solvers are small. The waveforms are
+ * evaluated through a table of member functions indexed by the mode.
+ */
 
 class Waveform {
 public:
@@ -33,84 +217,99 @@ public:
          WAVEFORM_SFFM,
          WAVEFORM_AM,
          WAVEFORM_PULSE,
-         WAVEFORM_NOISE};
+         WAVEFORM_NOISE,
+         WAVEFORM_NUM_MODES};
 
     Waveform(std::vector <std::string> &bracket, std::string &bracketName);
-    ~Waveform();
+    // PWL waveform with a copy of the given knots in PWLknotStore.
+    Waveform(const std::vector <double> &_PWLtime, const std::vector <double> &_PWLampl);
+    // PWL waveform with the knots of the caller, which must outlive the
+    // Waveform and its copies.
+    Waveform(const PWLKnots *knots);
+
+    double eval(double t, WaveformState &state) const {
+        return (this->*evalTable[mode])(t, state);
+    }
+    // Evaluate the waveform at numTimes time points into values. The time
+    // points are expected in increasing order for efficiency. The sines and
+    // exponentials of SIN, EXP, SFFM and AM are evaluated over the block
+    // with polynomial kernels, which the compiler vectorizes at -O3.
+    void evalBlock(const double *times, double *values, unsigned int numTimes,
+                   WaveformState &state) const;
 
-    double eval(double t);
+    // When recurrence is set, SIN, SFFM and AM waveforms evaluated at
+    // equally spaced time points, e.g., with a fixed time step, are generated
+    // with Oscillator objects instead of calling sin and exp: the phasors of
+    // the sinusoids are rotated and the decay of damped SIN is multiplied by
+    // a constant each step. Only the carrier of SFFM still requires sin. The
+    // oscillators are restarted from the exact values every anchorInterval
+    // steps and whenever the spacing changes, which bounds the accumulation
+    // of the rounding errors independently of the number of steps.
+    bool recurrence;
+    static const unsigned int anchorInterval = 4096;
     void setTransientParameters(double timestep, double t1, double t2);
 
-    /* SIN(V0 VA FREQ TD THETA)
-     *                       Default
-     *  V0   Offset             -
-     *  VA   Amplitude          -
-     * FREQ  Frequency         1/t2
-     *  TD   Delay              0
-     * THETA Damping factor     0
-     */
-    double sinV0, sinVA, sinFREQ, sinTD, sinTHETA;
-    bool sinFREQset;
-
-    /* PULSE(V1 V2 TD TR TF PW PER)
-     *                      Default
-     * V1   Initial value      -
-     * V2   Pulsed value       -
-     * TD   Delay time         0
-     * TR   Rise time       time step
-     * TF   Fall time       time step
-     * PW   Pulse width        t2
-     * PER  Period             t2
-     */
-
-    double pulseV1, pulseV2, pulseTD, pulseTR, pulseTF, pulsePW, pulsePER;
-    bool pulseTRset, pulseTFset, pulsePWset, pulsePERset;
-
-    /* EXP(V1 V2 TD1 TAU1 TD2 TAU2)
-     *                            Default
-     * V1    Initial value           -
-     * V2    Pulsed value            -
-     * TD1   Rise delay time         0
-     * TAU1  Rise time constant  time step
-     * TD2   Fall delay time     t1 + time step
-     * TAU2  Fall time constant  time step
-     */
-
-    double expV1, expV2, expTD1, expTAU1, expTD2, expTAU2;
-    bool expTAU1set, expTD2set, expTAU2set;
-
-    // PWL(T0 A0 T1 A1 T2 A2 ...)
-
-    std::vector <double> PWLtime, PWLampl;
-
-    /* SFFM(VO VA FC MDI FS)
-     *                           Default
-     *  VO   Offset                 -
-     *  VA   Amplitude              -
-     *  FC   Carrier frequency      -
-     *  MDI  Modulation index       -
-     *  FS   Signal frequency       -
-     */
-
-    double SFFMVO, SFFMVA, SFFMFC, SFFMMDI, SFFMFS;
-
-    /* AM(VA VO MF DC tD)
-     *                           Default
-     *  VA   Amplitude              -
-     *  VO   Offset                 -
-     *  MF   Modulation frequency   -
-     *  FC   Carrier frequency      -
-     *  TD   Signal delay           -
-     */
-
-    double AMVA, AMVO, AMMF, AMFC, AMTD;
-
-    double noiseNA, noiseNT, noiseNALPHA, noiseNAMP, noiseRTSAM, noiseRTSCAPT, noiseRTSEMT;
+    // Returns the first time strictly after t, where the waveform or its
+    // derivative is discontinuous (PULSE corners, PWL knots, EXP and SIN
+    // delays). HUGE_VAL is returned for smooth waveforms.
+    double nextBreakpoint(double t, WaveformState &state) const;
+
+    // Noise of the NOISE waveform is a function of the seed, the source id
+    // and the sample index, or the index of the dwell interval of RTS noise,
+    // only so that the sources can be evaluated in any order and on any
+    // number of threads with bit-identical results. The id
+    // is obtained by hashing the name of the source. noiseSeed is the seed
+    // of the subsequently parsed NOISE waveforms.
+    void setSourceName(const std::string &sourceName);
+    static uint32_t noiseSeed;
+    static const unsigned int numPinkOctaves = 16;
 
     unsigned int mode;
-//private:
-    std::vector <std::string> strList;
-    std::string name;
+    union {
+        SinParams sin;
+        PulseParams pulse;
+        ExpParams exp;
+        SFFMParams sffm;
+        AMParams am;
+        NoiseParams noise;
+        PWLParams pwl;
+    } par;
+
+    // The knots of the parsed PWL waveforms and the files of PWL(FILE=...)
+    // are kept until the end of the program so that the copies of the
+    // Waveform can refer to them. Elements of a deque are not moved by
+    // insertion.
+    static std::deque <PWLKnots> PWLknotStore;
+    static std::deque <PWLFile> PWLfileStore;
+    static std::mutex storeMutex;
+
+    // The index of the knot interval [PWLtime[k], PWLtime[k+1]) containing
+    // PWLtime[0] <= t < PWLtime.back().
+    unsigned int PWLsegment(double t, WaveformState &state) const;
+
+    void evalRecurrence(const double *times, double *values, unsigned int numTimes,
+                        WaveformState &state) const;
+    void startRecurrence(double t, double h, WaveformState &state) const;
+private:
+    double evalSin(double t, WaveformState &state) const;
+    double evalExp(double t, WaveformState &state) const;
+    double evalPWL(double t, WaveformState &state) const;
+    double evalSFFM(double t, WaveformState &state) const;
+    double evalAM(double t, WaveformState &state) const;
+    double evalPulse(double t, WaveformState &state) const;
+    double evalNoise(double t, WaveformState &state) const;
+
+    // The PWL(FILE=...) reader of the state.
+    PWLFile &stateFile(WaveformState &state) const;
+
+    // Sum of the white and 1/f noise at the sample k, and the state (0 or 1)
+    // of the RTS noise at t. RTSstate moves the cursor to the dwell interval
+    // containing t.
+    double noiseSample(uint64_t k) const;
+    unsigned int RTSstate(double t, RTSCursor &cursor) const;
+
+    typedef double (Waveform::*EvalFunction)(double t, WaveformState &state) const;
+    static const EvalFunction evalTable[WAVEFORM_NUM_MODES];
 };
 
 #endif // WAVEFORM_H
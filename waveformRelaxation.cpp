@@ -0,0 +1,745 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "waveformRelaxation.h"
+
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+WaveformRelaxation::WaveformRelaxation(Parser *_parser, double _dt, double _t2, double _t1,
+                                       double _theta, unsigned int _method, double _rCut,
+                                       unsigned int _numThreads) {
+    parser     = _parser;
+    dt         = _dt;
+    t1         = _t1;
+    t2         = _t2;
+    theta      = _theta;
+    method     = _method;
+    rCut       = _rCut;
+    numThreads = _numThreads;
+    window     = 100*dt;
+    tol        = 1e-6;
+    maxIter    = 50;
+    scheme     = WR_GAUSS_SEIDEL;
+    latency    = false;
+    latencyTol = 1e-6;
+    verbose    = true;
+    writer     = 0;
+
+    // Without output variables in the circuit, all node voltages and
+    // element currents are written as in Transient.
+    NodeList *nodeList = parser->nodeList;
+    std::vector <Element> &elements = parser->elemList->elements;
+    probes = parser->probes;
+    if (probes.size() == 0) {
+        for (unsigned int indNode = 1; indNode < nodeList->numNodes; indNode++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_VOLTAGE;
+            probe.name  = "V(" + nodeList->mapNodeString[indNode] + ")";
+            probe.args.push_back(nodeList->mapNodeString[indNode]);
+            probe.node1 = indNode;
+            probe.node2 = 0;
+            probe.elemInd = 0;
+            probes.push_back(probe);
+        }
+        for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+            Probe probe;
+            probe.type  = Probe::PROBE_CURRENT;
+            probe.name  = "I(" + elements[indElem].name + ")";
+            probe.args.push_back(elements[indElem].name);
+            probe.node1 = probe.node2 = 0;
+            probe.elemInd = indElem;
+            probes.push_back(probe);
+        }
+    }
+    outputs.assign(probes.size(), 0);
+
+    partition();
+}
+
+WaveformRelaxation::~WaveformRelaxation() {
+    for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+        delete partitions[indPart].tran;
+        delete partitions[indPart].elemList;
+        delete partitions[indPart].nodeList;
+    }
+}
+
+void
+WaveformRelaxation::partition() {
+    NodeList *nodeList = parser->nodeList;
+    std::vector <Element> &elements = parser->elemList->elements;
+
+    // Graph of the strong connections between the non-ground nodes. The
+    // controlling nodes and the controlling voltage sources of controlled
+    // sources must be in the same partition as the source.
+    Topology topology(*nodeList);
+    std::vector <bool> cut(elements.size(), false);
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        Element &elem = elements[indElem];
+
+        if (elem.elemType == STAT_RESISTANCE && elem.valueList[0] >= rCut) {
+            cut[indElem] = true;
+            continue;
+        }
+        std::vector <unsigned int> nodeIds = elem.nodeIds;
+        if (elem.elemType == STAT_CCVS || elem.elemType == STAT_CCCS) {
+            int indRef = parser->elemList->elem(elem.elemIds[0]);
+            if (indRef < 0) {
+                std::cerr << "Unknown source: \"" << elem.elemList[0] << "\"" << std::endl;
+                exit(-1);
+            }
+            Element &elemRef = elements[indRef];
+            nodeIds.insert(nodeIds.end(), elemRef.nodeIds.begin(), elemRef.nodeIds.end());
+        }
+
+        int firstNode = -1;
+        for (unsigned int indNode = 0; indNode < nodeIds.size(); indNode++) {
+            unsigned int node = nodeList->node(nodeIds[indNode]);
+            if (node == 0) continue;
+            if (firstNode < 0) {
+                firstNode = node;
+            } else {
+                topology.addEdge(firstNode, node, indElem);
+            }
+        }
+    }
+
+    // Connected components of the graph.
+    unsigned int numParts = 0;
+    nodePartition.assign(nodeList->numNodes, -1);
+    for (unsigned int indNode = 1; indNode < nodeList->numNodes; indNode++) {
+        if (nodePartition[indNode] >= 0) continue;
+
+        std::vector <int> dist, parent;
+        std::list <Link> spanningTree;
+        unsigned int numTraversed;
+        topology.BFS(dist, parent, spanningTree, numTraversed, indNode);
+        for (unsigned int node = 1; node < nodeList->numNodes; node++) {
+            if (dist[node] >= 0) {
+                nodePartition[node] = numParts;
+            }
+        }
+        numParts++;
+    }
+
+    // Weak resistances inside a partition or to the ground are not cut.
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        if (!cut[indElem]) continue;
+        int part1 = nodePartition[nodeList->node(elements[indElem].nodeIds[0])],
+            part2 = nodePartition[nodeList->node(elements[indElem].nodeIds[1])];
+        if (part1 == part2 || part1 < 0 || part2 < 0) {
+            cut[indElem] = false;
+        }
+    }
+
+    partitions.resize(numParts);
+    for (unsigned int indPart = 0; indPart < numParts; indPart++) {
+        buildPartition(partitions[indPart], indPart, cut);
+    }
+}
+
+void
+WaveformRelaxation::buildPartition(WRPartition &part, unsigned int indPart,
+                                   std::vector <bool> &cut) {
+    NodeList *nodeList = parser->nodeList;
+    std::vector <Element> &elements = parser->elemList->elements;
+
+    std::set <std::string> nodeStrs;
+    nodeStrs.insert("0");
+    for (unsigned int node = 1; node < nodeList->numNodes; node++) {
+        if (nodePartition[node] == (int) indPart) {
+            part.nodes.push_back(node);
+            nodeStrs.insert(nodeList->mapNodeString[node]);
+        }
+    }
+
+    // Elements are in the partition of their first non-ground node. Cut
+    // resistances are in both partitions of their nodes.
+    std::vector <Element> partElems;
+    part.hasWaveforms = false;
+    part.dormant = false;
+    for (unsigned int indElem = 0; indElem < elements.size(); indElem++) {
+        Element &elem = elements[indElem];
+        bool inPart = false;
+
+        if (cut[indElem]) {
+            unsigned int node1 = nodeList->node(elem.nodeIds[0]),
+                         node2 = nodeList->node(elem.nodeIds[1]);
+            if (nodePartition[node1] == (int) indPart || nodePartition[node2] == (int) indPart) {
+                unsigned int nodeOther = (nodePartition[node1] == (int) indPart) ? node2 : node1;
+                inPart = true;
+                if (std::find(part.boundaryNodes.begin(), part.boundaryNodes.end(), nodeOther)
+                    == part.boundaryNodes.end()) {
+                    part.boundaryNodes.push_back(nodeOther);
+                }
+            }
+        } else {
+            for (unsigned int indNode = 0; indNode < elem.nodeList.size(); indNode++) {
+                unsigned int node = nodeList->node(elem.nodeIds[indNode]);
+                if (node != 0) {
+                    inPart = nodePartition[node] == (int) indPart;
+                    break;
+                }
+            }
+        }
+        if (inPart) {
+            partElems.push_back(elem);
+            part.elemInds.push_back(indElem);
+            if (elem.waveForm) {
+                part.hasWaveforms = true;
+            }
+        }
+    }
+
+    // The boundary nodes are driven by voltage sources with PWL waveforms.
+    // Initially, the waveforms are zero.
+    PWLKnots zeroKnots;
+    zeroKnots.time.push_back(t1);
+    zeroKnots.time.push_back(t2 + dt);
+    zeroKnots.ampl.assign(2, 0);
+    part.boundaryKnots.assign(part.boundaryNodes.size(), zeroKnots);
+
+    for (unsigned int indBoundary = 0; indBoundary < part.boundaryNodes.size(); indBoundary++) {
+        std::string nodeStr = nodeList->mapNodeString[part.boundaryNodes[indBoundary]];
+        nodeStrs.insert(nodeStr);
+
+        std::string strVS = "V_WR_" + nodeStr + " " + nodeStr + " 0 0";
+        Element elemVS(strVS);
+        elemVS.waveForm = new Waveform(&part.boundaryKnots[indBoundary]);
+        part.boundaryElems.push_back(partElems.size());
+        partElems.push_back(std::move(elemVS));
+        part.elemInds.push_back(-1);
+    }
+
+    part.nodeList = new NodeList(nodeStrs);
+    part.elemList = new ElementList(std::move(partElems));
+
+    for (unsigned int indNode = 0; indNode < part.nodes.size(); indNode++) {
+        Probe probe;
+        probe.type  = Probe::PROBE_VOLTAGE;
+        probe.name  = "V(" + nodeList->mapNodeString[part.nodes[indNode]] + ")";
+        probe.node1 = part.nodeList->node(nodeList->nodeSymbol[part.nodes[indNode]]);
+        probe.node2 = 0;
+        probe.elemInd = 0;
+        part.probes.push_back(probe);
+    }
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        if (probes[indProbe].type != Probe::PROBE_CURRENT) continue;
+        for (unsigned int indElem = 0; indElem < part.elemInds.size(); indElem++) {
+            if (part.elemInds[indElem] == (int) probes[indProbe].elemInd
+                && !cut[probes[indProbe].elemInd]) {
+                Probe probe = probes[indProbe];
+                probe.elemInd = indElem;
+                part.probes.push_back(probe);
+            }
+        }
+    }
+
+    boundaryGains(part);
+
+    part.tran = new Transient(part.nodeList, part.elemList, part.probes, dt, t2, t1,
+                              theta, method);
+    part.tran->verbose = false;
+    for (unsigned int indBoundary = 0; indBoundary < part.boundaryElems.size(); indBoundary++) {
+        Waveform waveForm(&part.boundaryKnots[indBoundary]);
+        part.tran->setWaveform(part.boundaryElems[indBoundary], waveForm, false);
+    }
+    part.tran->getState(part.state);
+}
+
+void
+WaveformRelaxation::boundaryGains(WRPartition &part) {
+    // The DC circuit of the partition: capacitances are open and inductances
+    // shorted by zero voltage sources. A conductance of 1e-9*C/(t2 - t1)
+    // keeps the nodes connected only through capacitances defined. Current
+    // sources are open and voltage sources zero except for the boundary
+    // source, whose gain is computed.
+    std::vector <Element> &partElems = part.elemList->elements;
+    std::vector <Element> elements;
+    std::vector <unsigned int> boundaryInds;
+    for (unsigned int indElem = 0; indElem < partElems.size(); indElem++) {
+        const Element &elem = partElems[indElem];
+        std::stringstream ssElem;
+
+        switch (elem.elemType) {
+        case STAT_CAPACITANCE:
+            ssElem << "R_DC_" << elem.name << " " << elem.nodeList[0] << " "
+                   << elem.nodeList[1] << " 1";
+            break;
+        case STAT_INDUCTANCE:
+            ssElem << "V_DC_" << elem.name << " " << elem.nodeList[0] << " "
+                   << elem.nodeList[1] << " 0";
+            break;
+        case STAT_VOLTAGESOURCE:
+            if (std::find(part.boundaryElems.begin(), part.boundaryElems.end(), indElem)
+                != part.boundaryElems.end()) {
+                boundaryInds.push_back(elements.size());
+            }
+            ssElem << elem.name << " " << elem.nodeList[0] << " " << elem.nodeList[1] << " 0";
+            break;
+        case STAT_CURRENTSOURCE:
+            continue;
+        default:
+            elements.push_back(elem);
+            continue;
+        }
+        std::string strElem = ssElem.str();
+        elements.push_back(Element(strElem));
+        if (elem.elemType == STAT_CAPACITANCE) {
+            elements.back().valueList[0] = 1e9*(t2 - t1)/elem.valueList[0];
+        }
+    }
+
+    part.boundaryGain.assign(part.boundaryElems.size(), 0);
+    for (unsigned int indBoundary = 0; indBoundary < boundaryInds.size(); indBoundary++) {
+        elements[boundaryInds[indBoundary]].valueList[0] = 1;
+        ElementList elemList(elements);
+        Assembly ass(part.nodeList, &elemList, false, false);
+        double *sol = ass.solve();
+        for (unsigned int indNode = 0; indNode < part.nodes.size(); indNode++) {
+            double gain = fabs(sol[part.probes[indNode].node1 - 1]);
+            part.boundaryGain[indBoundary] = std::max(part.boundaryGain[indBoundary], gain);
+        }
+        delete [] sol;
+        elements[boundaryInds[indBoundary]].valueList[0] = 0;
+    }
+}
+
+void
+WaveformRelaxation::setBoundary(WRPartition &part) {
+    // The waveforms are extended with a constant beyond the window since
+    // the PWL waveforms vanish after the last knot. The knots are replaced
+    // in place and the waveforms set again to reset their states.
+    for (unsigned int indBoundary = 0; indBoundary < part.boundaryNodes.size(); indBoundary++) {
+        unsigned int node = part.boundaryNodes[indBoundary];
+        PWLKnots &knots = part.boundaryKnots[indBoundary];
+        knots.time = nodeTimes[node];
+        knots.ampl = nodeValues[node];
+        knots.time.push_back(t2 + dt);
+        knots.ampl.push_back(knots.ampl.back());
+
+        Waveform waveForm(&knots);
+        part.tran->setWaveform(part.boundaryElems[indBoundary], waveForm, false);
+    }
+}
+
+void
+WaveformRelaxation::integrate(unsigned int indPart, double tw, double tEnd) {
+    WRPartition &part = partitions[indPart];
+    // The currents of the initial state are not consistent.
+    part.tran->setState(tw, part.state, tw > t1);
+    part.rows.clear();
+    part.tran->advance(tEnd, &part.rows);
+}
+
+void
+WaveformRelaxation::worker(unsigned int thread, double tw, double tEnd) {
+    for (unsigned int indPart = thread; indPart < partitions.size(); indPart += numThreads) {
+        if (!partitions[indPart].dormant) {
+            integrate(indPart, tw, tEnd);
+        }
+    }
+}
+
+bool
+WaveformRelaxation::latent(unsigned int indPart) {
+    // A dormant partition is reactivated for the rest of the window when
+    // any of its boundary voltages deviates from the value at rest so much
+    // that its DC response exceeds latencyTol. Then, it is integrated from
+    // its state at the start of the window.
+    WRPartition &part = partitions[indPart];
+    if (!part.dormant) {
+        return false;
+    }
+    for (unsigned int indBoundary = 0; indBoundary < part.boundaryNodes.size(); indBoundary++) {
+        std::vector <double> &values = nodeValues[part.boundaryNodes[indBoundary]];
+        double inputTol = latencyTol/part.boundaryGain[indBoundary];
+        for (unsigned int ind = 0; ind < values.size(); ind++) {
+            if (fabs(values[ind] - part.restInputs[indBoundary]) >= inputTol) {
+                part.dormant = false;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+WaveformRelaxation::hold(unsigned int indPart, double tEnd) {
+    // The output variables of a dormant partition are held at their values
+    // at rest over the window.
+    WRPartition &part = partitions[indPart];
+    part.rows = part.restRow;
+    part.rows[0] = tEnd;
+}
+
+void
+WaveformRelaxation::updateActivity() {
+    // A partition without sources with waveforms becomes dormant, when the
+    // voltages of its nodes have varied less than latencyTol over a window.
+    for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+        WRPartition &part = partitions[indPart];
+        if (part.dormant || part.hasWaveforms || part.rows.size() == 0) continue;
+
+        double activity = 0;
+        for (unsigned int indNode = 0; indNode < part.nodes.size(); indNode++) {
+            std::vector <double> &values = nodeValues[part.nodes[indNode]];
+            double minVal = *std::min_element(values.begin(), values.end()),
+                   maxVal = *std::max_element(values.begin(), values.end());
+            activity = std::max(activity, maxVal - minVal);
+        }
+        if (activity >= latencyTol) continue;
+
+        part.dormant = true;
+        part.restInputs.resize(part.boundaryNodes.size());
+        for (unsigned int indBoundary = 0; indBoundary < part.boundaryNodes.size(); indBoundary++) {
+            part.restInputs[indBoundary] = nodeValues[part.boundaryNodes[indBoundary]].back();
+        }
+        unsigned int rowSize = part.probes.size() + 1;
+        part.restRow.assign(part.rows.end() - rowSize, part.rows.end());
+    }
+}
+
+double
+WaveformRelaxation::interpolate(const std::vector <double> &times,
+                                const std::vector <double> &values, double _t) {
+    if (_t <= times.front()) {
+        return values.front();
+    }
+    if (_t >= times.back()) {
+        return values.back();
+    }
+    unsigned int ind = std::upper_bound(times.begin(), times.end(), _t) - times.begin();
+    double tPrev = times[ind - 1], tNext = times[ind];
+    return values[ind - 1] + (values[ind] - values[ind - 1])*(_t - tPrev)/(tNext - tPrev);
+}
+
+double
+WaveformRelaxation::updateNodes(unsigned int indPart) {
+    // Replace the node waveforms of the partition with the latest solution
+    // and return the maximum change. The first point of each waveform is the
+    // start of the window. At t1, the voltages are not known and the first
+    // time step is extrapolated backwards.
+    WRPartition &part = partitions[indPart];
+    unsigned int rowSize = part.probes.size() + 1,
+                 numRows = part.rows.size()/rowSize;
+    double change = 0;
+
+    for (unsigned int indNode = 0; indNode < part.nodes.size(); indNode++) {
+        unsigned int node = part.nodes[indNode];
+        std::vector <double> times(numRows + 1), values(numRows + 1);
+        times[0]  = nodeTimes[node][0];
+        values[0] = nodeValues[node][0];
+        for (unsigned int row = 0; row < numRows; row++) {
+            times[row + 1]  = part.rows[row*rowSize];
+            values[row + 1] = part.rows[row*rowSize + indNode + 1];
+        }
+        if (times[0] == t1 && numRows > 0) {
+            values[0] = values[1];
+        }
+
+        for (unsigned int ind = 0; ind < times.size(); ind++) {
+            double diff = fabs(values[ind] - interpolate(nodeTimes[node], nodeValues[node], times[ind]));
+            if (diff > change) {
+                change = diff;
+            }
+        }
+        nodeTimes[node]  = times;
+        nodeValues[node] = values;
+    }
+    return change;
+}
+
+void
+WaveformRelaxation::writeOutputs() {
+    NodeList *nodeList = parser->nodeList;
+    std::vector <Element> &elements = parser->elemList->elements;
+    double hMin = dt*1e-9;
+
+    // Union of the time points of the partitions.
+    std::vector <double> times;
+    for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+        WRPartition &part = partitions[indPart];
+        unsigned int rowSize = part.probes.size() + 1;
+        for (unsigned int ind = 0; ind < part.rows.size(); ind += rowSize) {
+            times.push_back(part.rows[ind]);
+        }
+    }
+    std::sort(times.begin(), times.end());
+    std::vector <double> timesUnique;
+    for (unsigned int ind = 0; ind < times.size(); ind++) {
+        if (timesUnique.size() == 0 || times[ind] > timesUnique.back() + hMin) {
+            timesUnique.push_back(times[ind]);
+        }
+    }
+
+    // Waveforms of the output variables. Currents of the cut resistances
+    // are obtained from the node voltages.
+    std::vector <std::vector <double> > probeTimes(probes.size()), probeValues(probes.size());
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        Probe &probe = probes[indProbe];
+        if (probe.type == Probe::PROBE_VOLTAGE) continue;
+
+        for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+            WRPartition &part = partitions[indPart];
+            unsigned int rowSize = part.probes.size() + 1;
+            for (unsigned int indCol = part.nodes.size(); indCol < part.probes.size(); indCol++) {
+                if (part.elemInds[part.probes[indCol].elemInd] != (int) probe.elemInd) continue;
+                for (unsigned int ind = 0; ind < part.rows.size(); ind += rowSize) {
+                    probeTimes[indProbe].push_back(part.rows[ind]);
+                    probeValues[indProbe].push_back(part.rows[ind + indCol + 1]);
+                }
+            }
+        }
+    }
+
+    for (unsigned int ind = 0; ind < timesUnique.size(); ind++) {
+        double tOut = timesUnique[ind];
+        for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+            Probe &probe = probes[indProbe];
+            unsigned int node1 = probe.node1, node2 = probe.node2;
+            double scale = 1;
+
+            if (probe.type == Probe::PROBE_CURRENT) {
+                if (probeTimes[indProbe].size() > 0) {
+                    outputs[indProbe] = interpolate(probeTimes[indProbe],
+                                                    probeValues[indProbe], tOut);
+                    continue;
+                }
+                Element &elem = elements[probe.elemInd];
+                node1 = nodeList->node(elem.nodeIds[0]);
+                node2 = nodeList->node(elem.nodeIds[1]);
+                scale = 1/elem.valueList[0];
+            }
+            double voltage = 0;
+            if (node1 != 0) {
+                voltage += interpolate(nodeTimes[node1], nodeValues[node1], tOut);
+            }
+            if (node2 != 0) {
+                voltage -= interpolate(nodeTimes[node2], nodeValues[node2], tOut);
+            }
+            outputs[indProbe] = scale*voltage;
+        }
+        if (writer) {
+            writer->addRow(tOut, outputs);
+        }
+    }
+}
+
+void
+WaveformRelaxation::run() {
+    unsigned int numNodes = parser->nodeList->numNodes;
+    double hMin = dt*1e-9;
+
+    nodeTimes.assign(numNodes, std::vector <double> (1, t1));
+    nodeValues.assign(numNodes, std::vector <double> (1, 0));
+    numIter.clear();
+    numLatent.assign(partitions.size(), 0);
+    for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+        partitions[indPart].dormant = false;
+    }
+
+    bool coupled = false;
+    for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+        if (partitions[indPart].boundaryNodes.size() > 0) {
+            coupled = true;
+        }
+    }
+
+    double tw = t1;
+    while (tw < t2 - hMin) {
+        double tEnd = tw + window;
+        if (tEnd > t2 - hMin) {
+            tEnd = t2;
+        }
+
+        unsigned int iter;
+        double change = 0;
+        for (iter = 1; iter <= maxIter; iter++) {
+            change = 0;
+            if (scheme == WR_JACOBI) {
+                for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+                    if (latent(indPart)) {
+                        hold(indPart, tEnd);
+                    } else {
+                        setBoundary(partitions[indPart]);
+                    }
+                }
+                std::vector <std::thread> threads;
+                for (unsigned int thread = 0; thread < numThreads; thread++) {
+                    threads.push_back(std::thread(&WaveformRelaxation::worker, this,
+                                                  thread, tw, tEnd));
+                }
+                for (unsigned int thread = 0; thread < numThreads; thread++) {
+                    threads[thread].join();
+                }
+                for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+                    change = std::max(change, updateNodes(indPart));
+                }
+            } else {
+                for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+                    if (latent(indPart)) {
+                        hold(indPart, tEnd);
+                    } else {
+                        setBoundary(partitions[indPart]);
+                        integrate(indPart, tw, tEnd);
+                    }
+                    change = std::max(change, updateNodes(indPart));
+                }
+            }
+            if (!coupled || (iter > 1 && change <= tol)) {
+                break;
+            }
+        }
+        if (iter > maxIter) {
+            iter = maxIter;
+        }
+        numIter.push_back(iter);
+        if (verbose) {
+            std::cout << "WR window " << tw << " - " << tEnd << " : " << iter
+                      << " iterations, change " << change << std::endl;
+        }
+
+        for (unsigned int indPart = 0; indPart < partitions.size(); indPart++) {
+            WRPartition &part = partitions[indPart];
+            if (part.dormant) {
+                numLatent[indPart]++;
+            } else {
+                part.tran->getState(part.state);
+            }
+        }
+        writeOutputs();
+        if (latency) {
+            updateActivity();
+        }
+
+        for (unsigned int node = 1; node < numNodes; node++) {
+            double value = nodeValues[node].back();
+            nodeTimes[node].assign(1, tEnd);
+            nodeValues[node].assign(1, value);
+        }
+        tw = tEnd;
+    }
+}
+
+void
+WaveformRelaxation::signalNames(std::vector <std::string> &names) {
+    names.clear();
+    for (unsigned int indProbe = 0; indProbe < probes.size(); indProbe++) {
+        names.push_back(probes[indProbe].name);
+    }
+}
+
+#ifdef WAVEFORMRELAXATION_TEST
+
+#include <assert.h>
+
+// The partitions of the circuit in fileName are integrated with latency.
+// The output variables must remain within latencyTol of the full Transient
+// and, when expected, some partition must become dormant.
+static void
+checkLatency(const std::string &fileName, double t2, bool expectLatent) {
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+
+    Transient tran(&parser, 0.0001, t2, 0, 0.5);
+    tran.verbose = false;
+    tran.run();
+
+    WaveformRelaxation wr(&parser, 0.0001, t2, 0, 0.5, Transient::METHOD_THETA, 1e3, 1);
+    wr.scheme     = WaveformRelaxation::WR_GAUSS_SEIDEL;
+    wr.tol        = 1e-9;
+    wr.latency    = true;
+    wr.latencyTol = 1e-6;
+    wr.verbose    = false;
+    wr.run();
+
+    unsigned int numLatent = 0;
+    for (unsigned int indPart = 0; indPart < wr.partitions.size(); indPart++) {
+        numLatent += wr.numLatent[indPart];
+    }
+    double maxDiff = 0;
+    for (unsigned int ind = 0; ind < tran.outputs.size(); ind++) {
+        maxDiff = std::max(maxDiff, fabs(tran.outputs[ind] - wr.outputs[ind]));
+    }
+    std::cout << std::endl << "Latency of " << fileName << ": " << numLatent
+              << " latent windows, maximum difference " << maxDiff << " to Transient"
+              << std::endl;
+    assert(!expectLatent || numLatent > 0);
+    assert(maxDiff < wr.latencyTol);
+}
+
+int
+main(int argc, char **argv) {
+    checkLatency("test_latency.cir", 0.2, true);
+    checkLatency("test_latency_float.cir", 1.5, false);
+
+    std::string fileName = "test_wr.cir";
+    unsigned int scheme = WaveformRelaxation::WR_GAUSS_SEIDEL, numThreads = 2;
+    bool latency = false;
+    double t2 = 0.1;
+
+    if (argc >= 2) {
+        fileName = argv[1];
+    }
+    if (argc >= 3) {
+        scheme = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        numThreads = atoi(argv[3]);
+    }
+    if (argc >= 5) {
+        latency = atoi(argv[4]) != 0;
+    }
+    if (argc >= 6) {
+        t2 = atof(argv[5]);
+    }
+
+    cirFile cir(fileName);
+    Parser parser(cir.statList);
+
+    Transient tran(&parser, 0.0001, t2, 0, 0.5);
+    tran.verbose = false;
+    std::vector <double> rows;
+    tran.advance(t2, &rows);
+
+    WaveformRelaxation wr(&parser, 0.0001, t2, 0, 0.5, Transient::METHOD_THETA, 1e3, numThreads);
+    wr.scheme     = scheme;
+    wr.tol        = 1e-9;
+    wr.latency    = latency;
+    wr.latencyTol = 1e-6;
+    wr.run();
+
+    std::cout << std::endl << "Waveform relaxation: " << wr.partitions.size()
+              << " partitions" << std::endl;
+    for (unsigned int indPart = 0; indPart < wr.partitions.size(); indPart++) {
+        std::cout << indPart << ": " << wr.partitions[indPart].nodes.size() << " nodes, "
+                  << wr.partitions[indPart].boundaryNodes.size() << " boundary nodes, "
+                  << wr.numLatent[indPart] << " latent windows" << std::endl;
+    }
+    std::cout << "Output at t = " << rows[rows.size() - tran.outputs.size() - 1] << std::endl;
+    for (unsigned int ind = 0; ind < tran.outputs.size(); ind++) {
+        std::cout << tran.probes[ind].name << " " << tran.outputs[ind] << " "
+                  << wr.outputs[ind] << std::endl;
+    }
+}
+
+#endif
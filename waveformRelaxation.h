@@ -0,0 +1,165 @@
+/* sillySPICE - A SPICE-like Circuit Solver
+   Copyright (C) 2015 Ville Räisänen <vsr at vsr.name>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WAVEFORMRELAXATION_H
+#define WAVEFORMRELAXATION_H
+
+#include "parser.h"
+#include "transient.h"
+#include "topology.h"
+#include "rawWriter.h"
+
+#include <vector>
+#include <string>
+
+/* WRPartition objects contain a subcircuit of a partitioned circuit.
+ *
+ * nodes         Indices of the nodes of the partition in the original circuit.
+ * boundaryNodes Indices of the nodes of other partitions connected to the
+ *               partition through cut resistances.
+ * boundaryGain  DC gain from each boundary voltage to the node voltages of
+ *               the partition, i.e., the largest node voltage for a unit
+ *               boundary voltage.
+ * boundaryElems Indices of the voltage sources driving the boundary nodes in
+ *               the element list of the partition.
+ * boundaryKnots PWL knots of the boundary voltages, which the waveforms of
+ *               the sources refer to.
+ * elemInds      Indices of the elements of the partition in the original
+ *               element list or -1 for the boundary sources.
+ * probes        V(node) for each node followed by the currents of the
+ *               elements in the output variables of the original circuit.
+ * rows          Time points and values of the probes within the current time
+ *               window.
+ * dormant       The partition is latent and is not integrated. restInputs
+ *               contains the boundary voltages and restRow the values of the
+ *               probes, when it became dormant.
+ */
+
+class WRPartition {
+public:
+    std::vector <unsigned int> nodes, boundaryNodes, boundaryElems;
+    std::vector <double> boundaryGain;
+    std::vector <PWLKnots> boundaryKnots;
+    std::vector <int> elemInds;
+    std::vector <Probe> probes;
+
+    NodeList    *nodeList;
+    ElementList *elemList;
+    Transient   *tran;
+
+    std::vector <double> state;
+    std::vector <double> rows;
+
+    bool hasWaveforms, dormant;
+    std::vector <double> restInputs, restRow;
+};
+
+/* WaveformRelaxation object performs transient solution of a linear circuit
+ * by waveform relaxation.
+ *
+ * The circuit is partitioned into the connected components of the graph of
+ * the non-ground nodes, where the resistances larger than or equal to rCut
+ * are ignored. The partitions are coupled only through these weak
+ * resistances. Each partition is integrated with its own Transient object,
+ * where the nodes of the other partitions connected to it are driven by
+ * voltage sources with the PWL waveforms of the latest iteration. Each
+ * partition takes its own time steps and the boundary waveforms are
+ * interpolated linearly without breakpoints.
+ *
+ * The time from t1 to t2 is divided into windows of length window. In each
+ * window, the partitions are integrated repeatedly until the maximum change
+ * of the node voltages is below tol or maxIter iterations have been
+ * performed:
+ *
+ * WR_JACOBI        All partitions are integrated in parallel with numThreads
+ *                  threads using the waveforms of the previous iteration.
+ * WR_GAUSS_SEIDEL  The partitions are integrated sequentially and each uses
+ *                  the latest waveforms of the others.
+ *
+ * The output variables of the circuit are written into writer at the union
+ * of the time points of all partitions.
+ *
+ * When latency is set, partitions without sources with waveforms, whose node
+ * voltages have varied less than latencyTol during a window, become dormant:
+ * they are not integrated and their voltages are held constant. A dormant
+ * partition is reactivated and integrated from its state at rest as soon as
+ * any of its boundary voltages deviates from its value at rest by more than
+ * latencyTol divided by the DC gain of the partition from that boundary
+ * voltage. The gains are computed, when the partitions are built, by
+ * solving each partition with open capacitances, shorted inductances and
+ * zero independent sources for unit boundary voltages. A partition, whose
+ * only DC path to the ground goes through a cut resistance, has the gain one
+ * and its tolerance is not relaxed. Thus, the DC response of a held
+ * partition to the deviation of each of its inputs stays within latencyTol,
+ * which bounds its error by latencyTol per boundary node for partitions,
+ * whose step responses do not overshoot, e.g., RC networks. Overshooting
+ * partitions with inductances may exceed this. numLatent counts the windows
+ * each partition has been dormant.
+ */
+
+class WaveformRelaxation {
+public:
+    enum{WR_JACOBI, WR_GAUSS_SEIDEL};
+
+    WaveformRelaxation(Parser *_parser, double _dt, double _t2, double _t1=0,
+                       double _theta=0.5, unsigned int _method=Transient::METHOD_THETA,
+                       double _rCut=1e3, unsigned int _numThreads=1);
+    ~WaveformRelaxation();
+
+    void run();
+    void signalNames(std::vector <std::string> &names);
+
+    double dt, t1, t2, theta, rCut, window, tol, latencyTol;
+    unsigned int method, scheme, numThreads, maxIter;
+    bool latency, verbose;
+    RawWriter *writer;
+
+    std::vector <WRPartition> partitions;
+    // Partition of each node in the original circuit. The ground is not in
+    // any partition.
+    std::vector <int> nodePartition;
+    // Number of iterations in each window.
+    std::vector <unsigned int> numIter;
+    std::vector <unsigned int> numLatent;
+
+    // Output variables and their values at the latest time point.
+    std::vector <Probe> probes;
+    std::vector <double> outputs;
+private:
+    Parser *parser;
+
+    // Time points and voltages of the nodes within the current window.
+    std::vector <std::vector <double> > nodeTimes, nodeValues;
+
+    void partition();
+    void buildPartition(WRPartition &part, unsigned int indPart,
+                        std::vector <bool> &cut);
+    void boundaryGains(WRPartition &part);
+    void setBoundary(WRPartition &part);
+    void integrate(unsigned int indPart, double tw, double tEnd);
+    void worker(unsigned int thread, double tw, double tEnd);
+    bool latent(unsigned int indPart);
+    void hold(unsigned int indPart, double tEnd);
+    void updateActivity();
+    double updateNodes(unsigned int indPart);
+    double interpolate(const std::vector <double> &times,
+                       const std::vector <double> &values, double _t);
+    void writeOutputs();
+};
+
+#endif // WAVEFORMRELAXATION_H